@@ -111,6 +111,7 @@ AirspyDev::AirspyDev(const std::string &serial, SampleRate fs)
       }
 
       block_size_ = sample_rate_to_uint(fs_) * 4 / 125;
+      iq_buffer_.resize(block_size_ * 2);
 }
 
 
@@ -127,6 +128,7 @@ int AirspyDev::start() {
     block_info_.pwr = 0.0f;
     block_info_.ts = std::chrono::system_clock::now();
     block_info_.stream_state = StreamState::IDLE;
+    block_info_.dropped = 0;
 
     state_ = State::STARTING;
     run_ = true;
@@ -139,7 +141,7 @@ int AirspyDev::start() {
 int AirspyDev::stop() {
     if (!run_) return ReturnValue::ALREADY_STOPPED;
 
-    run_ = false;
+    halt_();
     state_ = State::STOPPING;
     worker_thread_.join();
 
@@ -258,8 +260,10 @@ void AirspyDev::worker_(AirspyDev &self) {
                                   &self);
             if (ret == AIRSPY_SUCCESS) {
                 self.state_ = State::RUNNING;  // TODO: Move to above airspy_start_rx? How to revert on error then?
+                // libairspy has no notification when the device goes away so
+                // the streaming state is polled. A stop cuts the wait short
                 while (self.run_ && airspy_is_streaming((struct airspy_device*)self.dev_) == AIRSPY_TRUE) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    self.sleep_(std::chrono::milliseconds(100));
                 }
                 airspy_stop_rx((struct airspy_device*)self.dev_);
 
@@ -267,7 +271,7 @@ void AirspyDev::worker_(AirspyDev &self) {
                 // streaming
                 self.block_info_.stream_state = StreamState::IDLE;
                 self.block_info_.ts = std::chrono::system_clock::now();
-                self.data(self.iq_buffer_, 0, self.user_data_, self.block_info_);
+                self.data(self.iq_buffer_.data(), 0, self.user_data_, self.block_info_);
 
                 if (self.run_) {
                     self.state_ = State::RESTARTING;
@@ -279,10 +283,10 @@ void AirspyDev::worker_(AirspyDev &self) {
 
             airspy_close((struct airspy_device*)self.dev_);
             self.dev_ = nullptr;
-            if (self.run_) std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            self.sleep_(std::chrono::milliseconds(1000));
 
         } else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            self.sleep_(std::chrono::milliseconds(1000));
         }
     }
 
@@ -348,9 +352,9 @@ int AirspyDev::data_cb_(void *t) {
         return 0;
     }
 
-    if (transfer->dropped_samples) {
-        std::cerr << "Warning: " << transfer->dropped_samples << " samples dropped. Your system is probably overloaded.\n";
-    }
+    // Reported by the user of the data signal. Nothing is printed here since
+    // this is the USB thread
+    self.block_info_.dropped += transfer->dropped_samples;
 
     sample_pos = 0;
     float *data = (float*)transfer->samples;
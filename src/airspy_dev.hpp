@@ -50,6 +50,8 @@ public:
     // is stopped and the Airspy device is fully closed
     int stop(void);
 
+    size_t bufferMemory(void) const { return iq_buffer_.capacity() * sizeof(iqsample_t); }
+
     // Get a list of available devices
     static std::vector<R820Dev::Info> list(void);
 
@@ -70,7 +72,7 @@ private:
     int            open_(void);
     static void    worker_(AirspyDev &self);
     static int     data_cb_(void *transfer);
-    iqsample_t     iq_buffer_[320000*2]; // Largest buffer for 10MS/s. Times twice
+    std::vector<iqsample_t> iq_buffer_;  // Two blocks for the sample rate in use
     unsigned       part_pos_;
     unsigned       block_size_;
     unsigned       iq_pos_;
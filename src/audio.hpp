@@ -0,0 +1,39 @@
+//
+// Audio sample conversion
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef AUDIO_HPP
+#define AUDIO_HPP
+
+#include <cstdint>
+
+// Convert len float samples in the range -1 to 1 to signed 16 bit. Samples
+// outside the range are clipped
+static inline void float_to_s16(const float *in, unsigned len, int16_t *out) {
+    for (unsigned i = 0; i < len; ++i) {
+        int16_t s;
+        if (in[i] > 1.0f)       s = 32767;
+        else if (in[i] < -1.0f) s = -32767;
+        else s = (int16_t)(in[i] * 32767.0f);
+
+        out[i] = s;
+    }
+}
+
+#endif // AUDIO_HPP
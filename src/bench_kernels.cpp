@@ -0,0 +1,467 @@
+//
+// Micro benchmark for the kernels of the output stage
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Standard C includes
+#include <stdio.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/utsname.h>
+
+// Standard C++ includes
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <complex>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Libraries we use
+#include <popt.h>
+#include <fftw3.h>
+
+// Local includes
+#include "iqsample.hpp"
+#include "fir.hpp"
+#include "agc.hpp"
+#include "demod.hpp"
+#include "audio.hpp"
+#include "coeffs.hpp"
+#include "codec.hpp"
+
+#ifndef BENCH_GIT_REV
+#define BENCH_GIT_REV "unknown"
+#endif
+
+#define BLOCK_LEN        512       // Samples per channel in a 32ms block, as CH_IQ_BUF_SIZE in sdrx
+#define BLOCK_TIME_NS    32000000  // Duration of one block
+#define VERIFY_G711_SNR  30.0      // Min SNR in dB of a G.711 round trip of a sine at -6dBFS
+#define VERIFY_ADPCM_SNR 20.0      // Min SNR in dB of an ADPCM round trip of a sine at -6dBFS
+#define VERIFY_S16_SNR   90.0      // Min SNR in dB of an S16 round trip
+
+
+// A kernel run on one block of data at the size used in sdrx
+struct Kernel {
+    const char           *name;
+    const char           *desc;
+    unsigned              samples;  // Samples handled per block
+    std::function<void()> run;
+};
+
+
+// Result of all repetitions of one kernel
+struct KernelResult {
+    double median_ns;   // Median time per block
+    double mad_ns;      // Median absolute deviation of the time per block
+};
+
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2.0;
+}
+
+
+// Data and state for the kernels. Noise at the level of the down sampled
+// signal with a carrier, generated with the same LCG as bench_msd so that
+// the data is the same on every host
+struct Fixture {
+    std::vector<iqsample_t> iq;
+    std::vector<float>      mono;
+    std::vector<float>      stereo;
+    std::vector<float>      out_float;
+    std::vector<iqsample_t> out_iq;
+    std::vector<int16_t>    out_s16;
+    std::vector<float>      window;
+    iqsample_t             *fft_in;
+    iqsample_t             *fft_out;
+    fftwf_plan              fft_plan;
+    FIR2                    audio_filter;
+    AGC                     agc;
+    LfAGC                   agc_lf;
+    Demod                   am;
+    Demod                   fm;
+    AudioEncoder            ulaw;
+    AudioEncoder            alaw;
+    AudioEncoder            adpcm;
+
+    Fixture(void) : iq(BLOCK_LEN), mono(BLOCK_LEN), stereo(BLOCK_LEN * 2), out_float(BLOCK_LEN * 2), out_iq(BLOCK_LEN),
+                    out_s16(BLOCK_LEN * 2), window(BLOCK_LEN + 1), audio_filter(coeff_bp4am_channel),
+                    am(Modulation::AM), fm(Modulation::FM), ulaw(Codec::ULAW, BLOCK_LEN), alaw(Codec::ALAW, BLOCK_LEN),
+                    adpcm(Codec::ADPCM, BLOCK_LEN) {
+        uint32_t seed = 1;
+        auto noise = [&seed](void) {
+            seed = seed * 1664525u + 1013904223u;
+            return (float)(seed >> 8) / (float)(1u << 24) - 0.5f;
+        };
+
+        for (unsigned n = 0; n < BLOCK_LEN; ++n) {
+            iq[n] = iqsample_t(noise(), noise()) * 0.01f + std::polar(0.05f, (float)(2.0 * M_PI * 1000.0 * n / 16000.0));
+            mono[n] = std::abs(iq[n]);
+            stereo[n * 2] = stereo[n * 2 + 1] = noise() * 2.4f;  // Some samples clip in the s16 conversion
+        }
+
+        // Same settings as for a channel and the output in sdrx
+        audio_filter.setGain(0.0f);
+        agc.setReference(1.0f);
+        agc.setAttack(1.0f);
+        agc.setDecay(0.01f);
+        agc.setMaxGain(300);
+        agc_lf.setReference(1.0f);
+        agc_lf.setAttack(1.0f);
+        agc_lf.setDecay(0.01f);
+        agc_lf.activate();
+
+        fft_in   = reinterpret_cast<iqsample_t*>(fftwf_malloc(sizeof(iqsample_t) * BLOCK_LEN));
+        fft_out  = reinterpret_cast<iqsample_t*>(fftwf_malloc(sizeof(iqsample_t) * BLOCK_LEN));
+        fft_plan = fftwf_plan_dft_1d(BLOCK_LEN, reinterpret_cast<fftwf_complex*>(fft_in), reinterpret_cast<fftwf_complex*>(fft_out),
+                                     FFTW_FORWARD, FFTW_ESTIMATE);
+        for (unsigned n = 0; n <= BLOCK_LEN; n++) {
+            window[n] = 0.54f - 0.46f * std::cos((2.0f * M_PI * n) / BLOCK_LEN);
+        }
+    }
+
+    ~Fixture(void) {
+        fftwf_destroy_plan(fft_plan);
+        fftwf_free(fft_in);
+        fftwf_free(fft_out);
+    }
+
+    Fixture(const Fixture&) = delete;
+    Fixture& operator=(const Fixture&) = delete;
+
+    std::vector<Kernel> kernels(void) {
+        return {
+            { "fir2_audio", "FIR2::filter, audio filter on a stereo block", BLOCK_LEN * 2, [this](void) {
+                audio_filter.filter(stereo.data(), BLOCK_LEN * 2, out_float.data());
+            } },
+            { "agc_iq", "AGC::adjust on a channel block", BLOCK_LEN, [this](void) {
+                for (unsigned i = 0; i < BLOCK_LEN; ++i) out_iq[i] = agc.adjust(iq[i]);
+            } },
+            { "agc_lf", "LfAGC::adjust on a demodulated block", BLOCK_LEN, [this](void) {
+                for (unsigned i = 0; i < BLOCK_LEN; ++i) out_float[i] = agc_lf.adjust(mono[i]);
+            } },
+            { "demod_am", "Demod::demod, AM", BLOCK_LEN, [this](void) {
+                for (unsigned i = 0; i < BLOCK_LEN; ++i) out_float[i] = am.demod(iq[i]);
+            } },
+            { "demod_fm", "Demod::demod, FM", BLOCK_LEN, [this](void) {
+                for (unsigned i = 0; i < BLOCK_LEN; ++i) out_float[i] = fm.demod(iq[i]);
+            } },
+            { "sql_fft", "Squelch window and 512 point FFT", BLOCK_LEN, [this](void) {
+                for (unsigned i = 0; i < BLOCK_LEN; ++i) fft_in[i] = iq[i] * window[i];
+                fftwf_execute(fft_plan);
+            } },
+            { "s16", "float_to_s16 on a stereo block", BLOCK_LEN * 2, [this](void) {
+                float_to_s16(stereo.data(), BLOCK_LEN * 2, out_s16.data());
+            } },
+            { "ulaw_enc", "AudioEncoder::encode, G.711 u-law on a mono block", BLOCK_LEN, [this](void) {
+                ulaw.encode(stereo.data(), BLOCK_LEN);
+            } },
+            { "alaw_enc", "AudioEncoder::encode, G.711 A-law on a mono block", BLOCK_LEN, [this](void) {
+                alaw.encode(stereo.data(), BLOCK_LEN);
+            } },
+            { "adpcm_enc", "AudioEncoder::encode, IMA-ADPCM on a mono block", BLOCK_LEN, [this](void) {
+                adpcm.encode(stereo.data(), BLOCK_LEN);
+            } },
+        };
+    }
+};
+
+
+// Run warmup repetitions that are thrown away and then reps repetitions of
+// batch blocks each. The time per block of every repetition is the sample
+// for the median and the MAD
+static KernelResult run_kernel(const Kernel &kernel, unsigned warmup, unsigned reps, unsigned batch) {
+    std::vector<double> times;
+
+    for (unsigned rep = 0; rep < warmup + reps; ++rep) {
+        uint64_t start = now_ns();
+        for (unsigned b = 0; b < batch; ++b) kernel.run();
+        uint64_t elapsed = now_ns() - start;
+
+        if (rep >= warmup) times.push_back((double)elapsed / batch);
+    }
+
+    KernelResult result;
+    result.median_ns = median(times);
+
+    for (auto &t : times) t = std::abs(t - result.median_ns);
+    result.mad_ns = median(times);
+
+    return result;
+}
+
+
+// SNR in dB of the difference between out and the 16 bit version of in
+static double codec_snr(const std::vector<float> &in, const std::vector<float> &out) {
+    double sig = 0.0;
+    double err = 0.0;
+
+    if (in.size() != out.size()) return 0.0;
+
+    for (size_t i = 0; i < in.size(); ++i) {
+        double ref = (double)g711::to_s16(in[i]) / 32767.0;
+        sig += ref * ref;
+        err += (ref - out[i]) * (ref - out[i]);
+    }
+
+    return err > 0.0 ? 10.0 * std::log10(sig / err) : 200.0;
+}
+
+
+// Encode in frame by frame with codec and decode it again
+static std::vector<float> codec_round_trip(Codec codec, const std::vector<float> &in, unsigned frame_len) {
+    AudioEncoder       encoder(codec, frame_len);
+    AudioDecoder       decoder(codec);
+    std::vector<float> out(in.size() + frame_len);
+    size_t             len = 0;
+
+    for (size_t pos = 0; pos < in.size(); pos += frame_len) {
+        unsigned n = std::min<size_t>(frame_len, in.size() - pos);
+        encoder.encode(&in[pos], n);
+        len += decoder.decode(encoder.data(), encoder.size(), &out[len]);
+    }
+    out.resize(len);
+
+    return out;
+}
+
+
+// Check the audio codecs. The G.711 block encoders, SIMD where available,
+// must be bit exact with the encoders for one sample and every codec must
+// reproduce a sine with a minimum SNR. Returns false if anything fails
+static bool verify(void) {
+    bool ok = true;
+
+#if defined __AVX2__
+    const char *variant = "AVX2";
+#else
+    const char *variant = "portable";
+#endif
+
+    // Every 16 bit value, some over full scale, and a length that is not a
+    // multiple of the SIMD width so that the trailing samples are covered
+    std::vector<float> ramp;
+    for (int i = -36000; i <= 36000; ++i) ramp.push_back((float)i / 32767.0f);
+    ramp.push_back(0.0f);
+    ramp.push_back(-1.0f);
+    ramp.push_back(1.0f);
+
+    std::vector<uint8_t> block(ramp.size());
+
+    printf("G.711 block encoder (%s) vs one sample encoder:\n", variant);
+    g711::ulaw_encode(ramp.data(), ramp.size(), block.data());
+    unsigned ulaw_diff = 0;
+    for (size_t i = 0; i < ramp.size(); ++i) ulaw_diff += block[i] != g711::ulaw_encode(g711::to_s16(ramp[i]));
+    printf("    %-10s %8u differences %6s\n", "u-law", ulaw_diff, ulaw_diff == 0 ? "PASS" : "FAIL");
+
+    g711::alaw_encode(ramp.data(), ramp.size(), block.data());
+    unsigned alaw_diff = 0;
+    for (size_t i = 0; i < ramp.size(); ++i) alaw_diff += block[i] != g711::alaw_encode(g711::to_s16(ramp[i]));
+    printf("    %-10s %8u differences %6s\n", "A-law", alaw_diff, alaw_diff == 0 ? "PASS" : "FAIL");
+
+    ok = ok && ulaw_diff == 0 && alaw_diff == 0;
+
+    // 1kHz sine at -6dBFS, 16kS/s, in sdrx size frames
+    std::vector<float> sine(BLOCK_LEN * 16);
+    for (unsigned n = 0; n < sine.size(); ++n) sine[n] = 0.5f * std::sin((float)(2.0 * M_PI * 1000.0 * n / 16000.0));
+
+    struct { Codec codec; double min_snr; } cases[] = {
+        { Codec::S16,   VERIFY_S16_SNR },
+        { Codec::ULAW,  VERIFY_G711_SNR },
+        { Codec::ALAW,  VERIFY_G711_SNR },
+        { Codec::ADPCM, VERIFY_ADPCM_SNR },
+    };
+
+    printf("\nRound trip of a 1kHz sine at -6dBFS, SNR in dB:\n");
+    printf("    %-10s %8s %8s %6s\n", "Codec", "Min", "SNR", "Result");
+    for (auto &c : cases) {
+        double snr  = codec_snr(sine, codec_round_trip(c.codec, sine, BLOCK_LEN));
+        bool   pass = snr >= c.min_snr;
+        printf("    %-10s %8.1f %8.1f %6s\n", codec_to_str(c.codec).c_str(), c.min_snr, snr, pass ? "PASS" : "FAIL");
+        ok = ok && pass;
+    }
+
+    // Frames with an odd number of samples must decode to the same number
+    printf("\nFrames with an odd number of samples:\n");
+    for (auto &c : cases) {
+        std::vector<float> in(sine.begin(), sine.begin() + BLOCK_LEN - 1);
+        size_t             len = codec_round_trip(c.codec, in, BLOCK_LEN).size();
+        bool               pass = len == in.size();
+        printf("    %-10s %8zu of %zu samples %6s\n", codec_to_str(c.codec).c_str(), len, in.size(), pass ? "PASS" : "FAIL");
+        ok = ok && pass;
+    }
+
+    printf("\n%s\n", ok ? "All checks passed" : "Verification FAILED");
+
+    return ok;
+}
+
+
+// Pin the process to cpu. A negative cpu pins to the CPU the process runs on
+// right now. Returns the CPU pinned to or -1 if pinning failed
+static int pin_cpu(int cpu) {
+    if (cpu < 0) cpu = sched_getcpu();
+    if (cpu < 0) return -1;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) return -1;
+
+    return cpu;
+}
+
+
+int main(int argc, char **argv) {
+    int          ret;
+    poptContext  popt_ctx;
+    int          print_help = 0;
+    int          warmup = 20;
+    int          reps = 200;
+    int          batch = 10;
+    int          cpu = -1;
+    int          csv = 0;
+    int          do_verify = 0;
+    char        *kernel_str = nullptr;
+    std::string  only_kernel;
+
+    struct poptOption options_table[] = {
+        { "kernel",  'k', POPT_ARG_STRING, &kernel_str, 0, "only benchmark this kernel. All kernels if not set", "KERNEL" },
+        { "reps",    'r', POPT_ARG_INT,    &reps, 0, "number of measured repetitions. Defaults to 200 if not set", "NUM" },
+        { "warmup",  'w', POPT_ARG_INT,    &warmup, 0, "number of repetitions run before measuring. Defaults to 20 if not set", "NUM" },
+        { "batch",   'b', POPT_ARG_INT,    &batch, 0, "number of blocks in each repetition. Defaults to 10 if not set", "NUM" },
+        { "cpu",     'c', POPT_ARG_INT,    &cpu, 0, "pin to this CPU. Defaults to the CPU the benchmark starts on if not set", "CPU" },
+        { "csv",       0, POPT_ARG_NONE,   &csv, 0, "print the results as CSV, with host and git revision on every line", nullptr },
+        { "verify",  'v', POPT_ARG_NONE,   &do_verify, 0, "verify the audio codecs instead of benchmarking", nullptr },
+        { "help",    'h', POPT_ARG_NONE,   &print_help, 0, "show full help and quit", nullptr },
+        POPT_TABLEEND
+    };
+
+    // Create popt instance
+    popt_ctx = poptGetContext(nullptr, argc, (const char**)argv, options_table, POPT_CONTEXT_POSIXMEHARDER);
+    poptSetOtherOptionHelp(popt_ctx, "[OPTION...]");
+
+    while ((ret = poptGetNextOpt(popt_ctx)) > 0);
+    if (ret < -1) {
+        // Error while parsing the options. Print the reason
+        switch (ret) {
+            case POPT_ERROR_BADOPT:
+                std::cerr << "Error: Unknown option given.\n";
+                break;
+            case POPT_ERROR_NOARG:
+                std::cerr << "Error: Missing option value.\n";
+                break;
+            case POPT_ERROR_BADNUMBER:
+            case POPT_ERROR_OVERFLOW:
+                std::cerr << "Error: Option could not be converted to number.\n";
+                break;
+            default:
+                std::cerr << "Error: Unknown error in option parsing, ret = " << ret << ".\n";
+                break;
+        }
+        poptPrintHelp(popt_ctx, stderr, 0);
+        poptFreeContext(popt_ctx);
+        return 1;
+    }
+
+    Fixture             fixture;
+    std::vector<Kernel> kernels = fixture.kernels();
+
+    if (print_help) {
+        poptPrintHelp(popt_ctx, stderr, 0);
+        std::cerr << R"(
+Runs the kernels of the output stage of sdrx, one 32ms block at a time with
+the coefficient tables and block sizes used in sdrx. No device is needed.
+
+Kernels:
+)";
+        for (auto &kernel : kernels) fprintf(stderr, "    %-12s %s\n", kernel.name, kernel.desc);
+        poptFreeContext(popt_ctx);
+        return 0;
+    }
+
+    poptFreeContext(popt_ctx);
+
+    if (do_verify) {
+        free(kernel_str);
+        return verify() ? 0 : 1;
+    }
+
+    if (kernel_str) {
+        only_kernel = kernel_str;
+        free(kernel_str);
+        if (std::none_of(kernels.begin(), kernels.end(), [&only_kernel](const Kernel &k) { return only_kernel == k.name; })) {
+            std::cerr << "Error: Unknown kernel given: " << only_kernel << ". Use --help to list kernels.\n";
+            return 1;
+        }
+    }
+
+    if (reps < 1 || warmup < 0 || batch < 1) {
+        std::cerr << "Error: Invalid number of repetitions or blocks given.\n";
+        return 1;
+    }
+
+    int pinned = pin_cpu(cpu);
+    if (pinned < 0) std::cerr << "Warning: Unable to pin to a CPU. Results may vary.\n";
+
+    struct utsname host;
+    if (uname(&host) != 0) {
+        strcpy(host.nodename, "unknown");
+        strcpy(host.machine, "unknown");
+    }
+
+    if (csv) {
+        printf("rev,host,machine,cpu,kernel,samples,reps,batch,median_ns,mad_ns,ns_per_sample,budget_pct\n");
+    } else {
+        printf("Host %s (%s), CPU %d, revision %s. %d repetitions of %d blocks after %d warm up repetitions:\n",
+               host.nodename, host.machine, pinned, BENCH_GIT_REV, reps, batch, warmup);
+        printf("    %-12s %8s %12s %10s %10s %10s\n", "Kernel", "Samples", "ns/block", "MAD ns", "ns/sample", "% of 32ms");
+    }
+
+    for (auto &kernel : kernels) {
+        if (!only_kernel.empty() && only_kernel != kernel.name) continue;
+
+        KernelResult result = run_kernel(kernel, warmup, reps, batch);
+        double       per_sample = result.median_ns / kernel.samples;
+        double       budget = 100.0 * result.median_ns / BLOCK_TIME_NS;
+
+        if (csv) {
+            printf("%s,%s,%s,%d,%s,%u,%d,%d,%.1f,%.1f,%.3f,%.5f\n", BENCH_GIT_REV, host.nodename, host.machine, pinned,
+                   kernel.name, kernel.samples, reps, batch, result.median_ns, result.mad_ns, per_sample, budget);
+        } else {
+            printf("    %-12s %8u %12.1f %10.1f %10.3f %10.4f\n", kernel.name, kernel.samples, result.median_ns,
+                   result.mad_ns, per_sample, budget);
+        }
+    }
+
+    return 0;
+}
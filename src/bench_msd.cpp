@@ -0,0 +1,580 @@
+//
+// Micro benchmark for the multi stage down sampler
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Standard C includes
+#include <stdio.h>
+
+// Standard C++ includes
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <complex>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Libraries we use
+#include <popt.h>
+
+// Local includes
+#include "rate_plan.hpp"
+#include "bench_msd.hpp"
+#include "fir.hpp"
+#include "coeffs.hpp"
+#include "filters/fs_00016_16bit_ch.hpp"
+
+#define VERIFY_BLOCKS   2      // Blocks compared after the warm up block when verifying
+#define VERIFY_MIN_SNR  90.0   // Min SNR in dB of the difference between a kernel and the reference
+
+// Kernel variants compiled into the benchmark
+static const BenchKernel kernels[] = {
+    { "portable", bench_msd_supported_portable, bench_msd_run_portable },
+#ifdef BENCH_HAVE_AVX2
+    { "avx2",     bench_msd_supported_avx2,     bench_msd_run_avx2 },
+#endif
+#ifdef BENCH_HAVE_NEON
+    { "neon",     bench_msd_supported_neon,     bench_msd_run_neon },
+#endif
+};
+
+
+// One 32ms block of synthetic IQ data. Noise at the level of an 8 bit ADC
+// with a few carriers. A simple LCG is used so that the data is the same on
+// every host
+static std::vector<iqsample_t> make_block(SampleRate rate, unsigned len) {
+    std::vector<iqsample_t> data(len);
+    double                  fs = sample_rate_to_uint(rate);
+    uint32_t                seed = 1;
+
+    auto noise = [&seed](void) {
+        seed = seed * 1664525u + 1013904223u;
+        return ((float)(seed >> 8) / (float)(1u << 24) - 0.5f) / 64.0f;
+    };
+
+    for (unsigned n = 0; n < len; ++n) {
+        iqsample_t sample(noise(), noise());
+        for (double fq : { -0.3 * fs, 0.1 * fs, 0.25 * fs }) {
+            sample += std::polar(0.2f, (float)(2.0 * M_PI * fq * n / fs));
+        }
+        data[n] = sample;
+    }
+
+    return data;
+}
+
+
+// Down sampler configuration for num_channels channels spread out over the
+// usable bandwidth
+static BenchCase make_case(const RatePlan &plan, SampleRate rate, bool use_ftfir, unsigned num_channels) {
+    BenchCase bench_case;
+
+    for (auto &stage : plan.stages) {
+        bench_case.factors.push_back(stage.m);
+        bench_case.filters.push_back(stage.h);
+    }
+    bench_case.use_ftfir = use_ftfir;
+
+    // Channel offsets in 8.33kHz steps within +/-40% of the sample rate.
+    // Offset 0 is avoided since it needs no translation
+    int max_offset = (int)(sample_rate_to_uint(rate) * 0.4 / 8333.33333);
+    for (unsigned ch = 0; ch < num_channels; ++ch) {
+        int ch_offset = -max_offset + (int)((2 * max_offset * (ch + 1)) / (num_channels + 1));
+        if (ch_offset == 0) ch_offset = 1;
+        bench_case.translators.push_back(make_translator(ch_offset, plan, use_ftfir));
+    }
+
+    return bench_case;
+}
+
+
+// Straight forward double precision model of MSD, used as reference when
+// verifying the kernel variants. It follows MSD sample by sample: the delay
+// lines start out empty, an output is produced for every m:th input and the
+// frequency translating FIR uses the same coefficient sets
+class RefMSD {
+public:
+    using cdouble = std::complex<double>;
+
+    RefMSD(const BenchCase &bench_case, const std::vector<iqsample_t> &translator) :
+      translator_(translator.begin(), translator.end()), trans_pos_(0), use_ftfir_(bench_case.use_ftfir) {
+        for (unsigned i = 0; i < bench_case.factors.size(); ++i) {
+            const std::vector<float> &h = bench_case.filters[i];
+            stages_.push_back({ bench_case.factors[i], std::vector<double>(h.begin(), h.end()),
+                                std::vector<cdouble>(h.size()), 0, 0, 0 });
+        }
+    }
+
+    void decimate(const std::vector<iqsample_t> &in, std::vector<cdouble> &out) {
+        for (auto &in_sample : in) {
+            cdouble sample = cdouble(in_sample.real(), in_sample.imag());
+
+            bool translate = !translator_.empty();
+            if (translate && !use_ftfir_) {
+                sample *= translator_[trans_pos_];
+                if (++trans_pos_ == translator_.size()) trans_pos_ = 0;
+            }
+
+            unsigned s = 0;
+            for (; s < stages_.size(); ++s) {
+                if (!push(stages_[s], sample)) break;
+                sample = (s == 0 && translate && use_ftfir_) ? outputTranslated(stages_[s]) : output(stages_[s]);
+            }
+            if (s == stages_.size()) out.push_back(sample);
+        }
+    }
+
+private:
+    struct Stage {
+        unsigned             m;
+        std::vector<double>  h;
+        std::vector<cdouble> d;      // Delay line. d[pos] is the oldest sample
+        unsigned             pos;
+        unsigned             count;  // Samples since the last output
+        unsigned             k;      // Frequency translating FIR coefficient set
+    };
+
+    std::vector<cdouble> translator_;
+    unsigned             trans_pos_;
+    bool                 use_ftfir_;
+    std::vector<Stage>   stages_;
+
+    static bool push(Stage &stage, cdouble sample) {
+        stage.d[stage.pos] = sample;
+        if (++stage.pos == stage.d.size()) stage.pos = 0;
+        if (++stage.count < stage.m) return false;
+
+        stage.count = 0;
+        return true;
+    }
+
+    static cdouble output(const Stage &stage) {
+        cdouble sum = 0.0;
+        for (unsigned i = 0; i < stage.h.size(); ++i) sum += stage.h[i] * stage.d[(stage.pos + i) % stage.d.size()];
+
+        return sum;
+    }
+
+    // The translator is applied to the coefficients, relative to the first
+    // sample in the delay line, with the gain compensation of MSD
+    cdouble outputTranslated(Stage &stage) {
+        cdouble sum = 0.0;
+        for (unsigned i = 0; i < stage.h.size(); ++i) {
+            cdouble c = stage.h[i] * translator_[(stage.k * stage.m + i) % translator_.size()] * 2.0;
+            sum += c * stage.d[(stage.pos + i) % stage.d.size()];
+        }
+        if (++stage.k == translator_.size() / stage.m) stage.k = 0;
+
+        return sum;
+    }
+};
+
+
+// SNR in dB of the difference between out and the reference
+template<typename T>
+static double diff_snr(const std::vector<std::complex<double>> &ref, const T *out, unsigned len) {
+    double sig = 0.0;
+    double err = 0.0;
+
+    for (unsigned i = 0; i < len; ++i) {
+        std::complex<double> o(out[i].real(), out[i].imag());
+        sig += std::norm(ref[i]);
+        err += std::norm(o - ref[i]);
+    }
+
+    if (err == 0.0) return 999.0;
+    return 10.0 * std::log10(sig / err);
+}
+
+
+// Output of a plain FIR filter, in double precision, for input x
+static std::vector<std::complex<double>> ref_fir(const std::vector<float> &c, const std::vector<std::complex<double>> &x) {
+    std::vector<std::complex<double>> y(x.size());
+
+    for (unsigned n = 0; n < x.size(); ++n) {
+        for (unsigned i = 0; i < c.size(); ++i) {
+            if (n + 1 + i >= c.size()) y[n] += (double)c[i] * x[n + 1 + i - c.size()];
+        }
+    }
+
+    return y;
+}
+
+
+// Alias zone requirements for the down sampling filters, as stated in the
+// filter headers. Some filters in use do not reach the stated attenuation.
+// For those, the attenuation reached when the table was written is given in
+// known_att so that they still can not get worse
+struct FilterSpec {
+    const char               *name;
+    const std::vector<float> &h;
+    double                    fs;         // Sample rate in kHz at the filter input
+    unsigned                  m;          // Down sampling factor. 1 for a channel filter
+    double                    fcut;       // Care band in kHz. For a channel filter, the start of the stop band
+    double                    min_att;    // Required attenuation in dB in the alias zones
+    double                    known_att;  // Attenuation reached if below min_att. 0 if min_att is met
+};
+
+static const FilterSpec filter_specs[] = {
+    { "fs_00960_08bit_ds_lpf1_00960_to_00320",  fs_00960_08bit_ds_lpf1_00960_to_00320,   960,  3, 10, 50, 0 },
+    { "fs_00960_08bit_ds_lpf2_00320_to_00080",  fs_00960_08bit_ds_lpf2_00320_to_00080,   320,  4, 10, 55, 0 },
+    { "fs_00960_08bit_ds_lpf3_00080_to_00016",  fs_00960_08bit_ds_lpf3_00080_to_00016,    80,  5,  5, 61, 0 },
+    { "fs_01200_08bit_ds_lpf1_01200_to_00400",  fs_01200_08bit_ds_lpf1_01200_to_00400,  1200,  3, 10, 50, 0 },
+    { "fs_01200_08bit_ds_lpf2_00400_to_00080",  fs_01200_08bit_ds_lpf2_00400_to_00080,   400,  5, 10, 55, 0 },
+    { "fs_01200_08bit_ds_lpf3_00080_to_00016",  fs_01200_08bit_ds_lpf3_00080_to_00016,    80,  5,  5, 62, 0 },
+    { "fs_01440_08bit_ds_lpf1_01440_to_00400",  fs_01440_08bit_ds_lpf1_01440_to_00400,  1440,  3, 10, 50, 0 },
+    { "fs_01440_08bit_ds_lpf2_00480_to_00080",  fs_01440_08bit_ds_lpf2_00480_to_00080,   480,  6, 10, 55, 0 },
+    { "fs_01440_08bit_ds_lpf3_00080_to_00016",  fs_01440_08bit_ds_lpf3_00080_to_00016,    80,  5,  5, 63, 0 },
+    { "fs_01600_08bit_ds_lpf1_01600_to_00400",  fs_01600_08bit_ds_lpf1_01600_to_00400,  1600,  4, 10, 50, 0 },
+    { "fs_01600_08bit_ds_lpf2_00400_to_00080",  fs_01600_08bit_ds_lpf2_00400_to_00080,   400,  5, 10, 56, 55.3 },
+    { "fs_01600_08bit_ds_lpf3_00080_to_00016",  fs_01600_08bit_ds_lpf3_00080_to_00016,    80,  5,  5, 63, 0 },
+    { "fs_01920_08bit_ds_lpf1_01920_to_00480",  fs_01920_08bit_ds_lpf1_01920_to_00480,  1920,  4, 10, 50, 0 },
+    { "fs_01920_08bit_ds_lpf2_00480_to_00080",  fs_01920_08bit_ds_lpf2_00480_to_00080,   480,  6, 10, 56, 0 },
+    { "fs_01920_08bit_ds_lpf3_00080_to_00016",  fs_01920_08bit_ds_lpf3_00080_to_00016,    80,  5,  5, 63, 0 },
+    { "fs_02400_08bit_ds_lpf1_02400_to_01200",  fs_02400_08bit_ds_lpf1_02400_to_01200,  2400,  2, 10, 50, 0 },
+    { "fs_02400_08bit_ds_lpf2_01200_to_00400",  fs_02400_08bit_ds_lpf2_01200_to_00400,  1200,  3, 10, 53, 0 },
+    { "fs_02400_08bit_ds_lpf3_00400_to_00080",  fs_02400_08bit_ds_lpf3_00400_to_00080,   400,  5, 10, 58, 57.7 },
+    { "fs_02400_08bit_ds_lpf4_00080_to_00016",  fs_02400_08bit_ds_lpf4_00080_to_00016,    80,  5,  5, 65, 63.1 },
+    { "fs_02560_08bit_ds_lpf1_02560_to_00128",  fs_02560_08bit_ds_lpf1_02560_to_00128,  2560, 20, 10, 50, 0 },
+    { "fs_02560_08bit_ds_lpf2_00128_to_00032",  fs_02560_08bit_ds_lpf2_00128_to_00032,   128,  4,  5, 63, 0 },
+    { "fs_02560_08bit_ds_lpf4_00032_to_00016",  fs_02560_08bit_ds_lpf4_00032_to_00016,    32,  2,  5, 69, 0 },
+    { "fs_06000_12bit_ds_lpf1_06000_to_00400",  fs_06000_12bit_ds_lpf1_06000_to_00400,  6000, 15, 10, 74, 0 },
+    { "fs_06000_12bit_ds_lpf3_00400_to_00080",  fs_06000_12bit_ds_lpf3_00400_to_00080,   400,  5,  5, 86, 0 },
+    { "fs_06000_12bit_ds_lpf4_00080_to_00016",  fs_06000_12bit_ds_lpf4_00080_to_00016,    80,  5,  5, 93, 92.2 },
+    { "fs_10000_12bit_ds_lpf1_10000_to_02000",  fs_10000_12bit_ds_lpf1_10000_to_02000, 10000,  5, 10, 74, 0 },
+    { "fs_10000_12bit_ds_lpf2_02000_to_00400",  fs_10000_12bit_ds_lpf2_02000_to_00400,  2000,  5, 10, 81, 0 },
+    { "fs_10000_12bit_ds_lpf3_00400_to_00800",  fs_10000_12bit_ds_lpf3_00400_to_00800,   400,  5,  5, 88, 0 },
+    { "fs_10000_12bit_ds_lpf4_00080_to_00016",  fs_10000_12bit_ds_lpf4_00080_to_00016,    80,  5,  5, 95, 92.2 },
+    { "fs_00016_16bit_ch_amdemod_lpf1",         fs_00016_16bit_ch_amdemod_lpf1,           16,  1,  5, 99, 96.7 },
+};
+
+
+// Least attenuation in dB, relative to DC, in the alias zones of a filter.
+// The zones are the bands that fold into the care band when down sampling
+// by m. For a channel filter the zone is the stop band up to fs/2
+static double alias_zone_attenuation(const FilterSpec &spec) {
+    std::vector<std::pair<double, double>> zones;
+
+    if (spec.m == 1) {
+        zones.push_back({ spec.fcut, spec.fs / 2 });
+    } else {
+        for (unsigned k = 1; k <= spec.m / 2; ++k) {
+            double center = k * spec.fs / spec.m;
+            zones.push_back({ center - spec.fcut, std::min(center + spec.fcut, spec.fs / 2) });
+        }
+    }
+
+    auto response = [&spec](double fq) {
+        std::complex<double> sum = 0.0;
+        for (unsigned i = 0; i < spec.h.size(); ++i) sum += (double)spec.h[i] * std::polar(1.0, -2.0 * M_PI * fq / spec.fs * i);
+        return std::abs(sum);
+    };
+
+    double dc = response(0.0);
+    double max_level = 0.0;
+    for (auto &zone : zones) {
+        for (unsigned n = 0; n <= 256; ++n) {
+            max_level = std::max(max_level, response(zone.first + (zone.second - zone.first) * n / 256));
+        }
+    }
+
+    return -20.0 * std::log10(max_level / dc);
+}
+
+
+// Run the kernel variants and the FIR classes against the double precision
+// references and check the filter responses. Returns false if anything fails
+static bool verify(SampleRate only_rate, const std::string &only_kernel) {
+    bool ok = true;
+
+    // Kernels. Four translated channels and one channel at the tuner
+    // frequency so that all code paths are covered
+    printf("Down sampler vs double precision reference, SNR of difference in dB (min %.0f):\n", VERIFY_MIN_SNR);
+    printf("%-6s %-5s %-8s %8s %6s\n", "Rate", "FTFIR", "Kernel", "SNR", "Result");
+    for (int r = 0; r < (int)SampleRate::UNSPECIFIED; ++r) {
+        SampleRate rate = (SampleRate)r;
+        if (only_rate != SampleRate::UNSPECIFIED && rate != only_rate) continue;
+
+        RatePlan plan = get_rate_plan(rate);
+        if (plan.N == 0 || plan.stages.empty()) continue;
+
+        unsigned m = 1;
+        for (auto &stage : plan.stages) m *= stage.m;
+
+        std::vector<iqsample_t> data = make_block(rate, 512 * m);
+        std::vector<iqsample_t> out;
+
+        for (bool use_ftfir : { false, true }) {
+            BenchCase bench_case = make_case(plan, rate, use_ftfir, 4);
+            bench_case.translators.push_back(std::vector<iqsample_t>());
+
+            // Reference output for the last block of each channel
+            std::vector<std::complex<double>> ref;
+            for (auto &translator : bench_case.translators) {
+                RefMSD                            ref_msd(bench_case, translator);
+                std::vector<std::complex<double>> ref_out;
+
+                for (unsigned block = 0; block <= VERIFY_BLOCKS; ++block) {
+                    ref_out.clear();
+                    ref_msd.decimate(data, ref_out);
+                }
+                ref.insert(ref.end(), ref_out.begin(), ref_out.end());
+            }
+
+            for (auto &kernel : kernels) {
+                if (!only_kernel.empty() && only_kernel != kernel.name) continue;
+                if (!kernel.supported()) continue;
+
+                kernel.run(bench_case, data, VERIFY_BLOCKS, out);
+
+                double snr  = out.size() == ref.size() ? diff_snr(ref, out.data(), out.size()) : 0.0;
+                bool   pass = snr >= VERIFY_MIN_SNR;
+                printf("%-6s %-5s %-8s %8.1f %6s\n", sample_rate_to_str(rate), use_ftfir ? "on" : "off", kernel.name, snr, pass ? "PASS" : "FAIL");
+                ok = ok && pass;
+            }
+        }
+    }
+
+    // FIR classes. Noise as input
+    printf("\nFIR classes vs double precision reference, SNR of difference in dB (min %.0f):\n", VERIFY_MIN_SNR);
+    {
+        std::vector<std::complex<double>> x(512 * 3);
+        uint32_t                          seed = 1;
+        for (auto &sample : x) {
+            seed = seed * 1664525u + 1013904223u;
+            double re = (double)(seed >> 8) / (1u << 24) - 0.5;
+            seed = seed * 1664525u + 1013904223u;
+            double im = (double)(seed >> 8) / (1u << 24) - 0.5;
+            sample = std::complex<double>((float)re, (float)im);
+        }
+
+        // FIR2 takes interleaved stereo. Real part is left and imag part right
+        std::vector<float> stereo;
+        for (auto &sample : x) {
+            stereo.push_back(sample.real());
+            stereo.push_back(sample.imag());
+        }
+        FIR2 fir2(coeff_bp4am_channel);
+        fir2.filter(stereo.data(), stereo.size(), stereo.data());
+
+        std::vector<iqsample_t> fir2_out;
+        for (unsigned i = 0; i < stereo.size(); i += 2) fir2_out.push_back(iqsample_t(stereo[i], stereo[i + 1]));
+
+        std::vector<iqsample_t> iq(x.begin(), x.end());
+        FIR3<iqsample_t>        fir3(fs_00016_16bit_ch_amdemod_lpf1);
+        fir3.filter(iq.data(), iq.size(), iq.data());
+
+        double fir2_snr = diff_snr(ref_fir(coeff_bp4am_channel, x), fir2_out.data(), fir2_out.size());
+        double fir3_snr = diff_snr(ref_fir(fs_00016_16bit_ch_amdemod_lpf1, x), iq.data(), iq.size());
+
+        printf("%-30s %8.1f %6s\n", "FIR2 (audio filter)", fir2_snr, fir2_snr >= VERIFY_MIN_SNR ? "PASS" : "FAIL");
+        printf("%-30s %8.1f %6s\n", "FIR3 (channel filter)", fir3_snr, fir3_snr >= VERIFY_MIN_SNR ? "PASS" : "FAIL");
+        ok = ok && fir2_snr >= VERIFY_MIN_SNR && fir3_snr >= VERIFY_MIN_SNR;
+    }
+
+    // Filter responses. A filter that is in a rate plan but not in the spec
+    // table is a failure
+    printf("\nFilter attenuation in the alias zones in dB:\n");
+    printf("%-40s %6s %6s %6s\n", "Filter", "Req", "Att", "Result");
+    for (auto &spec : filter_specs) {
+        double att = alias_zone_attenuation(spec);
+
+        std::string result = "PASS";
+        if (att < spec.min_att) {
+            result = spec.known_att > 0 && att >= spec.known_att ? "KNOWN" : "FAIL";
+        }
+        printf("%-40s %6.1f %6.1f %6s\n", spec.name, spec.min_att, att, result.c_str());
+        ok = ok && result != "FAIL";
+    }
+
+    for (int r = 0; r < (int)SampleRate::UNSPECIFIED; ++r) {
+        RatePlan plan = get_rate_plan((SampleRate)r);
+        for (unsigned s = 0; s < plan.stages.size(); ++s) {
+            auto match = [&plan, s](const FilterSpec &spec) { return spec.h == plan.stages[s].h; };
+            if (std::none_of(std::begin(filter_specs), std::end(filter_specs), match)) {
+                printf("%s stage %u: filter has no requirement in the spec table. FAIL\n", sample_rate_to_str((SampleRate)r), s + 1);
+                ok = false;
+            }
+        }
+    }
+
+    printf("\n%s\n", ok ? "All checks passed" : "Verification FAILED");
+
+    return ok;
+}
+
+
+static std::vector<unsigned> parse_channel_counts(const std::string &str) {
+    std::vector<unsigned> counts;
+    std::stringstream     ss(str);
+    std::string           item;
+
+    while (std::getline(ss, item, ',')) {
+        try {
+            int count = std::stoi(item);
+            if (count < 1 || count > 256) return std::vector<unsigned>();
+            counts.push_back(count);
+        } catch (...) {
+            return std::vector<unsigned>();
+        }
+    }
+
+    return counts;
+}
+
+
+int main(int argc, char **argv) {
+    int                   ret;
+    poptContext           popt_ctx;
+    int                   print_help = 0;
+    int                   num_blocks = 30;
+    int                   do_verify = 0;
+    char                 *rate_str = nullptr;
+    char                 *channels_str = nullptr;
+    char                 *kernel_str = nullptr;
+    std::vector<unsigned> channel_counts = { 1, 4, 16 };
+    SampleRate            only_rate = SampleRate::UNSPECIFIED;
+    std::string           only_kernel;
+
+    struct poptOption options_table[] = {
+        { "rate",     'r', POPT_ARG_STRING, &rate_str, 0, "only benchmark this sample rate in MS/s. All rates if not set", "RATE" },
+        { "channels", 'c', POPT_ARG_STRING, &channels_str, 0, "comma separated list of channel counts. Defaults to 1,4,16 if not set", "LIST" },
+        { "blocks",   'b', POPT_ARG_INT,    &num_blocks, 0, "number of 32ms blocks to run for each measurement. Defaults to 30 if not set", "NUM" },
+        { "kernel",   'k', POPT_ARG_STRING, &kernel_str, 0, "only benchmark this kernel variant. All compiled in variants if not set", "KERNEL" },
+        { "verify",   'v', POPT_ARG_NONE,   &do_verify, 0, "verify the kernel variants and filters against a double precision reference instead of benchmarking", nullptr },
+        { "help",     'h', POPT_ARG_NONE,   &print_help, 0, "show full help and quit", nullptr },
+        POPT_TABLEEND
+    };
+
+    // Create popt instance
+    popt_ctx = poptGetContext(nullptr, argc, (const char**)argv, options_table, POPT_CONTEXT_POSIXMEHARDER);
+    poptSetOtherOptionHelp(popt_ctx, "[OPTION...]");
+
+    while ((ret = poptGetNextOpt(popt_ctx)) > 0);
+    if (ret < -1) {
+        // Error while parsing the options. Print the reason
+        switch (ret) {
+            case POPT_ERROR_BADOPT:
+                std::cerr << "Error: Unknown option given.\n";
+                break;
+            case POPT_ERROR_NOARG:
+                std::cerr << "Error: Missing option value.\n";
+                break;
+            case POPT_ERROR_BADNUMBER:
+            case POPT_ERROR_OVERFLOW:
+                std::cerr << "Error: Option could not be converted to number.\n";
+                break;
+            default:
+                std::cerr << "Error: Unknown error in option parsing, ret = " << ret << ".\n";
+                break;
+        }
+        poptPrintHelp(popt_ctx, stderr, 0);
+        poptFreeContext(popt_ctx);
+        return 1;
+    }
+
+    if (print_help) {
+        poptPrintHelp(popt_ctx, stderr, 0);
+        std::cerr << R"(
+Runs the multi stage down sampler for every supported sample rate, with and
+without frequency translating FIR, on synthetic data. No device is needed.
+
+Kernel variants compiled in:)";
+        for (auto &kernel : kernels) std::cerr << " " << kernel.name;
+        std::cerr << std::endl;
+        poptFreeContext(popt_ctx);
+        return 0;
+    }
+
+    poptFreeContext(popt_ctx);
+
+    if (rate_str) {
+        only_rate = str_to_sample_rate(rate_str);
+        free(rate_str);
+        if (only_rate == SampleRate::UNSPECIFIED) {
+            std::cerr << "Error: Invalid sample rate given.\n";
+            return 1;
+        }
+    }
+
+    if (channels_str) {
+        channel_counts = parse_channel_counts(channels_str);
+        free(channels_str);
+        if (channel_counts.empty()) {
+            std::cerr << "Error: Invalid channel counts given.\n";
+            return 1;
+        }
+    }
+
+    if (kernel_str) {
+        only_kernel = kernel_str;
+        free(kernel_str);
+    }
+
+    if (num_blocks < 1) {
+        std::cerr << "Error: Invalid number of blocks given.\n";
+        return 1;
+    }
+
+    if (do_verify) return verify(only_rate, only_kernel) ? 0 : 1;
+
+    printf("%-6s %-5s %-8s %4s %10s %10s %8s %8s\n", "Rate", "FTFIR", "Kernel", "Ch", "ns/sample", "MS/s/ch", "RTF/ch", "Max ch");
+
+    for (int r = 0; r < (int)SampleRate::UNSPECIFIED; ++r) {
+        SampleRate rate = (SampleRate)r;
+        if (only_rate != SampleRate::UNSPECIFIED && rate != only_rate) continue;
+
+        RatePlan plan = get_rate_plan(rate);
+        if (plan.N == 0 || plan.stages.empty()) continue;
+
+        unsigned m = 1;
+        for (auto &stage : plan.stages) m *= stage.m;
+
+        double                  fs = sample_rate_to_uint(rate);
+        std::vector<iqsample_t> data = make_block(rate, 512 * m);
+        std::vector<iqsample_t> out;
+        double                  signal_time = num_blocks * data.size() / fs;
+
+        for (bool use_ftfir : { false, true }) {
+            for (unsigned num_channels : channel_counts) {
+                BenchCase bench_case = make_case(plan, rate, use_ftfir, num_channels);
+
+                for (auto &kernel : kernels) {
+                    if (!only_kernel.empty() && only_kernel != kernel.name) continue;
+                    if (!kernel.supported()) continue;
+
+                    double elapsed = kernel.run(bench_case, data, num_blocks, out);
+                    // Input samples handled summed over all channels. Time
+                    // per sample and throughput are per channel. The real
+                    // time factor is the fraction of one core needed per
+                    // channel
+                    double samples = (double)num_blocks * data.size() * num_channels;
+                    double rtf     = (elapsed / num_channels) / signal_time;
+
+                    printf("%-6s %-5s %-8s %4u %10.2f %10.2f %8.4f %8.1f\n",
+                           sample_rate_to_str(rate), use_ftfir ? "on" : "off", kernel.name, num_channels,
+                           elapsed * 1e9 / samples, samples / elapsed / 1e6, rtf, 1.0 / rtf);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
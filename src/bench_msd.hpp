@@ -0,0 +1,63 @@
+//
+// Interface between the down sampler benchmark and its kernel variants
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef BENCH_MSD_HPP
+#define BENCH_MSD_HPP
+
+#include <vector>
+
+#include "iqsample.hpp"
+
+// Down sampler configuration for one benchmark run. Only standard types are
+// used since every kernel variant has a MSD class of its own
+struct BenchCase {
+    std::vector<unsigned>                factors;      // Down sampling factor for each stage
+    std::vector<std::vector<float>>      filters;      // FIR coefficients for each stage
+    std::vector<std::vector<iqsample_t>> translators;  // Translator for each channel
+    bool                                 use_ftfir;
+};
+
+// Run num_blocks blocks of data through one down sampler per channel. The
+// output of the last block of each channel is written to out, one channel
+// after the other. Returns the elapsed time in seconds
+using bench_run_t = double (*)(const BenchCase &bench_case, const std::vector<iqsample_t> &data, unsigned num_blocks, std::vector<iqsample_t> &out);
+
+// A compiled kernel variant
+struct BenchKernel {
+    const char  *name;
+    bool       (*supported)(void);  // The host can run the variant
+    bench_run_t  run;
+};
+
+// Kernel variants. Defined in bench_msd_kernel.cpp that is compiled once for
+// each variant
+#define BENCH_KERNEL_DECL(variant) \
+    bool   bench_msd_supported_##variant(void); \
+    double bench_msd_run_##variant(const BenchCase&, const std::vector<iqsample_t>&, unsigned, std::vector<iqsample_t>&);
+
+BENCH_KERNEL_DECL(portable)
+#ifdef BENCH_HAVE_AVX2
+BENCH_KERNEL_DECL(avx2)
+#endif
+#ifdef BENCH_HAVE_NEON
+BENCH_KERNEL_DECL(neon)
+#endif
+
+#endif // BENCH_MSD_HPP
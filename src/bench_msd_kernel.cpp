@@ -0,0 +1,98 @@
+//
+// Kernel variant for the down sampler benchmark
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// This file is compiled once for each kernel variant with BENCH_KERNEL set
+// to the variant name and the instruction set flags of the variant. MSD is
+// header only so msd.hpp is included in a namespace of its own. Otherwise the
+// inline functions of the variants would be merged by the linker.
+
+#ifndef BENCH_KERNEL
+#error "BENCH_KERNEL must be defined"
+#endif
+
+// Standard C++ includes. Must be included before msd.hpp is pulled into the
+// variant namespace
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cassert>
+#include <chrono>
+
+#if defined __AVX2__
+#include <immintrin.h>
+#elif defined __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+// Local includes
+#include "iqsample.hpp"
+#include "bench_msd.hpp"
+
+#define BENCH_CAT_(a, b) a##b
+#define BENCH_CAT(a, b) BENCH_CAT_(a, b)
+#define BENCH_NS BENCH_CAT(bench_, BENCH_KERNEL)
+
+namespace BENCH_NS {
+#include "msd.hpp"
+}
+
+
+bool BENCH_CAT(bench_msd_supported_, BENCH_KERNEL)(void) {
+#if defined __AVX2__ && (defined __x86_64__ || defined __i386__)
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return true;
+#endif
+}
+
+
+double BENCH_CAT(bench_msd_run_, BENCH_KERNEL)(const BenchCase &bench_case, const std::vector<iqsample_t> &data, unsigned num_blocks, std::vector<iqsample_t> &out) {
+    using MSD = BENCH_NS::MSD;
+
+    std::vector<MSD::Stage> stages;
+    unsigned                m = 1;
+    for (unsigned i = 0; i < bench_case.factors.size(); ++i) {
+        stages.push_back({ bench_case.factors[i], bench_case.filters[i] });
+        m *= bench_case.factors[i];
+    }
+
+    std::vector<MSD> msds;
+    for (auto &translator : bench_case.translators) {
+        msds.push_back(MSD(translator, stages, bench_case.use_ftfir));
+    }
+
+    unsigned out_len = data.size() / m;
+    out.resize(out_len * msds.size());
+
+    // One block to warm up the caches and fill the delay lines
+    for (unsigned ch = 0; ch < msds.size(); ++ch) {
+        msds[ch].decimate(data.data(), data.size(), &out[ch * out_len]);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned block = 0; block < num_blocks; ++block) {
+        for (unsigned ch = 0; ch < msds.size(); ++ch) {
+            msds[ch].decimate(data.data(), data.size(), &out[ch * out_len]);
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double>(stop - start).count();
+}
@@ -0,0 +1,498 @@
+//
+// Lightweight audio codecs for network outputs
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef CODEC_HPP
+#define CODEC_HPP
+
+#include <vector>
+#include <string>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+
+#if defined __AVX2__
+#include <immintrin.h>
+#elif defined __ARM_NEON
+#include <arm_neon.h>
+#else
+//#pragma message "NO AVX2 or NEON SIMD available. Using normal code"
+#endif
+
+// In-tree codecs for 16kS/s mono audio frames. No external libraries are
+// needed. Compared to 16 bit PCM (256kbit/s) G.711 halves the bandwidth
+// (128kbit/s) and IMA-ADPCM reduces it by four (64kbit/s + 4 bytes header
+// per frame).
+//
+// Float samples are expected in the range -1.0 to 1.0 and are converted to
+// 16 bit the same way as the ALSA output does before they are encoded.
+//
+// G.711 references:
+//     https://www.itu.int/rec/T-REC-G.711
+//     Sun Microsystems g711.c (public domain)
+//
+// IMA-ADPCM reference:
+//     https://wiki.multimedia.cx/index.php/IMA_ADPCM
+enum class Codec { UNSPECIFIED, S16, ULAW, ALAW, ADPCM };
+
+
+static inline const std::string &codec_to_str(Codec codec) {
+    static const std::string S16_STR("S16");
+    static const std::string ULAW_STR("ULAW");
+    static const std::string ALAW_STR("ALAW");
+    static const std::string ADPCM_STR("ADPCM");
+    static const std::string UNKNOWN_STR("Unknown");
+
+    switch (codec) {
+        case Codec::S16:   return S16_STR;
+        case Codec::ULAW:  return ULAW_STR;
+        case Codec::ALAW:  return ALAW_STR;
+        case Codec::ADPCM: return ADPCM_STR;
+        default:           return UNKNOWN_STR;
+    }
+}
+
+
+static inline Codec str_to_codec(const std::string &str) {
+    if      (str == "S16")   return Codec::S16;
+    else if (str == "ULAW")  return Codec::ULAW;
+    else if (str == "ALAW")  return Codec::ALAW;
+    else if (str == "ADPCM") return Codec::ADPCM;
+    else                     return Codec::UNSPECIFIED;
+}
+
+
+namespace g711 {
+
+// Convert one float sample to 16 bit with clipping
+static inline int32_t to_s16(float sample) {
+    if (sample > 1.0f)       sample = 1.0f;
+    else if (sample < -1.0f) sample = -1.0f;
+
+    return (int32_t)(sample * 32767.0f);
+}
+
+
+// floor(log2(v)) for 1 <= v < 2^24. The int to float conversion is exact in
+// that range so the exponent field is what we want. This avoids the
+// segment search loop of the classic implementations and is done the same
+// way in the SIMD variants below.
+static inline int32_t ilog2(int32_t v) {
+    return (int32_t)((std::bit_cast<uint32_t>((float)v) >> 23) & 0xff) - 127;
+}
+
+
+// Encode one 16 bit sample to μ-law
+static inline uint8_t ulaw_encode(int32_t pcm) {
+    int32_t sign = pcm < 0 ? 0x80 : 0x00;
+    int32_t mag  = pcm < 0 ? -pcm : pcm;
+
+    if (mag > 32635) mag = 32635;
+    mag += 0x84;
+
+    int32_t exponent = ilog2(mag) - 7;
+    int32_t mantissa = (mag >> (exponent + 3)) & 0x0f;
+
+    return (uint8_t)~(sign | (exponent << 4) | mantissa);
+}
+
+
+// Encode one 16 bit sample to A-law
+static inline uint8_t alaw_encode(int32_t pcm) {
+    int32_t v    = pcm >> 3; // 13 bit
+    int32_t mask = 0xd5;
+
+    if (v < 0) {
+        mask = 0x55;
+        v = -v - 1;
+    }
+
+    // Values over 0xfff saturates to the max code
+    if (v > 0xfff) v = 0xfff;
+
+    int32_t seg = ilog2(v | 1) - 4;
+    if (seg < 0) seg = 0;
+    int32_t shift = seg < 1 ? 1 : seg;
+
+    return (uint8_t)(((seg << 4) | ((v >> shift) & 0x0f)) ^ mask);
+}
+
+
+// Decode tables. Built once at compile time
+static constexpr std::array<int16_t, 256> ulaw_table = [] {
+    std::array<int16_t, 256> t{};
+    for (unsigned i = 0; i < 256; ++i) {
+        unsigned u = ~i & 0xff;
+        int exponent = (u >> 4) & 0x07;
+        int mantissa = u & 0x0f;
+        int sample = (((mantissa << 3) + 0x84) << exponent) - 0x84;
+        t[i] = (int16_t)((u & 0x80) ? -sample : sample);
+    }
+    return t;
+}();
+
+static constexpr std::array<int16_t, 256> alaw_table = [] {
+    std::array<int16_t, 256> t{};
+    for (unsigned i = 0; i < 256; ++i) {
+        unsigned a = i ^ 0x55;
+        int sample = (a & 0x0f) << 4;
+        int seg = (a & 0x70) >> 4;
+        switch (seg) {
+            case 0:  sample += 8; break;
+            case 1:  sample += 0x108; break;
+            default: sample += 0x108; sample <<= seg - 1; break;
+        }
+        t[i] = (int16_t)((a & 0x80) ? sample : -sample);
+    }
+    return t;
+}();
+
+
+// Encode a block of float samples to μ-law
+static inline void ulaw_encode(const float *in, unsigned len, uint8_t *out) {
+    unsigned i = 0;
+#ifdef __AVX2__
+    // Intel AVX SIMD variant. Eight samples per iteration. Bit exact with
+    // the normal code
+    const __m256 one       = _mm256_set1_ps(1.0f);
+    const __m256 minus_one = _mm256_set1_ps(-1.0f);
+    const __m256 scale     = _mm256_set1_ps(32767.0f);
+    const __m256i clip     = _mm256_set1_epi32(32635);
+    const __m256i bias     = _mm256_set1_epi32(0x84);
+    const __m256i exp_bias = _mm256_set1_epi32(127 + 7);
+    const __m256i three    = _mm256_set1_epi32(3);
+    const __m256i low_mask = _mm256_set1_epi32(0x0f);
+    const __m256i all_ones = _mm256_set1_epi32(0xff);
+    const __m256i zero     = _mm256_setzero_si256();
+    const __m256i sign_bit = _mm256_set1_epi32(0x80);
+    // Collect the low byte of each 32 bit lane into the low 8 bytes
+    const __m256i shuf     = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                              0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m256i perm     = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+
+    for (; i + 8 <= len; i += 8) {
+        __m256 s = _mm256_loadu_ps(&in[i]);
+        s = _mm256_min_ps(_mm256_max_ps(s, minus_one), one);
+        __m256i pcm = _mm256_cvttps_epi32(_mm256_mul_ps(s, scale));
+
+        __m256i sign = _mm256_and_si256(_mm256_cmpgt_epi32(zero, pcm), sign_bit);
+        __m256i mag  = _mm256_add_epi32(_mm256_min_epi32(_mm256_abs_epi32(pcm), clip), bias);
+
+        __m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(mag)), 23), exp_bias);
+        __m256i mantissa = _mm256_and_si256(_mm256_srlv_epi32(mag, _mm256_add_epi32(exponent, three)), low_mask);
+
+        __m256i code = _mm256_or_si256(sign, _mm256_or_si256(_mm256_slli_epi32(exponent, 4), mantissa));
+        code = _mm256_xor_si256(code, all_ones);
+
+        code = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(code, shuf), perm);
+        _mm_storel_epi64((__m128i*)&out[i], _mm256_castsi256_si128(code));
+    }
+#endif
+    // Portable version (and clean up of the trailing samples)
+    for (; i < len; ++i) {
+        out[i] = ulaw_encode(to_s16(in[i]));
+    }
+}
+
+
+// Encode a block of float samples to A-law
+static inline void alaw_encode(const float *in, unsigned len, uint8_t *out) {
+    unsigned i = 0;
+#ifdef __AVX2__
+    // Intel AVX SIMD variant. Eight samples per iteration. Bit exact with
+    // the normal code
+    const __m256 one       = _mm256_set1_ps(1.0f);
+    const __m256 minus_one = _mm256_set1_ps(-1.0f);
+    const __m256 scale     = _mm256_set1_ps(32767.0f);
+    const __m256i max_v    = _mm256_set1_epi32(0xfff);
+    const __m256i exp_bias = _mm256_set1_epi32(127 + 4);
+    const __m256i low_mask = _mm256_set1_epi32(0x0f);
+    const __m256i pos_mask = _mm256_set1_epi32(0xd5);
+    const __m256i neg_mask = _mm256_set1_epi32(0x55);
+    const __m256i zero     = _mm256_setzero_si256();
+    const __m256i v_one    = _mm256_set1_epi32(1);
+    const __m256i shuf     = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                              0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m256i perm     = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+
+    for (; i + 8 <= len; i += 8) {
+        __m256 s = _mm256_loadu_ps(&in[i]);
+        s = _mm256_min_ps(_mm256_max_ps(s, minus_one), one);
+        __m256i v = _mm256_srai_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(s, scale)), 3);
+
+        // Negative values are stored as -v - 1, i.e. ~v
+        __m256i neg  = _mm256_cmpgt_epi32(zero, v);
+        __m256i mask = _mm256_blendv_epi8(pos_mask, neg_mask, neg);
+        v = _mm256_min_epi32(_mm256_blendv_epi8(v, _mm256_xor_si256(v, _mm256_set1_epi32(-1)), neg), max_v);
+
+        __m256i seg = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(_mm256_or_si256(v, v_one))), 23), exp_bias);
+        seg = _mm256_max_epi32(seg, zero);
+        __m256i shift = _mm256_max_epi32(seg, v_one);
+
+        __m256i code = _mm256_or_si256(_mm256_slli_epi32(seg, 4), _mm256_and_si256(_mm256_srlv_epi32(v, shift), low_mask));
+        code = _mm256_xor_si256(code, mask);
+
+        code = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(code, shuf), perm);
+        _mm_storel_epi64((__m128i*)&out[i], _mm256_castsi256_si128(code));
+    }
+#endif
+    // Portable version (and clean up of the trailing samples)
+    for (; i < len; ++i) {
+        out[i] = alaw_encode(to_s16(in[i]));
+    }
+}
+
+} // namespace g711
+
+
+// IMA-ADPCM state. One per audio stream
+class AdpcmState {
+public:
+    AdpcmState(void) : predictor(0), index(0) {}
+
+    int32_t predictor;  // Predicted sample value
+    int32_t index;      // Index into the step table
+};
+
+
+namespace adpcm {
+
+static const int32_t step_table[89] = {
+        7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+       19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+       50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+      130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+      337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+      876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+     2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+     5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int32_t index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+
+// Update the state with a 4 bit code. Shared by the encoder and the decoder
+// so that they track each other exactly
+static inline void update(AdpcmState &state, int32_t code) {
+    int32_t step   = step_table[state.index];
+    int32_t vpdiff = step >> 3;
+
+    if (code & 4) vpdiff += step;
+    if (code & 2) vpdiff += step >> 1;
+    if (code & 1) vpdiff += step >> 2;
+
+    if (code & 8) state.predictor -= vpdiff;
+    else          state.predictor += vpdiff;
+
+    if (state.predictor > 32767)       state.predictor = 32767;
+    else if (state.predictor < -32768) state.predictor = -32768;
+
+    state.index += index_table[code];
+    if (state.index < 0)       state.index = 0;
+    else if (state.index > 88) state.index = 88;
+}
+
+
+// Encode one 16 bit sample into a 4 bit code
+static inline uint8_t encode(AdpcmState &state, int32_t pcm) {
+    int32_t step = step_table[state.index];
+    int32_t diff = pcm - state.predictor;
+    int32_t code = 0;
+
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+
+    if (diff >= step) { code |= 4; diff -= step; }
+    step >>= 1;
+    if (diff >= step) { code |= 2; diff -= step; }
+    step >>= 1;
+    if (diff >= step) { code |= 1; }
+
+    update(state, code);
+
+    return (uint8_t)code;
+}
+
+} // namespace adpcm
+
+
+// Audio frame encoder. One instance per audio stream (i.e. per channel). A
+// frame is encoded once with encode() and the result, available through
+// data() and size(), can then be sent as is to any number of receivers.
+//
+// Frame layouts:
+//     S16   - len * 2 bytes of signed 16 bit little endian samples
+//     ULAW  - len bytes of G.711 μ-law
+//     ALAW  - len bytes of G.711 A-law
+//     ADPCM - 4 bytes header (predictor as 16 bit little endian, step
+//             index and a flags byte) followed by (len + 1) / 2 bytes of 4
+//             bit codes, first sample in the low nibble. The header holds
+//             the state at the start of the frame so every frame can be
+//             decoded on its own. Bit 0 of the flags is set when len is odd,
+//             in which case the high nibble of the last byte is unused.
+class AudioEncoder {
+public:
+    AudioEncoder(Codec codec = Codec::S16, unsigned frame_len = 512) :
+      codec_(codec), frame_len_(frame_len), buf_(frameSize(codec, frame_len)), size_(0) {}
+
+    Codec codec(void) const { return codec_; }
+
+    // Encode len samples (at most the frame length given in the constructor)
+    // and return the size of the encoded frame in bytes
+    unsigned encode(const float *in, unsigned len) {
+        if (len > frame_len_) len = frame_len_;
+
+        uint8_t *out = buf_.data();
+
+        switch (codec_) {
+            case Codec::S16:
+                for (unsigned i = 0; i < len; ++i) {
+                    int32_t s = g711::to_s16(in[i]);
+                    out[i*2]   = (uint8_t)(s & 0xff);
+                    out[i*2+1] = (uint8_t)((s >> 8) & 0xff);
+                }
+                size_ = len * 2;
+                break;
+
+            case Codec::ULAW:
+                g711::ulaw_encode(in, len, out);
+                size_ = len;
+                break;
+
+            case Codec::ALAW:
+                g711::alaw_encode(in, len, out);
+                size_ = len;
+                break;
+
+            case Codec::ADPCM:
+                // ADPCM is sequential by nature since every sample depends on
+                // the state left by the previous one. It is only a handful of
+                // integer operations per sample so we do not bother with SIMD.
+                out[0] = (uint8_t)(adpcm_.predictor & 0xff);
+                out[1] = (uint8_t)((adpcm_.predictor >> 8) & 0xff);
+                out[2] = (uint8_t)adpcm_.index;
+                out[3] = (uint8_t)(len & 1);
+                out += 4;
+                for (unsigned i = 0; i < len; i += 2) {
+                    uint8_t lo = adpcm::encode(adpcm_, g711::to_s16(in[i]));
+                    uint8_t hi = (i + 1 < len) ? adpcm::encode(adpcm_, g711::to_s16(in[i+1])) : 0;
+                    *(out++) = (uint8_t)(lo | (hi << 4));
+                }
+                size_ = 4 + (len + 1) / 2;
+                break;
+
+            default:
+                size_ = 0;
+                break;
+        }
+
+        return size_;
+    }
+
+    // Last encoded frame
+    const uint8_t *data(void) const { return buf_.data(); }
+    unsigned size(void) const { return size_; }
+
+    // Size in bytes of an encoded frame with frame_len samples
+    static unsigned frameSize(Codec codec, unsigned frame_len) {
+        switch (codec) {
+            case Codec::S16:   return frame_len * 2;
+            case Codec::ULAW:  return frame_len;
+            case Codec::ALAW:  return frame_len;
+            case Codec::ADPCM: return 4 + (frame_len + 1) / 2;
+            default:           return 0;
+        }
+    }
+
+private:
+    Codec                codec_;      // Codec used
+    unsigned             frame_len_;  // Max number of samples in a frame
+    std::vector<uint8_t> buf_;        // Encoded frame
+    unsigned             size_;       // Size of the last encoded frame
+    AdpcmState           adpcm_;      // ADPCM state carried between frames
+};
+
+
+// Audio frame decoder. The counterpart of AudioEncoder. Mostly useful for
+// receivers written in C++ and for verifying the encoder.
+class AudioDecoder {
+public:
+    AudioDecoder(Codec codec = Codec::S16) : codec_(codec) {}
+
+    // Decode one encoded frame of size bytes into float samples. Returns the
+    // number of samples written to out
+    unsigned decode(const uint8_t *in, unsigned size, float *out) {
+        unsigned len = 0;
+
+        switch (codec_) {
+            case Codec::S16:
+                for (unsigned i = 0; i + 1 < size; i += 2) {
+                    int16_t s = (int16_t)(in[i] | (in[i+1] << 8));
+                    out[len++] = (float)s / 32767.0f;
+                }
+                break;
+
+            case Codec::ULAW:
+                for (unsigned i = 0; i < size; ++i) {
+                    out[len++] = (float)g711::ulaw_table[in[i]] / 32767.0f;
+                }
+                break;
+
+            case Codec::ALAW:
+                for (unsigned i = 0; i < size; ++i) {
+                    out[len++] = (float)g711::alaw_table[in[i]] / 32767.0f;
+                }
+                break;
+
+            case Codec::ADPCM:
+                if (size < 4) break;
+                state_.predictor = (int16_t)(in[0] | (in[1] << 8));
+                state_.index = in[2] > 88 ? 88 : in[2];
+                for (unsigned i = 4; i < size; ++i) {
+                    adpcm::update(state_, in[i] & 0x0f);
+                    out[len++] = (float)state_.predictor / 32767.0f;
+
+                    // Odd number of samples. The last high nibble is padding
+                    if (i + 1 == size && (in[3] & 1)) break;
+
+                    adpcm::update(state_, in[i] >> 4);
+                    out[len++] = (float)state_.predictor / 32767.0f;
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        return len;
+    }
+
+private:
+    Codec      codec_;   // Codec used
+    AdpcmState state_;   // ADPCM state
+};
+
+#endif // CODEC_HPP
@@ -48,7 +48,7 @@ template<typename T, typename M>
 class CRB {
 public:
     CRB(size_t chunk_size, size_t num_chunks) : chunks_(num_chunks+1),
-    write_ptr_(0), read_ptr_(0), end_ptr_(num_chunks), streaming_(false), capacity_(num_chunks+1),
+    write_ptr_(0), read_ptr_(0), end_ptr_(num_chunks), streaming_(false), capacity_(num_chunks+1), chunk_size_(chunk_size),
     acquired_write_len_(0), acquired_read_len_(0) {
         for (auto &c : chunks_) {
             c.buf_ = std::make_unique<T[]>(chunk_size + ALING_LEN * 2);
@@ -61,6 +61,9 @@ public:
     CRB(const CRB&) = delete;
     CRB& operator=(const CRB&) = delete;
 
+    // Bytes of memory used by the chunks, including the sentinel
+    size_t memoryUsage(void) const { return capacity_ * (sizeof(Chunk) + (chunk_size_ + ALING_LEN * 2) * sizeof(T)); }
+
     void setStreaming(bool streaming) { streaming_ = streaming; }
     bool isStreaming(void) { return streaming_; }
 
@@ -202,6 +205,7 @@ private:
 
     // Variables used only by the writing thread
     const size_t capacity_;            // Capacity. Const and can not be changed. +1 from requested to accommodate for sentinel
+    const size_t chunk_size_;          // Elements in a chunk, not counting the alignment margins
     size_t       acquired_write_ptr_;  // Acquired write pointer
     size_t       acquired_write_len_;  // Acquired write len
     size_t       acquired_end_ptr_;    // Acquired end pointer
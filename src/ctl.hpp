@@ -0,0 +1,177 @@
+//
+// Line based control server on a Unix domain socket
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef CTL_HPP
+#define CTL_HPP
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+
+#include "evl.hpp"
+
+// Control server. Clients connect to the Unix domain socket and send
+// commands as text lines. Every line is handed to the handler and the string
+// returned by the handler is sent back as the reply. Works fine with tools
+// like socat or nc:
+//
+//     $ socat - UNIX-CONNECT:/tmp/sdrx.sock
+//
+// The socket and the clients are served by an event loop and the handler is
+// called in the context of the thread running the loop. start() and stop()
+// must be called from the same thread, or while the loop is not running.
+class CtlServer {
+public:
+    using Handler = std::function<std::string(const std::string&)>;
+
+    CtlServer(EventLoop &loop, const std::string &path, Handler handler) :
+      loop_(loop), path_(path), handler_(handler), listen_fd_(-1) {}
+    ~CtlServer(void) { stop(); }
+
+    CtlServer(const CtlServer&) = delete;
+    CtlServer& operator=(const CtlServer&) = delete;
+
+    // Create the socket and add it to the event loop. An old socket file at
+    // the same path is removed. Returns false if the socket could not be
+    // created
+    bool start(void) {
+        struct sockaddr_un addr;
+
+        if (listen_fd_ >= 0) return true;
+        if (path_.empty() || path_.length() >= sizeof(addr.sun_path)) return false;
+
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) return false;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path_.c_str(), sizeof(addr.sun_path) - 1);
+
+        unlink(path_.c_str());
+        if (bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd_, 4) < 0 ||
+            !loop_.addFd(listen_fd_, EPOLLIN, [this](uint32_t) { accept_(); })) {
+            close(listen_fd_);
+            listen_fd_ = -1;
+            unlink(path_.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    // Disconnect all clients and remove the socket
+    void stop(void) {
+        if (listen_fd_ < 0) return;
+
+        for (auto &client : clients_) {
+            loop_.removeFd(client.fd);
+            close(client.fd);
+        }
+        clients_.clear();
+
+        loop_.removeFd(listen_fd_);
+        close(listen_fd_);
+        listen_fd_ = -1;
+        unlink(path_.c_str());
+    }
+
+private:
+    static const unsigned MAX_CLIENTS  = 8;
+    static const unsigned MAX_LINE_LEN = 1024;
+
+    struct Client {
+        int         fd;
+        std::string buf;   // Received data not yet terminated by a newline
+    };
+
+    EventLoop          &loop_;
+    std::string         path_;
+    Handler             handler_;
+    int                 listen_fd_;
+    std::vector<Client> clients_;
+
+    void send_(int fd, const std::string &reply) {
+        size_t pos = 0;
+        while (pos < reply.length()) {
+            // MSG_NOSIGNAL since a client that has gone away must not
+            // trigger SIGPIPE
+            ssize_t ret = send(fd, reply.data() + pos, reply.length() - pos, MSG_NOSIGNAL);
+            if (ret <= 0) break;
+            pos += ret;
+        }
+    }
+
+    // Returns false if the client has disconnected or misbehaved
+    bool read_(Client &client) {
+        char buf[512];
+
+        ssize_t ret = recv(client.fd, buf, sizeof(buf), 0);
+        if (ret <= 0) return false;
+
+        client.buf.append(buf, ret);
+
+        size_t nl_pos;
+        while ((nl_pos = client.buf.find('\n')) != std::string::npos) {
+            std::string line = client.buf.substr(0, nl_pos);
+            client.buf.erase(0, nl_pos + 1);
+
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+
+            std::string reply = handler_(line);
+            if (reply.empty() || reply.back() != '\n') reply += '\n';
+            send_(client.fd, reply);
+        }
+
+        return client.buf.length() <= MAX_LINE_LEN;
+    }
+
+    void accept_(void) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        if (clients_.size() >= MAX_CLIENTS || !loop_.addFd(fd, EPOLLIN, [this, fd](uint32_t) { serve_(fd); })) {
+            send_(fd, "ERROR: Too many clients\n");
+            close(fd);
+            return;
+        }
+
+        clients_.push_back({ fd, std::string() });
+    }
+
+    void serve_(int fd) {
+        auto iter = std::find_if(clients_.begin(), clients_.end(), [fd](const Client &client) { return client.fd == fd; });
+        if (iter == clients_.end()) return;
+
+        if (!read_(*iter)) {
+            loop_.removeFd(fd);
+            close(fd);
+            clients_.erase(iter);
+        }
+    }
+};
+
+#endif // CTL_HPP
@@ -0,0 +1,62 @@
+//
+// AM and FM demodulator
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef DEMOD_HPP
+#define DEMOD_HPP
+
+#include <cmath>
+
+#include "iqsample.hpp"
+
+enum class Modulation { UNSPECIFIED, AM, FM };
+
+class Demod {
+public:
+    Demod(Modulation mod = Modulation::UNSPECIFIED) : mod_(mod), prev_sample(0, 0) {}
+    ~Demod(void) {}
+
+    float demod(iqsample_t sample) {
+        if (mod_ == Modulation::AM) {
+            return std::abs(sample);
+        } else if (mod_ == Modulation::FM) {
+            float audio_sample;
+
+            // Normalize amplitude
+            sample = sample / std::abs(sample);
+
+            float i = sample.real();
+            float q = sample.imag();
+
+            audio_sample = std::atan2(q * prev_sample.real() - i * prev_sample.imag(), i * prev_sample.real() + q * prev_sample.imag());
+
+            prev_sample = sample;
+
+            return audio_sample;
+        } else {
+            return 0.0f;
+        }
+    }
+
+private:
+    Modulation mod_;
+    iqsample_t prev_sample;
+};
+
+#endif // DEMOD_HPP
@@ -0,0 +1,126 @@
+//
+// Wideband energy detector
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef DET_HPP
+#define DET_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include <fftw3.h>
+
+#include <iqsample.hpp>
+
+// Energy map of a wideband IQ block. A few FFTs, spread out over the block,
+// are averaged into a power spectrum. The noise floor is taken as the median
+// of all bins. The level of a narrow band signal is then read as the mean
+// power in a few bins relative to the noise floor.
+//
+// The FFT plan is created in the constructor that therefore must be called
+// from one thread at a time (FFTW plan creation is not thread safe).
+// process() and level() can be called from any thread.
+class Detector {
+public:
+    Detector(unsigned size, unsigned num_segments = 4) :
+      size_(size), num_segments_(num_segments), power_(size), sorted_(size), window_(size), floor_(0.0f) {
+        in_  = reinterpret_cast<iqsample_t*>(fftwf_malloc(sizeof(iqsample_t) * size_));
+        out_ = reinterpret_cast<iqsample_t*>(fftwf_malloc(sizeof(iqsample_t) * size_));
+        plan_ = fftwf_plan_dft_1d(size_,
+                                  reinterpret_cast<fftwf_complex*>(in_),
+                                  reinterpret_cast<fftwf_complex*>(out_),
+                                  FFTW_FORWARD, FFTW_ESTIMATE);
+
+        // Hann window
+        for (unsigned n = 0; n < size_; ++n) {
+            window_[n] = 0.5f - 0.5f * std::cos((2.0f * M_PI * n) / size_);
+        }
+    }
+    ~Detector(void) {
+        fftwf_destroy_plan(plan_);
+        fftwf_free(in_);
+        fftwf_free(out_);
+    }
+
+    Detector(const Detector&) = delete;
+    Detector& operator=(const Detector&) = delete;
+
+    // FFT size
+    unsigned size(void) const { return size_; }
+
+    // FFT bin for a frequency offset relative to the center of the block
+    int bin(double offset, double fs) const {
+        int b = (int)std::lround(offset * size_ / fs);
+        if (b < 0) b += size_;
+        return b;
+    }
+
+    // Update the energy map with a new block of IQ samples. Blocks shorter
+    // than the FFT size are ignored
+    void process(const iqsample_t *data, unsigned len) {
+        if (len < size_) return;
+
+        std::fill(power_.begin(), power_.end(), 0.0f);
+
+        unsigned step = num_segments_ > 1 ? (len - size_) / (num_segments_ - 1) : 0;
+        for (unsigned segment = 0; segment < num_segments_; ++segment) {
+            const iqsample_t *seg_ptr = data + segment * step;
+            for (unsigned n = 0; n < size_; ++n) in_[n] = seg_ptr[n] * window_[n];
+
+            fftwf_execute(plan_);
+
+            for (unsigned n = 0; n < size_; ++n) power_[n] += std::norm(out_[n]);
+        }
+
+        // The median is a robust noise floor estimate as long as less than
+        // half of the band is occupied
+        sorted_ = power_;
+        std::nth_element(sorted_.begin(), sorted_.begin() + size_/2, sorted_.end());
+        floor_ = sorted_[size_/2];
+    }
+
+    // Level in dB over the noise floor for the bins bin - half_width to
+    // bin + half_width
+    float level(int bin, int half_width) const {
+        float sum = 0.0f;
+
+        for (int b = bin - half_width; b <= bin + half_width; ++b) {
+            sum += power_[(b + size_) % size_];
+        }
+        sum /= 2 * half_width + 1;
+
+        if (floor_ <= 0.0f || sum <= 0.0f) return 0.0f;
+
+        return 10.0f * std::log10(sum / floor_);
+    }
+
+private:
+    unsigned           size_;
+    unsigned           num_segments_;
+    std::vector<float> power_;    // Power spectrum
+    std::vector<float> sorted_;   // Scratch for the median
+    std::vector<float> window_;
+    float              floor_;    // Noise floor
+    iqsample_t        *in_;
+    iqsample_t        *out_;
+    fftwf_plan         plan_;
+};
+
+#endif // DET_HPP
@@ -25,11 +25,30 @@
 #include <mutex>
 #include <condition_variable>
 #include <latch>
+#include <atomic>
 
 #include "msd.hpp"
+#include "hist.hpp"
+#include "trace.hpp"
+#include "perf.hpp"
 
 class DS {
 public:
+    // Where the cost of a job is recorded. Everything is optional. The time
+    // for the down sampling is recorded in hist and the CPU time is added to
+    // cpu_ns. With a tracer, a span is recorded for block seq and channel
+    // index ch. Hardware event counts are added to perf and the time for the
+    // down sampling to ds_ns
+    struct Instrumentation {
+        LatencyHist           *hist = nullptr;
+        std::atomic<uint64_t> *cpu_ns = nullptr;
+        Tracer                *trace = nullptr;
+        uint64_t               seq = 0;
+        int                    ch = -1;
+        PerfStage             *perf = nullptr;
+        std::atomic<uint64_t> *ds_ns = nullptr;
+    };
+
     DS(const MSD &msd) : run_(true), in_data_ptr_(nullptr), msd_(msd), thread_(&DS::worker_, this) {}
     ~DS(void) {
         std::unique_lock<std::mutex> lock(mutex_);
@@ -39,24 +58,39 @@ public:
         thread_.join();
     }
 
-    void addJob(const iqsample_t *data, unsigned data_len, iqsample_t *out, std::latch &latch) {
+    // Down sample data into out and count down latch when done. The cost of
+    // the job is recorded as given by inst
+    void addJob(const iqsample_t *data, unsigned data_len, iqsample_t *out, std::latch &latch,
+                const Instrumentation &inst) {
         std::unique_lock<std::mutex> lock(mutex_);
 
         in_data_ptr_ = data;
         in_data_len_ = data_len;
         out_ptr_ = out;
         latch_ = &latch;
+        inst_ = inst;
 
         lock.unlock();
         condition_.notify_one();
     }
 
+    // Bytes of memory used by the down sampler. See MSD::memoryUsage
+    size_t memoryUsage(void) const { return msd_.memoryUsage(); }
+
+    // Retune the down sampler. See MSD::retune. Must not be called while a
+    // job is running
+    void retune(MSD &other) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        msd_.retune(other);
+    }
+
 private:
     // Order matters. Variables used in the thread must be before thread_
     bool                    run_;
     const iqsample_t       *in_data_ptr_;
     unsigned                in_data_len_;
     iqsample_t             *out_ptr_;
+    Instrumentation         inst_;
     MSD                     msd_;
     std::mutex              mutex_;
     std::condition_variable condition_;
@@ -67,7 +101,28 @@ private:
         std::unique_lock<std::mutex> lock(mutex_);
         while (run_) {
             if (in_data_ptr_) {
+                const Instrumentation &inst = inst_;
+                uint64_t start = inst.hist || inst.trace || inst.ds_ns ? LatencyHist::now() : 0;
+                uint64_t cpu_start = inst.cpu_ns ? thread_cpu_time() : 0;
+
+                PerfCounters::Counts perf_start, perf_end;
+                if (inst.perf) PerfCounters::read(perf_start);
+
                 msd_.decimate(in_data_ptr_, in_data_len_, out_ptr_);
+                if (inst.perf) {
+                    PerfCounters::read(perf_end);
+                    inst.perf->record(perf_start, perf_end, "Down sampler");
+                }
+                if (inst.hist || inst.trace || inst.ds_ns) {
+                    uint64_t end = LatencyHist::now();
+                    if (inst.hist) inst.hist->record(end - start);
+                    if (inst.ds_ns) inst.ds_ns->store(inst.ds_ns->load(std::memory_order_relaxed) + end - start, std::memory_order_relaxed);
+                    if (inst.trace) {
+                        inst.trace->threadName("Down sampler");
+                        inst.trace->span("Channelize", start, end, inst.seq, inst.ch);
+                    }
+                }
+                if (inst.cpu_ns) inst.cpu_ns->fetch_add(thread_cpu_time() - cpu_start, std::memory_order_relaxed);
                 in_data_ptr_ = nullptr;
                 latch_->count_down();
                 latch_ = nullptr;
@@ -1,5 +1,5 @@
 //
-// Test for the unified RTL and Airspy device class
+// Soak test for the unified RTL and Airspy device class
 //
 // @author Johan Hedin
 // @date   2021
@@ -21,56 +21,217 @@
 // Standard C includes
 #include <signal.h>
 #include <string.h>
+#include <stdio.h>
 
 // Standard C++ includes
 #include <thread>
 #include <chrono>
 #include <iostream>
+#include <sstream>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <algorithm>
 
 // Libraries we use
 #include <popt.h>
 
 // Local includes
 #include "r820_dev.hpp"
+#include "hist.hpp"
+#include "evl.hpp"
+
+#define DEFAULT_INTERVAL 10    // Seconds between reports
+
+
+// Statistics for one device under test. The counters are updated in the
+// context of the device thread and read by the main thread for the reports
+struct Soak {
+    std::string           serial;
+    R820Dev::Type         type = R820Dev::Type::UNKNOWN;
+    SampleRate            fs = SampleRate::UNSPECIFIED;
+    uint32_t              rate = 0;             // Sample rate in Hz
+    R820Dev              *device = nullptr;
+
+    LatencyHist           jitter;               // Deviation of the time between callbacks from the block duration
+    LatencyHist           second;               // Time to receive one second worth of samples (throughput)
+    std::atomic<uint64_t> callbacks = 0;
+    std::atomic<uint64_t> samples = 0;          // Samples received, first block after each start excluded
+    std::atomic<uint64_t> stream_ns = 0;        // Time in which the samples were received
+    std::atomic<uint64_t> longest_ns = 0;       // Longest time between callbacks
+    std::atomic<uint64_t> gaps = 0;             // Callbacks later than 1.5 times the block duration
+    std::atomic<uint64_t> dropped = 0;          // Samples dropped as reported by the device
+    std::atomic<uint64_t> restarts = 0;         // Times the device stopped streaming during the test
+    std::atomic<uint64_t> cpu_ns = 0;           // CPU time used by the thread calling us
+
+    // Only used in the device thread
+    uint64_t              last_ts = 0;          // Time of the last callback. 0 if not streaming
+    uint64_t              second_ts = 0;
+    uint64_t              second_samples = 0;
+    std::thread::id       cpu_thread;
+    uint64_t              cpu_last = 0;
+};
+
+
+// Values at the last report, used for the rate and CPU load since then
+struct Snapshot {
+    uint64_t ts = 0;
+    uint64_t samples = 0;
+    uint64_t stream_ns = 0;
+    uint64_t cpu_ns = 0;
+};
+
+
+static std::atomic<bool> run = true;
+
+
+static void on_data(const iqsample_t *, unsigned data_len, void *user_data, const R820Dev::BlockInfo& block_info) {
+    Soak     &soak = *static_cast<Soak*>(user_data);
+    uint64_t  now = LatencyHist::now();
+
+    // CPU time is counted per thread. Some devices run the callbacks in a
+    // new thread after a restart
+    uint64_t cpu = thread_cpu_time();
+    if (std::this_thread::get_id() != soak.cpu_thread) {
+        soak.cpu_thread = std::this_thread::get_id();
+        soak.cpu_last = 0;
+    }
+    soak.cpu_ns.fetch_add(cpu - soak.cpu_last, std::memory_order_relaxed);
+    soak.cpu_last = cpu;
 
-static std::string serial;
-static bool        run = true;
-static unsigned    callback_counter = 0;
-static unsigned    sample_counter = 0;
-std::chrono::time_point<std::chrono::system_clock> ts1;
-std::chrono::time_point<std::chrono::system_clock> ts2;
-
+    soak.dropped.store(block_info.dropped, std::memory_order_relaxed);
 
-static void signal_handler(int signo) {
-    std::cout << "Signal '" << strsignal(signo) << "' received. Stopping...\n";
-    run = false;
-}
+    if (block_info.stream_state == R820Dev::StreamState::IDLE) {
+        if (run) {
+            std::cerr << "Info: Device " << soak.serial << " stopped streaming.\n";
+            soak.restarts.fetch_add(1, std::memory_order_relaxed);
+        }
+        soak.last_ts = 0;
+        return;
+    }
 
+    soak.callbacks.fetch_add(1, std::memory_order_relaxed);
 
-static void on_data(const iqsample_t *, unsigned data_len, void*, const R820Dev::BlockInfo& block_info) {
-    if (block_info.stream_state == R820Dev::StreamState::IDLE) {
-        std::cerr << "Info: Device stopped streaming.\n";
+    // The first block after a start has no interval to measure
+    if (soak.last_ts == 0) {
+        soak.last_ts = now;
+        soak.second_ts = now;
+        soak.second_samples = 0;
         return;
     }
 
-    if (callback_counter == 0) {
-        ts1 = std::chrono::system_clock::now();
-    } else {
-        sample_counter += data_len;
+    uint64_t interval = now - soak.last_ts;
+    soak.last_ts = now;
+
+    soak.samples.fetch_add(data_len, std::memory_order_relaxed);
+    soak.stream_ns.fetch_add(interval, std::memory_order_relaxed);
+    if (interval > soak.longest_ns.load(std::memory_order_relaxed)) {
+        soak.longest_ns.store(interval, std::memory_order_relaxed);
+    }
+
+    // The samples in a block cover a known time. Jitter is how much the time
+    // since the last block differs from that. If it is much longer, the
+    // device or the host stalled
+    uint64_t block_ns = (uint64_t)data_len * 1000000000u / soak.rate;
+    soak.jitter.record(interval > block_ns ? interval - block_ns : block_ns - interval);
+    if (interval > block_ns + block_ns / 2) soak.gaps.fetch_add(1, std::memory_order_relaxed);
+
+    // Time it took to receive one second worth of samples, scaled to exactly
+    // one second since the blocks do not add up to it
+    soak.second_samples += data_len;
+    if (soak.second_samples >= soak.rate) {
+        soak.second.record((now - soak.second_ts) * soak.rate / soak.second_samples);
+        soak.second_ts = now;
+        soak.second_samples = 0;
     }
+}
+
+
+static std::string elapsed_to_str(uint64_t ns) {
+    char     str[32];
+    uint64_t sec = ns / 1000000000u;
+
+    snprintf(str, sizeof(str), "%u:%02u:%02u", (unsigned)(sec / 3600), (unsigned)(sec / 60 % 60), (unsigned)(sec % 60));
+
+    return str;
+}
+
+
+// Percentiles of a histogram in ms
+static std::string percentiles_to_str(const LatencyHist &hist) {
+    char str[128];
+
+    if (hist.count() == 0) return "-";
+
+    snprintf(str, sizeof(str), "p50 %.2f, p90 %.2f, p99 %.2f, p99.9 %.2f, max %.2f",
+             hist.percentile(50) / 1e6, hist.percentile(90) / 1e6, hist.percentile(99) / 1e6,
+             hist.percentile(99.9) / 1e6, hist.max() / 1e6);
+
+    return str;
+}
+
+
+// Rate in MS/s and the deviation from the nominal rate in ppm
+static std::string rate_to_str(uint64_t samples, uint64_t ns, uint32_t nominal) {
+    char str[64];
+
+    if (ns == 0) return "-";
+
+    double rate = samples * 1e9 / ns;
+    snprintf(str, sizeof(str), "%.6fMS/s (%+.1fppm)", rate / 1e6, (rate - nominal) / nominal * 1e6);
+
+    return str;
+}
+
 
-    if (++callback_counter == 30) {
-        ts2 = std::chrono::system_clock::now();
+// One line per device with the state since the last report
+static void print_report(std::vector<std::unique_ptr<Soak>> &soaks, std::vector<Snapshot> &last, uint64_t start_ts) {
+    uint64_t now = LatencyHist::now();
 
-        unsigned elaped_time_us = std::chrono::duration_cast<std::chrono::microseconds>(ts2 - ts1).count();
-        double samples_per_second = (double)sample_counter / (double)elaped_time_us;
-        double callbacks_per_second = ((double)(callback_counter-1) / (double)elaped_time_us)*1000000;
+    for (unsigned i = 0; i < soaks.size(); ++i) {
+        Soak     &soak = *soaks[i];
+        Snapshot  snap;
 
-        std::cout << "on_data: device = " << serial << ", data_len = " <<  data_len <<
-                    ", rate = " << samples_per_second << " MS/s / " << callbacks_per_second << " callbacks/s" << std::endl;
-        callback_counter = 0;
-        sample_counter = 0;
+        snap.ts        = now;
+        snap.samples   = soak.samples.load(std::memory_order_relaxed);
+        snap.stream_ns = soak.stream_ns.load(std::memory_order_relaxed);
+        snap.cpu_ns    = soak.cpu_ns.load(std::memory_order_relaxed);
+
+        double cpu_load = 100.0 * (snap.cpu_ns - last[i].cpu_ns) / (snap.ts - last[i].ts);
+
+        fprintf(stdout, "[%s] %s: %s, jitter p99 %.2fms, longest interval %.2fms, gaps %lu, dropped %lu, restarts %lu, cpu %.1f%%\n",
+                elapsed_to_str(now - start_ts).c_str(), soak.serial.c_str(),
+                rate_to_str(snap.samples - last[i].samples, snap.stream_ns - last[i].stream_ns, soak.rate).c_str(),
+                soak.jitter.percentile(99) / 1e6, soak.longest_ns.load(std::memory_order_relaxed) / 1e6,
+                (unsigned long)soak.gaps.load(std::memory_order_relaxed),
+                (unsigned long)soak.dropped.load(std::memory_order_relaxed),
+                (unsigned long)soak.restarts.load(std::memory_order_relaxed), cpu_load);
+
+        last[i] = snap;
+    }
+    fflush(stdout);
+}
+
+
+// Summary for the whole test
+static void print_summary(std::vector<std::unique_ptr<Soak>> &soaks, uint64_t elapsed) {
+    for (auto &soak_ptr : soaks) {
+        Soak &soak = *soak_ptr;
+
+        fprintf(stdout, "\nDevice %s (%s @ %sMS/s), tested for %s\n", soak.serial.c_str(),
+                R820Dev::typeToStr(soak.type).c_str(), sample_rate_to_str(soak.fs), elapsed_to_str(elapsed).c_str());
+        fprintf(stdout, "    Callbacks:             %lu\n", (unsigned long)soak.callbacks.load(std::memory_order_relaxed));
+        fprintf(stdout, "    Average rate:          %s\n",
+                rate_to_str(soak.samples.load(std::memory_order_relaxed), soak.stream_ns.load(std::memory_order_relaxed), soak.rate).c_str());
+        fprintf(stdout, "    Callback jitter:       %s ms\n", percentiles_to_str(soak.jitter).c_str());
+        fprintf(stdout, "    Time per 1s samples:   %s ms\n", percentiles_to_str(soak.second).c_str());
+        fprintf(stdout, "    Longest interval:      %.2f ms\n", soak.longest_ns.load(std::memory_order_relaxed) / 1e6);
+        fprintf(stdout, "    Gaps:                  %lu\n", (unsigned long)soak.gaps.load(std::memory_order_relaxed));
+        fprintf(stdout, "    Dropped samples:       %lu\n", (unsigned long)soak.dropped.load(std::memory_order_relaxed));
+        fprintf(stdout, "    Restarts:              %lu\n", (unsigned long)soak.restarts.load(std::memory_order_relaxed));
+        fprintf(stdout, "    Callback thread CPU:   %.1f%%\n", 100.0 * soak.cpu_ns.load(std::memory_order_relaxed) / elapsed);
     }
+    fflush(stdout);
 }
 
 
@@ -79,23 +240,28 @@ int main(int argc, char **argv) {
     int               print_help = 0;
     int               list_devices = 0;
     int               run_test = 0;
+    int               duration = 0;
+    int               interval = DEFAULT_INTERVAL;
     char             *tmp_serial = nullptr;
     char             *tmp_rate = nullptr;
     SampleRate        fs = SampleRate::UNSPECIFIED;
     poptContext       popt_ctx;
+    std::vector<std::string> serials;
 
     // Fill in the options config
     struct poptOption options_table[] = {
         { "list",      'l', POPT_ARG_NONE,   &list_devices, 0, "list available devices", nullptr },
         { "rate",      'r', POPT_ARG_STRING, &tmp_rate,     0, "use this sample rate", "SAMPLE_RATE" },
-        { "test",      't', POPT_ARG_STRING, &tmp_serial,   0, "run test with given device", "SERIAL" },
+        { "test",      't', POPT_ARG_STRING, &tmp_serial,   0, "run test with given devices, separated by comma, at the same time", "SERIAL[,SERIAL...]" },
+        { "duration",  'd', POPT_ARG_INT,    &duration,     0, "stop the test after this many seconds. Runs until Ctrl-C if not set", "SEC" },
+        { "interval",  'i', POPT_ARG_INT,    &interval,     0, "seconds between reports. Defaults to 10 if not set", "SEC" },
         { "help",      'h', POPT_ARG_NONE,   &print_help,   0, "show full help and quit", nullptr },
         POPT_TABLEEND
     };
 
     // Create popt instance
     popt_ctx = poptGetContext(nullptr, argc, (const char**)argv, options_table, POPT_CONTEXT_POSIXMEHARDER);
-    poptSetOtherOptionHelp(popt_ctx, "[-h, --help] [-l, --list] [-r, --rate SAMPLE_RATE] [-t, --test SERIAL]");
+    poptSetOtherOptionHelp(popt_ctx, "[-h, --help] [-l, --list] [-r, --rate SAMPLE_RATE] [-t, --test SERIAL[,SERIAL...]] [-d, --duration SEC] [-i, --interval SEC]");
 
     while ((ret = poptGetNextOpt(popt_ctx)) > 0);
     if (ret < -1) {
@@ -124,7 +290,26 @@ int main(int argc, char **argv) {
             // Ignore given options and just print the extended help
             poptPrintHelp(popt_ctx, stderr, 0);
             std::cerr << R"(
-Write some more here...)"
+dts runs one or more devices at the same time and measures how well the host
+keeps up with them. Every interval a line per device is printed with the
+measured sample rate, the callback jitter, gaps, dropped samples, restarts
+and the CPU load of the thread that runs the callbacks. When the test stops,
+histograms of the callback jitter and of the time to receive one second of
+samples are printed per device.
+
+Jitter is how much the time between two callbacks differs from the 32ms
+that the samples in a block cover. A gap is a callback that arrives more than
+1.5 blocks after the previous one.
+Dropped samples are only reported by Airspy devices.
+
+Devices that are not present can be simulated. Use the serial sim for a
+synthetic signal or sim:FILE to play a raw 8 bit IQ file, as written by
+rtl_sdr, in real time. A simulated device skips blocks and counts them as
+dropped if the host is more than a block late.
+
+Example, a one hour soak of two dongles:
+
+    $ dts --test 00000001,00000002 --rate 2.4 --duration 3600)"
             << std::endl;
             ret = -1;
         } else {
@@ -135,9 +320,27 @@ Write some more here...)"
             }
 
             if (tmp_serial) {
-                run_test = 1;
-                serial = tmp_serial;
+                std::stringstream ss(tmp_serial);
+                std::string       serial;
+
+                while (std::getline(ss, serial, ',')) {
+                    if (serial.empty()) continue;
+                    if (std::find(serials.begin(), serials.end(), serial) != serials.end()) {
+                        std::cerr << "Error: Device " << serial << " given more than once.\n";
+                        ret = -1;
+                    }
+                    serials.push_back(serial);
+                }
                 free(tmp_serial);
+                run_test = !serials.empty();
+            }
+
+            if (duration < 0) {
+                std::cerr << "Error: Invalid duration given.\n";
+                ret = -1;
+            } else if (interval < 1 || interval > 3600) {
+                std::cerr << "Error: Invalid interval given.\n";
+                ret = -1;
             }
 
             if (!list_devices && !run_test) {
@@ -147,6 +350,7 @@ Write some more here...)"
     }
 
     poptFreeContext(popt_ctx);
+    if (ret < 0) return 1;
 
     // List devices and then exit
     if (list_devices) {
@@ -193,79 +397,126 @@ Write some more here...)"
     }
 
     if (run_test) {
-        // Install handler for Crtl-C
-        struct sigaction sigact;
-        sigact.sa_handler = signal_handler;
-        sigemptyset(&sigact.sa_mask);
-        sigact.sa_flags = 0;
-        sigaction(SIGINT, &sigact, NULL);
-        sigaction(SIGTERM, &sigact, NULL);
-        sigaction(SIGQUIT, &sigact, NULL);
-        sigaction(SIGPIPE, &sigact, NULL);
-
-        R820Dev::Type type = R820Dev::getType(serial);
-        if (type == R820Dev::Type::UNKNOWN) {
-            std::cerr << "Error: Device " << serial << " is not present.\n";
-            return 1;
+        std::vector<std::unique_ptr<Soak>> soaks;
+        std::vector<Snapshot>              last;
+        uint64_t                           start_ts = 0;
+        uint64_t                           end_ts = 0;
+        EventLoop                          loop;
+
+        // Stop on Crtl-C. The signals are blocked here, before any device
+        // thread is started, and handled by the event loop below
+        for (int signo : { SIGINT, SIGTERM, SIGQUIT, SIGPIPE }) {
+            loop.addSignal(signo, [&loop](int signo) {
+                std::cout << "Signal '" << strsignal(signo) << "' received. Stopping...\n";
+                run = false;
+                loop.stop();
+            });
         }
 
-        // Default to sane sample rate if not specified
-        if (fs == SampleRate::UNSPECIFIED) {
-            switch (type) {
-                case R820Dev::Type::RTL:
-                    fs = SampleRate::FS01440;
-                    break;
-                case R820Dev::Type::AIRSPY:
-                    fs = SampleRate::FS06000;
-                    break;
-                default:
-                    fs = SampleRate::UNSPECIFIED;
-                    break;
+        for (auto &serial : serials) {
+            auto soak = std::make_unique<Soak>();
+
+            soak->serial = serial;
+            soak->type = R820Dev::getType(serial);
+            if (soak->type == R820Dev::Type::UNKNOWN) {
+                std::cerr << "Error: Device " << serial << " is not present.\n";
+                ret = 1;
+                goto quit;
             }
-        }
 
-        R820Dev *device = R820Dev::create(type, serial, fs);
-        if (device == nullptr) {
-            std::cerr << "Error: Unable to create instance for device " << serial << ".\n";
-            return 1;
+            // Default to sane sample rate if not specified
+            soak->fs = fs;
+            if (soak->fs == SampleRate::UNSPECIFIED) {
+                switch (soak->type) {
+                    case R820Dev::Type::RTL:
+                        soak->fs = SampleRate::FS01440;
+                        break;
+                    case R820Dev::Type::AIRSPY:
+                        soak->fs = SampleRate::FS06000;
+                        break;
+                    case R820Dev::Type::SIM:
+                        soak->fs = SampleRate::FS02400;
+                        break;
+                    default:
+                        soak->fs = SampleRate::UNSPECIFIED;
+                        break;
+                }
+            }
+            soak->rate = sample_rate_to_uint(soak->fs);
+
+            soak->device = R820Dev::create(soak->type, serial, soak->fs);
+            if (soak->device == nullptr) {
+                std::cerr << "Error: Unable to create instance for device " << serial << ".\n";
+                ret = 1;
+                goto quit;
+            }
+
+            soaks.push_back(std::move(soak));
         }
 
-        std::cout << "Running test with " << R820Dev::typeToStr(type) << " device " << serial << " @ " << sample_rate_to_str(fs) << "MS/s. Press Ctrl-C to stop\n";
+        for (auto &soak : soaks) {
+            R820Dev *device = soak->device;
 
-        device->data.connect(sigc::ptr_fun(on_data));
+            std::cout << "Running test with " << R820Dev::typeToStr(soak->type) << " device " << soak->serial << " @ " << sample_rate_to_str(soak->fs) << "MS/s\n";
 
-        ret = device->setGain();
-        if (ret < 0) {
-            std::cerr << "Error: Unable to set gain, ret = " << ret << " (" << R820Dev::retToStr(ret) << ")\n";
-            goto quit;
-        }
+            device->data.connect(sigc::ptr_fun(on_data));
+            device->setUserData(soak.get());
 
-        ret = device->setFq();
-        if (ret < 0) {
-            std::cerr << "Error: Unable to set frequency, ret = " << ret << " (" << R820Dev::retToStr(ret) << ")\n";
-            goto quit;
-        }
+            ret = device->setGain();
+            if (ret < 0) {
+                std::cerr << "Error: Unable to set gain, ret = " << ret << " (" << R820Dev::retToStr(ret) << ")\n";
+                goto quit;
+            }
+
+            ret = device->setFq();
+            if (ret < 0) {
+                std::cerr << "Error: Unable to set frequency, ret = " << ret << " (" << R820Dev::retToStr(ret) << ")\n";
+                goto quit;
+            }
 
-        ret = device->start();
-        if (ret < 0) {
-            std::cerr << "Error: Unable to start device, ret = " << ret << " (" << R820Dev::retToStr(ret) << ")\n";
-            goto quit;
+            ret = device->start();
+            if (ret < 0) {
+                std::cerr << "Error: Unable to start device, ret = " << ret << " (" << R820Dev::retToStr(ret) << ")\n";
+                goto quit;
+            }
         }
 
-        // Sleep until Ctrl-C
-        while (run) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        if (duration > 0) {
+            std::cout << "Testing for " << elapsed_to_str(duration * 1000000000ull) << ". Press Ctrl-C to stop earlier\n";
+        } else {
+            std::cout << "Press Ctrl-C to stop\n";
         }
 
-        ret = device->stop();
-        if (ret < 0) {
-            std::cerr << "Error: Unable to stop device, ret = " << ret << " (" << R820Dev::retToStr(ret) << ")\n";
+        // Report until Ctrl-C or the duration has passed
+        start_ts = LatencyHist::now();
+        last.resize(soaks.size());
+        for (auto &snap : last) snap.ts = start_ts;
+
+        loop.addTimer(std::chrono::seconds(interval), true, [&](void) { print_report(soaks, last, start_ts); });
+        if (duration > 0) {
+            loop.addTimer(std::chrono::seconds(duration), false, [&loop](void) {
+                run = false;
+                loop.stop();
+            });
         }
+        loop.run();
+
+        end_ts = LatencyHist::now();
 
 quit:
-        delete device;
+        run = false;
+        for (auto &soak : soaks) {
+            int stop_ret = soak->device->stop();
+            if (stop_ret < 0 && stop_ret != R820Dev::ReturnValue::ALREADY_STOPPED) {
+                std::cerr << "Error: Unable to stop device " << soak->serial << ", ret = " << stop_ret << " (" << R820Dev::retToStr(stop_ret) << ")\n";
+            }
+        }
 
-        return 0;
+        if (end_ts) print_summary(soaks, end_ts - start_ts);
+
+        for (auto &soak : soaks) delete soak->device;
+
+        return ret == 0 ? 0 : 1;
     }
 
     return 0;
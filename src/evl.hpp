@@ -0,0 +1,275 @@
+//
+// Event loop for file descriptors, signals, timers and events from other
+// threads
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef EVL_HPP
+#define EVL_HPP
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+// Event loop built on epoll. Everything is dispatched from the thread that
+// calls run() and the loop sleeps until something happens, so an idle
+// receiver is never woken up just to check a flag. Sources are added and
+// removed from the loop thread, or before the loop is run:
+//
+//     fd       Callback when the descriptor is ready, e.g. a socket
+//     signal   Callback when a signal is received (signalfd)
+//     timer    Callback after a time, once or periodically (timerfd)
+//     event    Callback when another thread calls trigger() (eventfd)
+//
+// trigger(), post() and stop() can be called from any thread. trigger() is a
+// single write to an eventfd and can be used from the input and output
+// threads.
+class EventLoop {
+public:
+    using Callback   = std::function<void(void)>;
+    using FdCallback = std::function<void(uint32_t)>;
+
+    EventLoop(void) : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)), signal_fd_(-1), run_(false) {
+        sigemptyset(&signals_);
+        wake_fd_ = addEvent([this](void) { runPosted_(); });
+    }
+
+    ~EventLoop(void) {
+        for (auto &source : sources_) {
+            if (source.second.owned) close(source.first);
+        }
+        if (epoll_fd_ >= 0) close(epoll_fd_);
+    }
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // False if the loop could not be created
+    bool valid(void) const { return epoll_fd_ >= 0 && wake_fd_ >= 0; }
+
+    // Call cb with the epoll events (EPOLLIN, EPOLLOUT, ...) when fd is
+    // ready. The descriptor is not closed by the loop. Returns false if the
+    // descriptor can not be watched
+    bool addFd(int fd, uint32_t events, FdCallback cb) {
+        return add_(fd, events, std::move(cb), false);
+    }
+
+    // Stop watching a descriptor added with addFd()
+    void removeFd(int fd) {
+        remove_(fd);
+    }
+
+    // Block a signal in the calling thread. Threads inherit the blocked
+    // signals so signals handled by a loop must be blocked before any thread
+    // is started. A blocked signal stays pending until it is added to a loop.
+    // Returns false on error
+    static bool blockSignal(int signo) {
+        sigset_t set;
+
+        sigemptyset(&set);
+        sigaddset(&set, signo);
+
+        return pthread_sigmask(SIG_BLOCK, &set, nullptr) == 0;
+    }
+
+    // Call cb when signo is received. The signal is blocked, see
+    // blockSignal(), and is only delivered through the loop. Returns false on
+    // error
+    bool addSignal(int signo, std::function<void(int)> cb) {
+        if (!blockSignal(signo)) return false;
+        sigaddset(&signals_, signo);
+
+        signal_cbs_[signo] = std::move(cb);
+
+        if (signal_fd_ >= 0) return signalfd(signal_fd_, &signals_, 0) >= 0;
+
+        signal_fd_ = signalfd(-1, &signals_, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (signal_fd_ < 0) return false;
+
+        return add_(signal_fd_, EPOLLIN, [this](uint32_t) { readSignals_(); }, true);
+    }
+
+    // Call cb after interval and then every interval if periodic. Returns an
+    // id for removeTimer() or -1 on error
+    int addTimer(std::chrono::milliseconds interval, bool periodic, Callback cb) {
+        struct itimerspec spec = {};
+
+        int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (fd < 0) return -1;
+
+        spec.it_value.tv_sec  = interval.count() / 1000;
+        spec.it_value.tv_nsec = (interval.count() % 1000) * 1000000;
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) spec.it_value.tv_nsec = 1;
+        if (periodic) spec.it_interval = spec.it_value;
+
+        if (timerfd_settime(fd, 0, &spec, nullptr) < 0 ||
+            !add_(fd, EPOLLIN, [this, fd, periodic, cb](uint32_t) {
+                uint64_t expirations;
+                if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) return;
+                if (!periodic) remove_(fd);
+                cb();
+            }, true)) {
+            close(fd);
+            return -1;
+        }
+
+        return fd;
+    }
+
+    // Cancel a timer. Nothing happens if the timer has already fired
+    void removeTimer(int id) {
+        remove_(id);
+    }
+
+    // Call cb when trigger() is called with the returned id. Triggers that
+    // arrive before the loop gets to the event are merged into one call.
+    // Returns -1 on error
+    int addEvent(Callback cb) {
+        int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0) return -1;
+
+        if (!add_(fd, EPOLLIN, [fd, cb](uint32_t) {
+                uint64_t count;
+                if (read(fd, &count, sizeof(count)) != sizeof(count)) return;
+                cb();
+            }, true)) {
+            close(fd);
+            return -1;
+        }
+
+        return fd;
+    }
+
+    // Remove an event added with addEvent()
+    void removeEvent(int id) {
+        remove_(id);
+    }
+
+    // Trigger an event. Can be called from any thread
+    static void trigger(int id) {
+        uint64_t one = 1;
+        if (id >= 0 && write(id, &one, sizeof(one)) < 0) {
+            // The counter is full, so the event is already pending
+        }
+    }
+
+    // Run cb in the loop thread. Can be called from any thread
+    void post(Callback cb) {
+        std::unique_lock<std::mutex> lock(posted_mutex_);
+        posted_.push_back(std::move(cb));
+        lock.unlock();
+
+        trigger(wake_fd_);
+    }
+
+    // Dispatch events until stop() is called
+    void run(void) {
+        struct epoll_event events[16];
+
+        run_ = true;
+        while (run_) {
+            int num_events = epoll_wait(epoll_fd_, events, 16, -1);
+
+            for (int i = 0; i < num_events && run_; ++i) {
+                // The source may have been removed by an earlier callback
+                auto iter = sources_.find(events[i].data.fd);
+                if (iter == sources_.end()) continue;
+
+                // The callback may remove its own source
+                FdCallback cb = iter->second.cb;
+                cb(events[i].events);
+            }
+        }
+    }
+
+    // Make run() return. Can be called from any thread
+    void stop(void) {
+        run_ = false;
+        trigger(wake_fd_);
+    }
+
+private:
+    struct Source {
+        FdCallback cb;
+        bool       owned;   // Descriptor created, and closed, by the loop
+    };
+
+    int                                      epoll_fd_;
+    int                                      wake_fd_;
+    int                                      signal_fd_;
+    sigset_t                                 signals_;
+    std::atomic<bool>                        run_;
+    std::map<int, Source>                    sources_;
+    std::map<int, std::function<void(int)>>  signal_cbs_;
+    std::mutex                               posted_mutex_;
+    std::vector<Callback>                    posted_;
+
+    bool add_(int fd, uint32_t events, FdCallback cb, bool owned) {
+        struct epoll_event event = {};
+
+        event.events  = events;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) return false;
+
+        sources_[fd] = Source{ std::move(cb), owned };
+
+        return true;
+    }
+
+    void remove_(int fd) {
+        auto iter = sources_.find(fd);
+        if (iter == sources_.end()) return;
+
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        if (iter->second.owned) close(fd);
+        sources_.erase(iter);
+    }
+
+    void readSignals_(void) {
+        struct signalfd_siginfo info;
+
+        while (read(signal_fd_, &info, sizeof(info)) == sizeof(info)) {
+            auto iter = signal_cbs_.find(info.ssi_signo);
+            if (iter != signal_cbs_.end()) iter->second(info.ssi_signo);
+        }
+    }
+
+    void runPosted_(void) {
+        std::vector<Callback> posted;
+
+        std::unique_lock<std::mutex> lock(posted_mutex_);
+        posted.swap(posted_);
+        lock.unlock();
+
+        for (auto &cb : posted) cb();
+    }
+};
+
+#endif // EVL_HPP
@@ -0,0 +1,140 @@
+//
+// Lock free latency histogram
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef HIST_HPP
+#define HIST_HPP
+
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cmath>
+
+#include <time.h>
+
+// CPU time in ns consumed by the calling thread. Time spent blocked, e.g.
+// waiting for the sound card, is not counted
+static inline uint64_t thread_cpu_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+
+// Histogram of latencies in ns with logarithmic buckets, in the style of HDR
+// histograms. Values below 2^SUB_BITS ns get a bucket each. Above that, every
+// power of two range is split into 2^(SUB_BITS-1) linear sub buckets which
+// gives a relative precision of about 3%. Values above 2^MAX_BITS ns (about
+// 18 minutes) end up in the last bucket.
+//
+// One thread records and any other thread can read at the same time without
+// locks. A reader may see a recording half done, i.e. the count updated but
+// not yet the max, which does not matter for a printout.
+class LatencyHist {
+public:
+    static constexpr unsigned SUB_BITS    = 6;
+    static constexpr unsigned SUB_COUNT   = 1u << SUB_BITS;
+    static constexpr unsigned HALF_COUNT  = SUB_COUNT / 2;
+    static constexpr unsigned MAX_BITS    = 40;
+    static constexpr unsigned NUM_BUCKETS = SUB_COUNT + (MAX_BITS - SUB_BITS) * HALF_COUNT;
+
+    LatencyHist(void) {
+        for (auto &c : counts_) c.store(0, std::memory_order_relaxed);
+    }
+
+    LatencyHist(const LatencyHist&) = delete;
+    LatencyHist& operator=(const LatencyHist&) = delete;
+
+    // Monotonic timestamp in ns, not affected by NTP adjustments
+    static uint64_t now(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+    }
+
+    // Record one value. Must only be called from one thread at a time
+    void record(uint64_t ns) {
+        std::atomic<uint32_t> &bucket = counts_[index(ns)];
+
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum_.store(sum_.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        if (ns > max_.load(std::memory_order_relaxed)) max_.store(ns, std::memory_order_relaxed);
+    }
+
+    uint64_t count(void) const { return count_.load(std::memory_order_relaxed); }
+    uint64_t max(void) const { return max_.load(std::memory_order_relaxed); }
+    uint64_t sum(void) const { return sum_.load(std::memory_order_relaxed); }
+
+    // Value at percentile p (0 to 100). The upper edge of the bucket is
+    // returned so the value is never under estimated
+    uint64_t percentile(double p) const {
+        uint64_t total = 0;
+        for (auto &c : counts_) total += c.load(std::memory_order_relaxed);
+        if (total == 0) return 0;
+
+        uint64_t target = (uint64_t)std::ceil(p / 100.0 * total);
+        if (target < 1) target = 1;
+
+        uint64_t sum = 0;
+        for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+            sum += counts_[i].load(std::memory_order_relaxed);
+            if (sum >= target) return i == NUM_BUCKETS - 1 ? max() : std::min(upper(i), max());
+        }
+
+        return max();
+    }
+
+    // Number of values above ns. Exact on bucket edges only
+    uint64_t countAbove(uint64_t ns) const {
+        uint64_t sum = 0;
+        for (unsigned i = index(ns) + 1; i < NUM_BUCKETS; ++i) sum += counts_[i].load(std::memory_order_relaxed);
+
+        return sum;
+    }
+
+private:
+    std::array<std::atomic<uint32_t>, NUM_BUCKETS> counts_;
+    std::atomic<uint64_t>                          count_ = 0;
+    std::atomic<uint64_t>                          sum_ = 0;
+    std::atomic<uint64_t>                          max_ = 0;
+
+    static unsigned index(uint64_t ns) {
+        if (ns < SUB_COUNT) return ns;
+        if (ns >= (uint64_t)1 << MAX_BITS) return NUM_BUCKETS - 1;
+
+        unsigned shift = (63 - __builtin_clzll(ns)) - SUB_BITS + 1; // >= 1
+        unsigned sub   = ns >> shift;                               // HALF_COUNT to SUB_COUNT - 1
+
+        return SUB_COUNT + (shift - 1) * HALF_COUNT + (sub - HALF_COUNT);
+    }
+
+    // Largest value in a bucket
+    static uint64_t upper(unsigned i) {
+        if (i < SUB_COUNT) return i;
+
+        unsigned shift = (i - SUB_COUNT) / HALF_COUNT + 1;
+        uint64_t sub   = (i - SUB_COUNT) % HALF_COUNT + HALF_COUNT;
+
+        return ((sub + 1) << shift) - 1;
+    }
+};
+
+#endif // HIST_HPP
@@ -0,0 +1,352 @@
+//
+// Console output from real-time threads
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef LOG_HPP
+#define LOG_HPP
+
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "rb.hpp"
+
+// Console output for threads that must never wait on the console. Every
+// thread that logs gets a queue of its own, a lock-free ring buffer, and the
+// lines are written to stdout or stderr by a low priority thread. Writing a
+// line is formatting into the queue and a write to an eventfd, so a slow
+// terminal or SSH session only makes the queue fill up. Lines that do not fit
+// are dropped and counted.
+//
+// Lines given a limit are rate limited. The first line is printed right away
+// and further lines with the same limit are only counted until a second has
+// passed. The count is then printed together with the text of the first
+// line:
+//
+//     Warning: Ring buffer full. Skipping 32ms block of samples. [x37 in last 1 s]
+class Log {
+public:
+    static constexpr size_t   QUEUE_SIZE    = 64 * 1024;   // Bytes in each queue
+    static constexpr size_t   MAX_LINE_SIZE = 8 * 1024;    // Longest line. Longer lines are cut
+    static constexpr unsigned LIMIT_MS      = 1000;        // Time for counting lines with the same limit
+    static constexpr int      NICE          = 10;          // Nice value of the output thread
+
+    enum class Stream { OUT, ERR };
+
+    // Rate limit for one kind of line. Typically a static next to the line
+    class Limit {
+    public:
+        constexpr Limit(void) : count_(0) {}
+
+        Limit(const Limit&) = delete;
+        Limit& operator=(const Limit&) = delete;
+
+    private:
+        friend class Log;
+
+        // Lines since the last printed one, including that one. Zero when
+        // the next line is to be printed
+        std::atomic<unsigned> count_;
+    };
+
+    // Lines from one thread. Only that thread may write to the queue
+    class Queue {
+    public:
+        Queue(Log &log, size_t size) : log_(log), rb_(size), line_(nullptr), len_(0), dropped_(0) {}
+
+        Queue(const Queue&) = delete;
+        Queue& operator=(const Queue&) = delete;
+
+        // Queue a line, printf style, without newline
+        void print(Stream stream, Limit *limit, const char *fmt, ...) __attribute__((format(printf, 4, 5))) {
+            va_list args;
+
+            // Only the first line of a limit period is queued
+            if (limit && limit->count_.fetch_add(1, std::memory_order_relaxed) != 0) return;
+
+            if (!beginLine(stream, limit)) {
+                if (limit) limit->count_.store(0, std::memory_order_relaxed);
+                return;
+            }
+
+            va_start(args, fmt);
+            vappend_(fmt, args);
+            va_end(args);
+
+            endLine();
+        }
+
+        // Build a line in parts directly in the queue. Returns false, and
+        // nothing is queued, if the queue is full
+        bool beginLine(Stream stream, Limit *limit = nullptr) {
+            char *buf;
+
+            if (line_) return true;
+            if (!rb_.acquireWrite(&buf, sizeof(Header) + MAX_LINE_SIZE)) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            line_   = buf;
+            len_    = 0;
+            header_ = Header{ limit, 0, stream };
+
+            return true;
+        }
+
+        // Add to the line begun with beginLine()
+        void append(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+            va_list args;
+
+            va_start(args, fmt);
+            vappend_(fmt, args);
+            va_end(args);
+        }
+
+        // Hand the line over to the output thread
+        void endLine(void) {
+            if (!line_) return;
+
+            header_.len = len_;
+            memcpy(line_, &header_, sizeof(Header));
+            rb_.commitWrite(sizeof(Header) + len_);
+            line_ = nullptr;
+
+            log_.wake_();
+        }
+
+    private:
+        friend class Log;
+
+        struct Header {
+            Limit   *limit;
+            uint32_t len;       // Bytes of text after the header
+            Stream   stream;
+        };
+
+        Log                  &log_;
+        RB<char>              rb_;
+        char                 *line_;       // Line being built. Null if none
+        size_t                len_;
+        Header                header_;
+        std::atomic<uint64_t> dropped_;    // Lines that did not fit
+
+        void vappend_(const char *fmt, va_list args) {
+            if (!line_) return;
+
+            size_t left = MAX_LINE_SIZE - len_;
+            int    ret = vsnprintf(line_ + sizeof(Header) + len_, left, fmt, args);
+
+            if (ret > 0) len_ += std::min((size_t)ret, left - 1);
+        }
+    };
+
+    // The console lock, if given, is held while writing to the console so
+    // that lines are not mixed with output from other threads
+    Log(std::atomic_flag *console_lock = nullptr) :
+      console_lock_(console_lock), wake_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), run_(false) {}
+    ~Log(void) {
+        stop();
+        if (wake_fd_ >= 0) close(wake_fd_);
+    }
+
+    Log(const Log&) = delete;
+    Log& operator=(const Log&) = delete;
+
+    // Create a queue for one thread. Must be done before start()
+    Queue &queue(size_t size = QUEUE_SIZE) {
+        queues_.push_back(std::make_unique<Queue>(*this, size));
+        return *queues_.back();
+    }
+
+    // Start the output thread. Returns false on error
+    bool start(void) {
+        if (run_) return true;
+        if (wake_fd_ < 0) return false;
+
+        run_ = true;
+        thread_ = std::thread(&Log::worker_, this);
+
+        return true;
+    }
+
+    // Write everything that is queued, including pending counts, and stop
+    // the output thread
+    void stop(void) {
+        if (!run_) return;
+
+        run_ = false;
+        wake_();
+        thread_.join();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // A printed line with a limit and the time it was printed
+    struct Limited {
+        std::string       text;
+        Stream            stream;
+        Clock::time_point ts;
+    };
+
+    std::atomic_flag                   *console_lock_;
+    int                                 wake_fd_;
+    std::atomic<bool>                   run_;
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::map<Limit*, Limited>           limited_;   // Used by the output thread only
+    std::thread                         thread_;
+
+    void wake_(void) {
+        uint64_t one = 1;
+        if (write(wake_fd_, &one, sizeof(one)) < 0) {
+            // The counter is full, so the output thread is already woken up
+        }
+    }
+
+    void write_(Stream stream, const char *text, size_t len) {
+        FILE *file = stream == Stream::OUT ? stdout : stderr;
+
+        if (console_lock_) while (console_lock_->test_and_set(std::memory_order_acquire));
+        fwrite(text, 1, len, file);
+        fputc('\n', file);
+        fflush(file);
+        if (console_lock_) console_lock_->clear(std::memory_order_release);
+    }
+
+    // Write all lines in a queue
+    void drain_(Queue &queue) {
+        const char *buf;
+        size_t      len;
+
+        while (queue.rb_.acquireRead(&buf, &len)) {
+            size_t pos = 0;
+
+            while (pos + sizeof(Queue::Header) <= len) {
+                Queue::Header header;
+
+                memcpy(&header, buf + pos, sizeof(header));
+                const char *text = buf + pos + sizeof(header);
+
+                write_(header.stream, text, header.len);
+                if (header.limit) limited_[header.limit] = Limited{ std::string(text, header.len), header.stream, Clock::now() };
+
+                pos += sizeof(header) + header.len;
+            }
+
+            queue.rb_.commitRead(pos);
+        }
+
+        uint64_t dropped = queue.dropped_.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            std::string text = "Warning: " + std::to_string(dropped) + " console lines dropped.";
+            write_(Stream::ERR, text.data(), text.length());
+        }
+    }
+
+    // Write the counts of the limits that are due, or of all limits when
+    // stopping. Returns the time in ms until the next limit is due or -1 if
+    // none
+    int count_(bool stopping) {
+        Clock::time_point now = Clock::now();
+        int               timeout = -1;
+
+        auto iter = limited_.begin();
+        while (iter != limited_.end()) {
+            Limit   &limit = *iter->first;
+            Limited &limited = iter->second;
+            auto     age = std::chrono::duration_cast<std::chrono::milliseconds>(now - limited.ts).count();
+
+            if (!stopping && age < LIMIT_MS) {
+                int left = LIMIT_MS - age;
+                if (timeout < 0 || left < timeout) timeout = left;
+                ++iter;
+                continue;
+            }
+
+            // No more lines. The next one is printed right away
+            unsigned count = limit.count_.load(std::memory_order_relaxed);
+            if (count <= 1 && limit.count_.compare_exchange_strong(count, 0, std::memory_order_relaxed)) {
+                iter = limited_.erase(iter);
+                continue;
+            }
+
+            // Keep counting from one so that the lines in the next period are
+            // counted as well
+            count = limit.count_.exchange(stopping ? 0 : 1, std::memory_order_relaxed);
+            std::string text = limited.text + " [x" + std::to_string(count - 1) + " in last " +
+                               std::to_string(LIMIT_MS / 1000) + " s]";
+            write_(limited.stream, text.data(), text.length());
+
+            if (stopping) {
+                iter = limited_.erase(iter);
+                continue;
+            }
+
+            limited.ts = now;
+            if (timeout < 0 || (int)LIMIT_MS < timeout) timeout = LIMIT_MS;
+            ++iter;
+        }
+
+        return timeout;
+    }
+
+    void worker_(void) {
+        struct pollfd pfd = { wake_fd_, POLLIN, 0 };
+        int           timeout = -1;
+
+        // Console output is never urgent. On Linux this only affects the
+        // calling thread
+        if (setpriority(PRIO_PROCESS, 0, NICE) < 0) {
+            // Run at normal priority
+        }
+
+        while (run_) {
+            uint64_t count;
+
+            // Sleep until a line is queued or a limit is due
+            poll(&pfd, 1, timeout);
+            if (read(wake_fd_, &count, sizeof(count)) < 0) {
+                // Woken up by the timeout
+            }
+
+            for (auto &queue : queues_) drain_(*queue);
+            timeout = count_(false);
+        }
+
+        for (auto &queue : queues_) drain_(*queue);
+        count_(true);
+    }
+};
+
+#endif // LOG_HPP
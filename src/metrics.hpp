@@ -0,0 +1,174 @@
+//
+// Metrics endpoint in the Prometheus text format
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <string>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <cstdint>
+
+// App.h from uWebSockets with the debug printouts removed. Generated by cmake
+#include "App-fixed.h"
+
+// Short text, like a channel name, that is set by one thread and read by
+// any other thread without locks. Works like a seqlock: the reader retries
+// if the text was changed while it was read. Text longer than MAX_LEN is cut
+class MetricsLabel {
+public:
+    static constexpr unsigned MAX_LEN = 31;
+
+    MetricsLabel(void) {
+        for (auto &c : text_) c.store('\0', std::memory_order_relaxed);
+    }
+
+    MetricsLabel(const MetricsLabel&) = delete;
+    MetricsLabel& operator=(const MetricsLabel&) = delete;
+
+    // Set the text. Must only be called from one thread. Returns true if
+    // the text was changed
+    bool set(const std::string &text) {
+        if (text.compare(0, MAX_LEN, current_) == 0) return false;
+        current_.assign(text, 0, MAX_LEN);
+
+        uint32_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (unsigned i = 0; i <= MAX_LEN; ++i) {
+            text_[i].store(i < current_.length() ? current_[i] : '\0', std::memory_order_relaxed);
+        }
+        seq_.store(seq + 2, std::memory_order_release);
+
+        return true;
+    }
+
+    // Get the text. Can be called from any thread
+    std::string get(void) const {
+        std::string text;
+        uint32_t    seq;
+
+        do {
+            text.clear();
+            seq = seq_.load(std::memory_order_acquire);
+            for (auto &c : text_) {
+                char ch = c.load(std::memory_order_relaxed);
+                if (ch == '\0') break;
+                text += ch;
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) || seq != seq_.load(std::memory_order_relaxed));
+
+        return text;
+    }
+
+private:
+    std::atomic<uint32_t>                    seq_ = 0;   // Odd while the text is being changed
+    std::array<std::atomic<char>, MAX_LEN+1> text_;
+    std::string                              current_;   // Writer's copy of the text
+};
+
+
+// HTTP server for the metrics endpoint, built on uWebSockets. A GET on
+// /metrics calls the render function and returns the result as plain text.
+// Works fine with Prometheus or curl:
+//
+//     $ curl http://localhost:9100/metrics
+//
+// The render function is called in the context of the internal thread and
+// should only read counters that other threads update. Every response closes
+// the connection so that the server can be stopped without waiting for idle
+// clients.
+class MetricsServer {
+public:
+    using Render = std::function<std::string(void)>;
+
+    MetricsServer(int port, Render render) : port_(port), render_(render), loop_(nullptr), listen_socket_(nullptr) {}
+    ~MetricsServer(void) { stop(); }
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    // Start the server thread and listen on the port on all interfaces.
+    // Returns false if the port could not be opened
+    bool start(void) {
+        if (thread_.joinable()) return true;
+
+        std::promise<bool> listening;
+        std::future<bool>  result = listening.get_future();
+
+        thread_ = std::thread(&MetricsServer::worker_, this, std::move(listening));
+        if (!result.get()) {
+            thread_.join();
+            return false;
+        }
+
+        return true;
+    }
+
+    // Stop listening and wait for the server thread to finish
+    void stop(void) {
+        if (!thread_.joinable()) return;
+
+        // The event loop is not thread safe. Close the listen socket from
+        // within the loop. It then returns when the last connection is gone
+        loop_->defer([this](void) {
+            if (listen_socket_) {
+                us_listen_socket_close(0, listen_socket_);
+                listen_socket_ = nullptr;
+            }
+        });
+        thread_.join();
+        loop_ = nullptr;
+    }
+
+private:
+    int                 port_;
+    Render              render_;
+    uWS::Loop          *loop_;
+    us_listen_socket_t *listen_socket_;
+    std::thread         thread_;
+
+    void worker_(std::promise<bool> listening) {
+        uWS::App app;
+
+        app.get("/metrics", [this](auto *res, auto *) {
+            std::string body = render_();
+            res->writeHeader("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+            res->end(body, true);
+        }).any("/*", [](auto *res, auto *) {
+            res->writeStatus("404 Not Found");
+            res->end("Not found. Try /metrics\n", true);
+        }).listen(port_, [this](us_listen_socket_t *listen_socket) {
+            listen_socket_ = listen_socket;
+        });
+
+        loop_ = uWS::Loop::get();
+
+        bool ok = listen_socket_ != nullptr;
+        listening.set_value(ok);
+        if (ok) app.run();
+    }
+};
+
+#endif // METRICS_HPP
@@ -22,10 +22,15 @@
 #define MSD_HPP
 
 #include <vector>
+#include <memory>
+#include <utility>
 #include <cassert>
 #include <iqsample.hpp>
 
-#if defined __AVX2__
+// SDRX_DETERMINISTIC gives the portable code on every instruction set so that
+// the summation order, and thereby the result, is the same in every build
+#if defined __AVX2__ && !defined SDRX_DETERMINISTIC
+#define MSD_USE_AVX2
 #include <immintrin.h>
 #elif defined __ARM_NEON
 #include <arm_neon.h>
@@ -36,11 +41,25 @@
 // Multi-Stage Translating Down sampler
 class MSD {
 public:
+    using Coeffs = std::shared_ptr<const std::vector<iqsample_t>>;
+
     // Configuration for one down sampling stage. We need the down sampling
-    // factor and the coefficients that make up the low pass FIR filter
+    // factor and the coefficients that make up the low pass FIR filter. The
+    // coefficients in complex form, see complexCoeffs(), are shared by all
+    // MSDs constructed from the stage. If not given, every MSD gets its own
     struct Stage {
         unsigned           m;    // Down sampling factor
         std::vector<float> h;    // Low pass filter FIR coefficients
+        Coeffs             hc = nullptr; // h in complex form. Optional
+    };
+
+    // Oscillator that replaces the translator table. One complex
+    // multiplication per sample more but no table. The phase is reset to 1
+    // after len samples, where a translator table would have wrapped around,
+    // so errors do not accumulate
+    struct Oscillator {
+        unsigned len;            // Period in samples. 0 if no tuning is required
+        double   step;           // Phase step per sample in radians
     };
 
     MSD(void) = default;
@@ -50,26 +69,74 @@ public:
       m_(1), translator_(translator), trans_pos_(0), use_ftfir_(use_ftfir) {
         auto iter = stages.begin();
         while (iter != stages.end()) {
-            if (iter == stages.begin() && !translator.empty()) {
-                stages_.push_back(MSD::S(iter->m, iter->h, translator));
+            // Coefficient sets for the frequency translating FIR are only
+            // needed when it is used
+            if (iter == stages.begin() && !translator.empty() && use_ftfir) {
+                stages_.push_back(MSD::S(iter->m, stage_coeffs_(*iter), translator));
             } else {
-                stages_.push_back(MSD::S(iter->m, iter->h));
+                stages_.push_back(MSD::S(iter->m, stage_coeffs_(*iter)));
             }
             m_ = m_ * iter->m;
             ++iter;
         }
     }
 
+    // Construct a MSD that tunes with an oscillator instead of a translator
+    // table. Can not be used with the frequency translating FIR
+    MSD(const Oscillator &osc, const std::vector<MSD::Stage> &stages) :
+      m_(1), trans_pos_(0), osc_len_(osc.len), osc_step_(std::polar(1.0, osc.step)), use_ftfir_(false) {
+        for (auto &stage : stages) {
+            stages_.push_back(MSD::S(stage.m, stage_coeffs_(stage)));
+            m_ = m_ * stage.m;
+        }
+    }
+
+    // Filter coefficients in the complex form used by the stages, with the
+    // same value in the real and imaginary parts. This allows easy loading
+    // into SIMD registers. When we just need "real" coefficients, we can
+    // read the value from the real or imag part since it is the same
+    static Coeffs complexCoeffs(const std::vector<float> &h) {
+        auto hc = std::make_shared<std::vector<iqsample_t>>();
+        for (auto coeff : h) hc->push_back(iqsample_t(coeff, coeff));
+
+        return hc;
+    }
+
+    // Bytes of memory used by the MSD for the translator and the stages. The
+    // filter coefficients are not included since they are normally shared
+    size_t memoryUsage(void) const {
+        size_t mem = translator_.capacity() * sizeof(iqsample_t);
+        for (auto &stage : stages_) mem += stage.memoryUsage();
+
+        return mem;
+    }
+
     // Get decimation factor for the MSD
     unsigned m(void) { return m_; }
 
+    // Retune by taking over the translator and the frequency translating FIR
+    // coefficient sets from another MSD constructed with the same stages. The
+    // delay lines are kept. The old translator and coefficient sets are
+    // swapped into other so nothing is allocated or freed by this call
+    void retune(MSD &other) {
+        translator_.swap(other.translator_);
+        std::swap(osc_len_, other.osc_len_);
+        std::swap(osc_step_, other.osc_step_);
+        trans_pos_ = 0;
+        osc_phase_ = iqsample_t(1.0f, 0.0f);
+
+        if (!stages_.empty() && !other.stages_.empty()) {
+            stages_.front().swapTranslation(other.stages_.front());
+        }
+    }
+
     // Translate and down sample. If in_len is a multiple of m, you don't need
     // out_len since you know how many out samples that are to be output.
     inline void decimate(const iqsample_t *in, unsigned in_len, iqsample_t *out, unsigned *out_len_ptr = nullptr) {
         iqsample_t sample;
         unsigned   out_len = 0;
 
-        if (translator_.empty()) {
+        if (translator_.empty() && osc_len_ == 0) {
             // No tuning required
             for (unsigned i = 0; i < in_len; ++i) {
                 sample = in[i];
@@ -116,6 +183,33 @@ public:
                         // The stage need more samples. Do nothing more
                     }
 
+                    if (stage_iter == stages_.end()) {
+                        // Write out sample
+                        *(out++) = sample;
+                        out_len += 1;
+                    }
+                }
+            } else if (osc_len_ > 0) {
+                for (unsigned i = 0; i < in_len; ++i) {
+                    sample = in[i] * osc_phase_;
+                    osc_phase_ *= osc_step_;
+                    if (++trans_pos_ == osc_len_) {
+                        trans_pos_ = 0;
+                        osc_phase_ = iqsample_t(1.0f, 0.0f);
+                    }
+
+                    auto stage_iter = stages_.begin();
+                    while (stage_iter != stages_.end()) {
+                        if (stage_iter->addSample(sample)) {
+                            // The stage produced a out sample
+                            sample = stage_iter->calculateOutput();
+                        } else {
+                            // The stage need more samples
+                            break;
+                        }
+                        ++stage_iter;
+                    }
+
                     if (stage_iter == stages_.end()) {
                         // Write out sample
                         *(out++) = sample;
@@ -156,29 +250,19 @@ private:
     // filter coefficients
     class S {
     public:
-        S(unsigned m, const std::vector<float> h, const std::vector<iqsample_t> &translator = std::vector<iqsample_t>(0)) :
-          m_(m), d_(h.size() * 2, iqsample_t(0.0f, 0.0f)), pos_(0), isn_(m), k_(0) {
+        S(unsigned m, const Coeffs &hc, const std::vector<iqsample_t> &translator = std::vector<iqsample_t>(0)) :
+          m_(m), h_(hc), h_size_(hc->size()), d_(hc->size() * 2, iqsample_t(0.0f, 0.0f)), pos_(0), isn_(m), k_(0) {
             // Make sure that the filter coefficients can be used for folded FIR
-            assert(h.size() > 0);
-            assert((h.size() - 1) % 2 == 0);
+            assert(h_size_ > 0);
+            assert((h_size_ - 1) % 2 == 0);
 
             // Make sure the translator size and down sampling factor supports
             // frequency translating FIR
             assert(translator.size() % m_ == 0);
 
-            // We store our filter coefficients in a complex vector with
-            // the same value in the real and imaginary parts. This is then
-            // used in the SIMD optimized code to allow easy loding into
-            // SIMD registers. When we just need "real" coefficients, we
-            // can read the value from the real or imag part since it
-            // is the same.
-            auto iter = h.begin();
-            while (iter != h.end()) {
-                h_.push_back(iqsample_t(*iter, *iter));
-                ++iter;
-            }
-
             if (translator.size() > 0) {
+                const std::vector<iqsample_t> &h = *h_;
+
                 // Construct frequency translating filter coefficient set based
                 // on m, h and translator vector. Size of translator is assumed
                 // to always be evenly divisalbe by m.
@@ -192,7 +276,7 @@ private:
                         // Frequency translating FIR filter has a gain of 0.5
                         // so we need to compensate that with a factor 2 on
                         // the coefficients
-                        cc.push_back(*iter * translator[k] * 2.0f);
+                        cc.push_back(iter->real() * translator[k] * 2.0f);
                         if (++k == translator.size()) k = 0;
                         ++iter;
                     }
@@ -203,6 +287,22 @@ private:
             }
         }
 
+        // Bytes of memory used by the delay line and the frequency
+        // translating FIR coefficient sets
+        size_t memoryUsage(void) const {
+            size_t mem = d_.capacity() * sizeof(iqsample_t);
+            for (auto &cc : hk_) mem += cc.capacity() * sizeof(iqsample_t);
+
+            return mem;
+        }
+
+        // Swap frequency translating FIR coefficient sets with another stage
+        void swapTranslation(S &other) {
+            hk_.swap(other.hk_);
+            k_ = 0;
+            other.k_ = 0;
+        }
+
         // Add one new sample to the delay line
         inline bool addSample(iqsample_t sample) {
             bool ret = false;
@@ -210,10 +310,10 @@ private:
             // Add sample to the delay line at current position. Delay line
             // has doubble length and we also add the sample to pos + size
             d_[pos_] = sample;
-            d_[pos_ + h_.size()] = sample;
+            d_[pos_ + h_size_] = sample;
 
             // Advance delay line write pointer. If at the end, wrap around
-            if (++pos_ == h_.size()) pos_ = 0;
+            if (++pos_ == h_size_) pos_ = 0;
 
             // Decrease samples needed. If 0, we have enough new samples in
             // the delay line to calculate one output sample
@@ -228,18 +328,18 @@ private:
         // Calculate one output sample based on the samples in the delay line
         // and the filter coefficients
         inline iqsample_t calculateOutput(void) {
-            unsigned half_h_size = (h_.size() - 1) >> 1;
+            unsigned half_h_size = (h_size_ - 1) >> 1;
             unsigned rounded_half_h_size = (half_h_size >> 2) << 2;
             unsigned i = 0;
-            unsigned j = h_.size();
+            unsigned j = h_size_;
             float    real_sum = 0.0f;
             float    imag_sum = 0.0f;
             auto     d_ptr = &d_[pos_];
-            auto     h_ptr = &h_[0];
+            auto     h_ptr = h_->data();
 
             /*
             // Simple calculation. Not vectorize friendly. Not used
-            for (; i < h_.size(); ++i) {
+            for (; i < h_size_; ++i) {
                 real_sum += d_ptr[i].real() * h_ptr[i].real();
                 imag_sum += d_ptr[i].imag() * h_ptr[i].imag();
             }
@@ -250,7 +350,7 @@ private:
             // loop of 3, 2 or 1 iteration(s). We split the complex multiplications
             // into real and imaginary parts ourselves to trick g++ into some
             // vectorization for the portable version.
-#ifdef __AVX2__
+#ifdef MSD_USE_AVX2
             // Intel AVX SIMD variant of a folded FIR
             __m256 vec_sum = _mm256_set1_ps(0.0f);
             for (; i < rounded_half_h_size; i += 4, j -= 4) {
@@ -318,7 +418,7 @@ private:
         // is called as the first one if ftfir is used. All subsequent calls
         // use the "normal" calculateOutput() above.
         inline iqsample_t calculateOutputTranslated(void) {
-            unsigned rounded_h_size = (h_.size() >> 2) << 2;
+            unsigned rounded_h_size = (h_size_ >> 2) << 2;
             unsigned i = 0;
             float real_sum = 0.0f;
             float imag_sum = 0.0f;
@@ -328,7 +428,7 @@ private:
             /*
             // Simple calculation. Not vectorize friendly
             iqsample_t out_sample(0.0f, 0.0f);
-            for (; i < h_.size(); ++i) {
+            for (; i < h_size_; ++i) {
                 out_sample += d_ptr[i] * h_ptr[i];
             }
             real_sum = out_sample.real();
@@ -340,7 +440,7 @@ private:
             // loop of 3, 2 or 1 iteration(s). We need to split the complex
             // multiplications into real and imaginary to trick g++ into
             // vectorization.
-#ifdef __AVX2__
+#ifdef MSD_USE_AVX2
             // Intel AVX SIMD variant.
             __m256 real_sum_vec = _mm256_set1_ps(0.0f);
             __m256 imag_sum_vec = _mm256_set1_ps(0.0f);
@@ -370,7 +470,7 @@ private:
             imag_sum = imag_sum_vec[0];
 
             // Clean up the trailing 3, 2 or 1 samples with normal code
-            for (; i < h_.size(); ++i) {
+            for (; i < h_size_; ++i) {
                 real_sum += (d_ptr[i].real() * h_ptr[i].real() - d_ptr[i].imag() * h_ptr[i].imag());
                 imag_sum += (d_ptr[i].real() * h_ptr[i].imag() + d_ptr[i].imag() * h_ptr[i].real());
             }
@@ -389,7 +489,7 @@ private:
             }
 
             // Clean up the trailing 3, 2 or 1 samples
-            for (; i < h_.size(); ++i) {
+            for (; i < h_size_; ++i) {
                 real_sum += (d_ptr[i].real() * h_ptr[i].real() - d_ptr[i].imag() * h_ptr[i].imag());
                 imag_sum += (d_ptr[i].real() * h_ptr[i].imag() + d_ptr[i].imag() * h_ptr[i].real());
             }
@@ -405,8 +505,9 @@ private:
         using hk_t = std::vector<std::vector<iqsample_t>>; // Vector of FIR filter coefficients, hk
 
         unsigned                m_;     // Downsampling factor M
-        std::vector<iqsample_t> h_;     // FIR coefficients, h, in complex form (same value in real and imag)
-        std::vector<iqsample_t> d_;     // Delay line with input samples. 2 * h_.size() to avoid wrap around
+        Coeffs                  h_;     // FIR coefficients, h, in complex form (same value in real and imag)
+        unsigned                h_size_; // Number of FIR coefficients
+        std::vector<iqsample_t> d_;     // Delay line with input samples. 2 * h_size_ to avoid wrap around
         unsigned                pos_;   // Current write position in the delay line
         unsigned                isn_;   // New in-samples needed in the delay line before an output sample can be calculated
         hk_t                    hk_;    // Frequency translating FIR filter coefficient sets
@@ -416,8 +517,15 @@ private:
     std::vector<MSD::S>     stages_;     // List of stages
     unsigned                m_;          // Total down sampling factor
     std::vector<iqsample_t> translator_; // Frequency tuning sequence
-    unsigned                trans_pos_;  // Position in translator
+    unsigned                trans_pos_;  // Position in translator, or in the oscillator period
+    unsigned                osc_len_ = 0;                      // Oscillator period. 0 if the translator is used
+    iqsample_t              osc_step_ = iqsample_t(1.0f, 0.0f);  // Oscillator phase step per sample
+    iqsample_t              osc_phase_ = iqsample_t(1.0f, 0.0f); // Oscillator phase
     bool                    use_ftfir_;  // Use frequency translating FIR for firts stage
+
+    static Coeffs stage_coeffs_(const MSD::Stage &stage) {
+        return stage.hc ? stage.hc : complexCoeffs(stage.h);
+    }
 };
 
 #endif // MSD_HPP
@@ -0,0 +1,189 @@
+//
+// Hardware performance counters for the stages of the receiver
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef PERF_HPP
+#define PERF_HPP
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+
+// Counts of the hardware events below for the calling thread, in user space
+// only. Kernel and hypervisor time is excluded so that the perf_event_paranoid
+// default of 2 is enough.
+class PerfCounters {
+public:
+    enum Event { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, NUM_EVENTS };
+
+    using Counts = std::array<uint64_t, NUM_EVENTS>;
+
+    // Check that the counters can be opened on this host. Returns an empty
+    // string on success and the reason otherwise
+    static std::string probe(void) {
+        int fd = open_(CYCLES, -1);
+        if (fd < 0) return errno == ENOENT || errno == EOPNOTSUPP ? "No hardware counters on this host" : strerror(errno);
+
+        close(fd);
+        return "";
+    }
+
+    // Current counts for the calling thread. The counters are opened the
+    // first time a thread calls this. Returns false if they can not be
+    // opened. Events that the host does not support read as zero
+    static bool read(Counts &counts) {
+        thread_local PerfCounters group;
+
+        return group.read_(counts);
+    }
+
+    // True if the event could be opened by any thread. Unsupported events
+    // are left out of the report
+    static bool supported(unsigned event) { return supported_[event].load(std::memory_order_relaxed); }
+
+    // True if the counters of any thread have shared the hardware with other
+    // perf users, e.g. perf record or the NMI watchdog. The counts are then
+    // scaled up to the time the group was enabled and are estimates
+    static bool multiplexed(void) { return multiplexed_.load(std::memory_order_relaxed); }
+
+private:
+    // Group read format with PERF_FORMAT_GROUP | PERF_FORMAT_ID and the
+    // enabled and running times
+    struct ReadFormat {
+        uint64_t nr;
+        uint64_t time_enabled;
+        uint64_t time_running;
+        struct { uint64_t value; uint64_t id; } values[NUM_EVENTS];
+    };
+
+    static inline std::atomic<bool> supported_[NUM_EVENTS] = {};
+    static inline std::atomic<bool> multiplexed_ = false;
+
+    std::array<int, NUM_EVENTS>      fds_;
+    std::array<uint64_t, NUM_EVENTS> ids_;     // Zero for events that could not be opened
+
+    PerfCounters(void) {
+        fds_.fill(-1);
+        ids_.fill(0);
+
+        // Cycles lead the group so that all events are counted over the
+        // same time
+        fds_[CYCLES] = open_(CYCLES, -1);
+        if (fds_[CYCLES] < 0) return;
+
+        for (unsigned event = 0; event < NUM_EVENTS; ++event) {
+            if (event != CYCLES) fds_[event] = open_(event, fds_[CYCLES]);
+            if (fds_[event] < 0 || ioctl(fds_[event], PERF_EVENT_IOC_ID, &ids_[event]) != 0) continue;
+
+            supported_[event].store(true, std::memory_order_relaxed);
+        }
+    }
+
+    ~PerfCounters(void) {
+        for (auto fd : fds_) {
+            if (fd >= 0) close(fd);
+        }
+    }
+
+    bool read_(Counts &counts) const {
+        ReadFormat data;
+
+        counts.fill(0);
+        if (fds_[CYCLES] < 0) return false;
+        if (::read(fds_[CYCLES], &data, sizeof(data)) <= 0) return false;
+
+        // The group has only been on the PMU part of the time it was enabled
+        // when it is multiplexed with other events. Scale the counts up to
+        // the whole time
+        double scale = 1.0;
+        if (data.time_running > 0 && data.time_running < data.time_enabled) {
+            scale = (double)data.time_enabled / data.time_running;
+            multiplexed_.store(true, std::memory_order_relaxed);
+        }
+
+        for (unsigned i = 0; i < data.nr && i < NUM_EVENTS; ++i) {
+            for (unsigned event = 0; event < NUM_EVENTS; ++event) {
+                if (ids_[event] == data.values[i].id) counts[event] = (uint64_t)(data.values[i].value * scale);
+            }
+        }
+
+        return true;
+    }
+
+    static int open_(unsigned event, int group_fd) {
+        static const uint64_t configs[NUM_EVENTS] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+        };
+
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.type           = PERF_TYPE_HARDWARE;
+        attr.config         = configs[event];
+        attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+
+        // Calling thread, any CPU
+        return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+    }
+};
+
+
+// Counts accumulated over the blocks of one stage. Recorded by one thread at
+// a time and read at any time without locks, like LatencyHist
+class PerfStage {
+public:
+    PerfStage(void) {
+        for (auto &c : counts_) c.store(0, std::memory_order_relaxed);
+    }
+
+    PerfStage(const PerfStage&) = delete;
+    PerfStage& operator=(const PerfStage&) = delete;
+
+    // Add the difference between two reads of the counters as one block.
+    // The name of the recording thread is kept for the report
+    void record(const PerfCounters::Counts &start, const PerfCounters::Counts &end, const char *thread) {
+        for (unsigned event = 0; event < PerfCounters::NUM_EVENTS; ++event) {
+            counts_[event].store(counts_[event].load(std::memory_order_relaxed) + end[event] - start[event], std::memory_order_relaxed);
+        }
+        blocks_.store(blocks_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        thread_.store(thread, std::memory_order_relaxed);
+    }
+
+    uint64_t blocks(void) const { return blocks_.load(std::memory_order_relaxed); }
+    uint64_t count(unsigned event) const { return counts_[event].load(std::memory_order_relaxed); }
+    const char *thread(void) const { return thread_.load(std::memory_order_relaxed); }
+
+private:
+    std::array<std::atomic<uint64_t>, PerfCounters::NUM_EVENTS> counts_;
+    std::atomic<uint64_t>                                       blocks_ = 0;
+    std::atomic<const char*>                                    thread_ = "";
+};
+
+#endif // PERF_HPP
@@ -23,6 +23,7 @@
 #include "r820_dev.hpp"
 #include "rtl_dev.hpp"
 #include "airspy_dev.hpp"
+#include "sim_dev.hpp"
 
 
 R820Dev::R820Dev(const std::string &serial, SampleRate rate)
@@ -37,6 +38,21 @@ R820Dev::~R820Dev(void) {
 }
 
 
+bool R820Dev::sleep_(std::chrono::milliseconds time) {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+
+    return !sleep_condition_.wait_for(lock, time, [this](void) { return !run_; });
+}
+
+
+void R820Dev::halt_(void) {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    run_ = false;
+    lock.unlock();
+    sleep_condition_.notify_all();
+}
+
+
 //
 // Static functions below
 //
@@ -55,6 +71,11 @@ R820Dev *R820Dev::create(Type type, const std::string &serial, SampleRate rate,
             dev_ptr->type_ = type;
             break;
 
+        case Type::SIM:
+            dev_ptr = new SimDev(serial, rate);
+            dev_ptr->type_ = type;
+            break;
+
         default:
             dev_ptr = nullptr;
             break;
@@ -97,10 +118,12 @@ const std::string &R820Dev::typeToStr(Type type) {
     static const std::string UNKNOWN_STR("Unknown");
     static const std::string RTL_STR("RTL");
     static const std::string AIRSPY_STR("Airspy");
+    static const std::string SIM_STR("Sim");
 
     switch (type) {
         case Type::RTL:    return RTL_STR;
         case Type::AIRSPY: return AIRSPY_STR;
+        case Type::SIM:    return SIM_STR;
         default:           return UNKNOWN_STR;
     }
 }
@@ -109,7 +132,9 @@ const std::string &R820Dev::typeToStr(Type type) {
 R820Dev::Type R820Dev::getType(const std::string &serial) {
     Type type = Type::UNKNOWN;
 
-    if (RtlDev::isPresent(serial)) {
+    if (SimDev::isPresent(serial)) {
+        type = Type::SIM;
+    } else if (RtlDev::isPresent(serial)) {
         type = Type::RTL;
     } else if (AirspyDev::isPresent(serial)) {
         type = Type::AIRSPY;
@@ -127,6 +152,8 @@ bool R820Dev::rateSupported(const std::string &serial, SampleRate rate) {
         supported = RtlDev::rateSupported(serial, rate);
     } else if (type == Type::AIRSPY) {
         supported = AirspyDev::rateSupported(serial, rate);
+    } else if (type == Type::SIM) {
+        supported = SimDev::rateSupported(serial, rate);
     }
 
     return supported;
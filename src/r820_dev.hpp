@@ -25,6 +25,8 @@
 #include <cstdint>
 #include <string>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
 
 #include <sigc++/sigc++.h>
 
@@ -42,8 +44,9 @@ static const float vga_gain_steps[] = { 0.0f, 2.6f, 2.6f, 3.0f, 4.2f, 3.5f, 2.4f
 
 class R820Dev {
 public:
-    // Device types that this interface class support
-    enum class Type { UNKNOWN, RTL, AIRSPY };
+    // Device types that this interface class support. SIM is a simulated
+    // device for testing without hardware
+    enum class Type { UNKNOWN, RTL, AIRSPY, SIM };
 
     // Struct for information about a device on the system
     struct Info {
@@ -94,6 +97,10 @@ public:
 
         // Timestamp (set by the host) for the last sample in the block
         TimeStamp   ts;
+
+        // Total number of samples dropped by the device since the device was
+        // started. Always 0 for devices that can not report drops
+        uint64_t    dropped;
     };
 
     // Factory function for creating a new instance
@@ -128,6 +135,9 @@ public:
     // is stopped and the device is fully closed
     virtual int stop(void) = 0;
 
+    // Bytes of memory used by the instance for sample buffers
+    virtual size_t bufferMemory(void) const = 0;
+
     // Get the current state of the device manager
     State getState(void) { return state_; }
 
@@ -165,8 +175,18 @@ protected:
     bool           run_;
     BlockInfo      block_info_;
 
+    // Sleep in the worker thread for the given time or until halt_() is
+    // called. Returns false if halted
+    bool sleep_(std::chrono::milliseconds time);
+
+    // Clear run_ and wake up a worker thread sleeping in sleep_(). Used by
+    // stop() so that it does not have to wait out a sleep
+    void halt_(void);
+
 private:
-    Type           type_;
+    Type                    type_;
+    std::mutex              sleep_mutex_;
+    std::condition_variable sleep_condition_;
 };
 
 #endif // R820_DEV_HPP
@@ -0,0 +1,339 @@
+//
+// Rate plans for the multi stage down sampler
+//
+// @author Johan Hedin
+// @date   2021 - 2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef RATE_PLAN_HPP
+#define RATE_PLAN_HPP
+
+#include <vector>
+#include <string>
+#include <map>
+#include <complex>
+#include <numeric>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <cctype>
+
+#include "iqsample.hpp"
+#include "rates.hpp"
+#include "msd.hpp"
+
+// Down sampling filters
+#include "filters/fs_00960_08bit_ds_to_00016.hpp"
+#include "filters/fs_01200_08bit_ds_to_00016.hpp"
+#include "filters/fs_01440_08bit_ds_to_00016.hpp"
+#include "filters/fs_01600_08bit_ds_to_00016.hpp"
+#include "filters/fs_01920_08bit_ds_to_00016.hpp"
+#include "filters/fs_02400_08bit_ds_to_00016.hpp"
+#include "filters/fs_02560_08bit_ds_to_00016.hpp"
+#include "filters/fs_06000_12bit_ds_to_00016.hpp"
+#include "filters/fs_10000_12bit_ds_to_00016.hpp"
+
+// Translator length, translator periods and down sampling stages for a sample
+// rate. N is 0 if the sample rate is not supported
+struct RatePlan {
+    int                     N = 0;   // Translator length
+    int                     z = 1;   // Translator periods
+    std::vector<MSD::Stage> stages;  // Down sampling stages
+};
+
+
+static inline RatePlan get_rate_plan(SampleRate rate) {
+    // Determine lenght of translator based on Fs and set up down sampling
+    // filters. N and z depends on the IQ sampling fq:
+    //
+    //     N = Fs * z / 8333.33333
+    //
+    // N must be an even number.
+    //
+    // Fs(Ms/s)    N      z
+    // --------------------
+    //  0.96       576    5
+    //  1.2        144    1
+    //  1.44      1728   10
+    //  1.6        192    1
+    //  1.92      1152    5
+    //  2.4        288    1
+    //  2.56      1536    5
+    //  6.0        720    1
+    // 10.0       1200    1
+    //
+    // Note: If z != 1, ch_offset must be multiplied with z also.
+    RatePlan plan;
+
+    switch (rate) {
+        case SampleRate::FS00960:
+            plan.N =  576; plan.z = 5;
+            plan.stages = std::vector<MSD::Stage>{
+                { 3, fs_00960_08bit_ds_lpf1_00960_to_00320 },
+                { 4, fs_00960_08bit_ds_lpf2_00320_to_00080 },
+                { 5, fs_00960_08bit_ds_lpf3_00080_to_00016 }
+            };
+            break;
+        case SampleRate::FS01200:
+            plan.N =  144; plan.z = 1;
+            plan.stages = std::vector<MSD::Stage>{
+                { 3, fs_01200_08bit_ds_lpf1_01200_to_00400 },
+                { 5, fs_01200_08bit_ds_lpf2_00400_to_00080 },
+                { 5, fs_01200_08bit_ds_lpf3_00080_to_00016 }
+            };
+            break;
+        case SampleRate::FS01440:
+            plan.N = 1728; plan.z = 10;
+            plan.stages = std::vector<MSD::Stage>{
+                { 3, fs_01440_08bit_ds_lpf1_01440_to_00400 },
+                { 6, fs_01440_08bit_ds_lpf2_00480_to_00080 },
+                { 5, fs_01440_08bit_ds_lpf3_00080_to_00016 }
+            };
+            break;
+        case SampleRate::FS01600:
+            plan.N =  192; plan.z = 1;
+            plan.stages = std::vector<MSD::Stage>{
+                { 4, fs_01600_08bit_ds_lpf1_01600_to_00400 },
+                { 5, fs_01600_08bit_ds_lpf2_00400_to_00080 },
+                { 5, fs_01600_08bit_ds_lpf3_00080_to_00016 }
+            };
+            break;
+        case SampleRate::FS01920:
+            plan.N = 1152; plan.z = 5;
+            plan.stages = std::vector<MSD::Stage>{
+                { 4, fs_01920_08bit_ds_lpf1_01920_to_00480 },
+                { 6, fs_01920_08bit_ds_lpf2_00480_to_00080 },
+                { 5, fs_01920_08bit_ds_lpf3_00080_to_00016 }
+            };
+            break;
+        case SampleRate::FS02400:
+            plan.N =  288; plan.z = 1;
+            plan.stages = std::vector<MSD::Stage>{
+                { 2, fs_02400_08bit_ds_lpf1_02400_to_01200 },
+                { 3, fs_02400_08bit_ds_lpf2_01200_to_00400 },
+                { 5, fs_02400_08bit_ds_lpf3_00400_to_00080 },
+                { 5, fs_02400_08bit_ds_lpf4_00080_to_00016 }
+            };
+            break;
+        case SampleRate::FS02500:
+            plan.N =  300; plan.z = 1;
+            break;
+        case SampleRate::FS02560:
+            plan.N = 1536; plan.z = 5; // will not work for fq trans fir... Can be solved with a 16, 5, 2 stage layout
+            plan.stages = std::vector<MSD::Stage>{
+                { 20, fs_02560_08bit_ds_lpf1_02560_to_00128 },
+                {  4, fs_02560_08bit_ds_lpf2_00128_to_00032 },
+                {  2, fs_02560_08bit_ds_lpf4_00032_to_00016 }
+            };
+            break;
+        case SampleRate::FS03000:
+            plan.N =  360; plan.z = 1;
+            break;
+        case SampleRate::FS06000:
+            plan.N =  720; plan.z = 1;
+            plan.stages = std::vector<MSD::Stage>{
+                { 15, fs_06000_12bit_ds_lpf1_06000_to_00400 },
+                {  5, fs_06000_12bit_ds_lpf3_00400_to_00080 },
+                {  5, fs_06000_12bit_ds_lpf4_00080_to_00016 }
+            };
+            break;
+        case SampleRate::FS10000:
+            plan.N = 1200; plan.z = 1;
+            plan.stages = std::vector<MSD::Stage>{
+                { 5, fs_10000_12bit_ds_lpf1_10000_to_02000 },
+                { 5, fs_10000_12bit_ds_lpf2_02000_to_00400 },
+                { 5, fs_10000_12bit_ds_lpf3_00400_to_00800 },
+                { 5, fs_10000_12bit_ds_lpf4_00080_to_00016 }
+            };
+            break;
+        default:
+            break;
+    }
+
+    // All down samplers made from the plan share the filter coefficients
+    for (auto &stage : plan.stages) stage.hc = MSD::complexCoeffs(stage.h);
+
+    return plan;
+}
+
+
+// Length of the translator for a channel offset (in 8.33kHz steps). The
+// translator repeats itself after N/gcd(N, ch_offset*z) samples so only one
+// period is needed. The frequency translating FIR needs a length that is a
+// multiple of the first stage down sampling factor. A short translator gives
+// fewer coefficient sets and a smaller cache footprint
+static inline int translator_len(int ch_offset, const RatePlan &plan, bool use_ftfir) {
+    if (ch_offset == 0) return 0;
+
+    int len = plan.N / std::gcd(plan.N, std::abs(ch_offset * plan.z));
+    if (use_ftfir) len = std::lcm(len, (int)plan.stages.front().m);
+
+    return len;
+}
+
+
+// Create the translator that moves a channel at ch_offset (in 8.33kHz steps)
+// from the tuner frequency to DC. Empty if ch_offset is 0
+static inline std::vector<iqsample_t> make_translator(int ch_offset, const RatePlan &plan, bool use_ftfir) {
+    std::vector<iqsample_t> translator;
+
+    int len = translator_len(ch_offset, plan, use_ftfir);
+    for (int n = 0; n < len; n++) {
+        std::complex<float> e(0.0f, -2.0f * M_PI * n * ch_offset * (float)plan.z/(float)plan.N);
+        translator.push_back(exp(e));
+    }
+
+    return translator;
+}
+
+
+// Create the oscillator that moves a channel at ch_offset (in 8.33kHz steps)
+// from the tuner frequency to DC. Same as make_translator() but without the
+// table and the frequency translating FIR
+static inline MSD::Oscillator make_oscillator(int ch_offset, const RatePlan &plan) {
+    return MSD::Oscillator{ (unsigned)translator_len(ch_offset, plan, false), -2.0 * M_PI * ch_offset * (double)plan.z/(double)plan.N };
+}
+
+
+// Parse a string with a frequency in MHz and with dot (.) as decimal separator
+// into a frequency in Hz. If aeronautical is true, the parser expect a
+// aeronautical 8.33 or 25 kHz channel number instead of a frequency.
+//
+// Returns the parsed frequency or 0 if a invalid string is given.
+static inline uint32_t parse_fq(const std::string &str, bool aeronautical = false) {
+    uint32_t fq = 0;
+    unsigned mhz = 0;
+    unsigned hz = 0;
+
+    // Dot is used as decimal separator
+    auto dot_pos = str.find_first_of('.');
+
+    // Decimal dot must be present
+    if (dot_pos == std::string::npos) return 0;
+
+    auto int_str  = str.substr(0, dot_pos); // integral part
+    auto frac_str = str.substr(dot_pos+1);  // fractional part
+
+    // Integral and fractional strings must contain digits and have correct lengths
+    if (!std::all_of(int_str.begin(), int_str.end(), ::isdigit) ||
+        !std::all_of(frac_str.begin(), frac_str.end(), ::isdigit) ||
+        int_str.length() < 2 || int_str.length() > 4 ||
+        frac_str.length() == 0 || frac_str.length() > 6
+    ) return 0;
+
+    // Aeronautical notation reqires exactly thre digits in the fractional part
+    if (aeronautical && frac_str.length() != 3) return 0;
+
+    if (aeronautical) {
+        // A 100kHz wide band "contains" 12 8.33kHz channels or 4 25kHz
+        // channels. Each channel has it's unique two digits making it
+        // possible to correctly convert a channel in both schemas
+        const std::map<std::string, unsigned> sub_ch_map{
+            { "00",     0 }, { "05",     0 }, { "10",  8333 }, { "15", 16667 },
+            { "25", 25000 }, { "30", 25000 }, { "35", 33333 }, { "40", 41667 },
+            { "50", 50000 }, { "55", 50000 }, { "60", 58333 }, { "65", 66667 },
+            { "75", 75000 }, { "80", 75000 }, { "85", 83333 }, { "90", 91667 }
+        };
+        auto sub_ch = sub_ch_map.find(frac_str.substr(1));
+        if (sub_ch != sub_ch_map.end()) {
+            mhz = std::atol(int_str.c_str());
+            hz = (frac_str[0] - '0') * 100000 + sub_ch->second;
+        }
+    } else {
+        mhz = std::atol(int_str.c_str());
+        const std::vector<unsigned> frac_multipliers = { 100000, 10000, 1000, 100, 10, 1 };
+
+        auto digit = frac_str.begin();
+        auto multi = frac_multipliers.begin();
+        while (digit != frac_str.end()) {
+            hz += (*digit - '0') * *multi;
+            ++digit;
+            ++multi;
+        }
+    }
+
+    if (mhz < 4000) {
+        fq = mhz * 1000000 + hz;
+    }
+
+    return fq;
+}
+
+
+// Check that a channel is inside the usable bandwidth around the tuner
+// frequency, 80% of the sample rate
+static inline bool channel_in_bandwidth(const std::string &channel, uint32_t tuner_fq, SampleRate rate) {
+    int64_t fq_diff = (int64_t)parse_fq(channel, true) - (int64_t)tuner_fq;
+    int64_t half_bw = sample_rate_to_uint(rate) * 8 / 20; // 40% of sample rate
+
+    return std::abs(fq_diff) <= half_bw;
+}
+
+
+// Given a channel and tuner center frequency, return how many 8.33kHz steps
+// the channel is with respect to the tuner center. The channel must be one
+// that parse_fq() accepts as an aeronautical channel
+static inline int channel_to_offset(const std::string &channel, int32_t tuner_fq) {
+    int32_t fq_base;
+    int32_t fq_diff;
+    int32_t offset_diff;
+    int     offset;
+
+    // Dot is used as decimal separator
+    auto dot_pos  = channel.find_first_of('.');
+    auto int_str  = channel.substr(0, dot_pos); // integral part
+    auto frac_str = channel.substr(dot_pos+1);  // fractional part
+
+    // A 100kHz wide band "contains" 12 8.33kHz channels or 4 25kHz
+    // channels. Each channel has it's unique two digits making it
+    // possible to correctly convert a channel to offset in both schemas
+    const std::map<std::string, int> sub_ch_map{
+        { "00",  0 }, { "05",  0 }, { "10",  1 }, { "15",  2 },
+        { "25",  3 }, { "30",  3 }, { "35",  4 }, { "40",  5 },
+        { "50",  6 }, { "55",  6 }, { "60",  7 }, { "65",  8 },
+        { "75",  9 }, { "80",  9 }, { "85", 10 }, { "90", 11 }
+    };
+    auto sub_offset = sub_ch_map.find(frac_str.substr(1));
+
+    fq_base = std::atol(int_str.c_str())*1000000;
+    fq_base += (frac_str[0] - '0') * 100000;
+    fq_diff = fq_base - tuner_fq;
+    offset_diff = (fq_diff / 100000)*12;
+    offset = offset_diff + sub_offset->second;
+
+    return offset;
+}
+
+
+// Create the translator that moves a channel to DC. Empty if the channel is
+// at the tuner frequency or not given
+static inline std::vector<iqsample_t> make_translator(const std::string &channel, uint32_t tuner_fq, const RatePlan &plan, bool use_ftfir) {
+    if (channel.empty()) return std::vector<iqsample_t>();
+
+    return make_translator(channel_to_offset(channel, (int32_t)tuner_fq), plan, use_ftfir);
+}
+
+
+// Create the oscillator that moves a channel to DC. Period 0 if the channel
+// is at the tuner frequency or not given
+static inline MSD::Oscillator make_oscillator(const std::string &channel, uint32_t tuner_fq, const RatePlan &plan) {
+    if (channel.empty()) return MSD::Oscillator{ 0, 0.0 };
+
+    return make_oscillator(channel_to_offset(channel, (int32_t)tuner_fq), plan);
+}
+
+#endif // RATE_PLAN_HPP
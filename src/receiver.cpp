@@ -0,0 +1,122 @@
+//
+// Headless receiver engine
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include <cmath>
+
+#include "receiver.hpp"
+#include "coeffs.hpp"
+
+
+Receiver::Receiver(SampleRate rate, uint32_t tuner_fq, bool use_ftfir)
+ : rate_(rate), tuner_fq_(tuner_fq), use_ftfir_(use_ftfir), plan_(get_rate_plan(rate)) {}
+
+
+Receiver::~Receiver(void) {
+    detach();
+}
+
+
+int Receiver::addChannel(const std::string &name, float sql_level, Modulation mod, bool use_lf_agc) {
+    if (!valid()) return -1;
+
+    uint32_t fq = parse_fq(name, true);
+    if (fq < 45000000 || fq > 1800000000) return -1;
+    if (!channel_in_bandwidth(name, tuner_fq_, rate_)) return -1;
+    if (sql_level < 0.0f || sql_level > 50.0f) return -1;
+
+    auto ch = std::make_unique<Chan>();
+    ch->name = name;
+    ch->msd = MSD(make_translator(name, tuner_fq_, plan_, use_ftfir_), plan_.stages, use_ftfir_);
+    ch->demod = Demod(mod);
+    ch->sql_level = sql_level;
+    setupAgc(ch->agc, ch->agc_lf, use_lf_agc);
+
+    channels_.push_back(std::move(ch));
+
+    return channels_.size() - 1;
+}
+
+
+void Receiver::process(const iqsample_t *data, unsigned data_len) {
+    for (unsigned idx = 0; idx < channels_.size(); ++idx) {
+        Chan     &ch = *channels_[idx];
+        unsigned  len = 0;
+
+        ch.msd.decimate(data, data_len, ch.iq_buf, &len);
+        if (len != BLOCK_SIZE) continue;  // Not a 32ms block
+
+        iq.emit(idx, ch.iq_buf, len);
+
+        demodBlock(ch.agc, ch.agc_lf, ch.demod, ch.iq_buf, ch.sql_state, ch.sql_state_prev, ch.audio_buf);
+
+        // The squelch is updated after the block has been demodulated, as
+        // in sdrx, so that the new state is heard from the next block
+        SqlMeter::Levels levels = sql_meter_.measure(ch.iq_buf);
+        ch.snr = levels.snr;
+        ch.sql_state = SqlMeter::gate(ch.sql_state, levels.snr, ch.sql_level);
+
+        audio.emit(idx, ch.audio_buf, len, ch.sql_state_prev == SQL_OPEN);
+    }
+}
+
+
+void Receiver::attach(R820Dev &dev) {
+    detach();
+    connection_ = dev.data.connect(sigc::mem_fun(*this, &Receiver::data_cb_));
+}
+
+
+void Receiver::detach(void) {
+    connection_.disconnect();
+}
+
+
+void Receiver::data_cb_(const iqsample_t *data, unsigned data_len, void *, const R820Dev::BlockInfo &block_info) {
+    if (block_info.stream_state == R820Dev::StreamState::IDLE) return;
+
+    process(data, data_len);
+}
+
+
+bool Receiver::demodBlock(AGC &agc, LfAGC &agc_lf, Demod &demod, const iqsample_t *iq,
+                          sql_state_t audio_state, sql_state_t &sql_state_prev, float *audio) {
+    bool heard = audio_state == SQL_OPEN || sql_state_prev == SQL_OPEN;
+
+    for (unsigned i = 0; i < BLOCK_SIZE; ++i) {
+        // Should we always run IQ samples through the AGC even if the squelsh is not open?
+        iqsample_t agc_adj_sample = agc.adjust(iq[i]); // AGC adjusted IQ sample
+        float      s = 0.0f;
+
+        if (audio_state == SQL_OPEN) {
+            s = agc_lf.adjust(demod.demod(agc_adj_sample));
+
+            // If the squelsh has just opend, ramp up the audio
+            if (sql_state_prev == SQL_CLOSED) s = ramp_up[i] * s;
+        } else if (sql_state_prev == SQL_OPEN) {
+            // Ramp down
+            s = ramp_down[i] * agc_lf.adjust(std::abs(agc_adj_sample));
+        }
+
+        audio[i] = s;
+    }
+    sql_state_prev = audio_state;
+
+    return heard;
+}
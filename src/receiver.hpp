@@ -0,0 +1,145 @@
+//
+// Headless receiver engine
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef RECEIVER_HPP
+#define RECEIVER_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include <sigc++/sigc++.h>
+
+#include "iqsample.hpp"
+#include "rates.hpp"
+#include "rate_plan.hpp"
+#include "msd.hpp"
+#include "agc.hpp"
+#include "demod.hpp"
+#include "sql.hpp"
+#include "r820_dev.hpp"
+
+
+// Receiver for a set of channels around one tuner frequency, without any
+// audio device or command line handling. Blocks of 32ms of IQ samples, as
+// delivered by R820Dev, are down sampled to every channel, run through the
+// AGC, demodulated and squelched in the same way as in sdrx. Everything runs
+// in the thread that calls process(), or in the thread of the device when
+// attached to one.
+//
+// The result of every block is emitted on the signals below. The data is
+// owned by the receiver and is only valid during the call, so nothing is
+// copied unless the slot does it.
+class Receiver {
+public:
+    static constexpr unsigned BLOCK_SIZE = SqlMeter::SIZE;  // Channel samples per block. 32ms at 16kS/s
+
+    Receiver(SampleRate rate, uint32_t tuner_fq, bool use_ftfir = false);
+
+    // Instances of this class is not intended to be copied in any way
+    Receiver(const Receiver&) = delete;
+    Receiver& operator=(const Receiver&) = delete;
+
+    ~Receiver(void);
+
+    // False if there is no rate plan for the sample rate
+    bool valid(void) const { return !plan_.stages.empty(); }
+
+    // Add a channel, e.g. "118.105", with a squelch level in dB. Returns
+    // the index of the channel or -1 if the sample rate is not supported,
+    // the channel is not a valid aeronautical channel, is outside the
+    // bandwidth around the tuner frequency or the squelch level is not
+    // between 0 and 50dB, as for the channels given to sdrx
+    int addChannel(const std::string &name, float sql_level = 9.0f, Modulation mod = Modulation::AM, bool use_lf_agc = false);
+
+    size_t numChannels(void) const { return channels_.size(); }
+    const std::string &name(unsigned ch) const { return channels_[ch]->name; }
+
+    // SNR in dB and squelch state of the last block for a channel
+    float snr(unsigned ch) const { return channels_[ch]->snr; }
+    bool open(unsigned ch) const { return channels_[ch]->sql_state == SQL_OPEN; }
+
+    // Set up the AGC of a channel and the AGC for the demodulated signal
+    static void setupAgc(AGC &agc, LfAGC &agc_lf, bool use_lf_agc) {
+        agc.setReference(1.0f);
+        agc.setAttack(1.0f);
+        agc.setDecay(0.01f);
+        agc.setMaxGain(300);
+
+        agc_lf.setReference(1.0f);
+        agc_lf.setAttack(1.0f);
+        agc_lf.setDecay(0.01f);
+        if (use_lf_agc) agc_lf.activate();
+    }
+
+    // AGC, demodulation and the ramps when the squelch opens and closes for
+    // one block of BLOCK_SIZE down sampled IQ samples of a channel.
+    // audio_state is the squelch state as heard and sql_state_prev the state
+    // of the previous block, which is updated. The audio is written to
+    // audio, silent while the squelch is closed. Returns false if the whole
+    // block is silent. Used for every channel by both process() and sdrx
+    static bool demodBlock(AGC &agc, LfAGC &agc_lf, Demod &demod, const iqsample_t *iq,
+                           sql_state_t audio_state, sql_state_t &sql_state_prev, float *audio);
+
+    // Process one block of IQ samples from the device
+    void process(const iqsample_t *data, unsigned data_len);
+
+    // Process the blocks of a device as they arrive, in the thread of the
+    // device. Any previous device is detached
+    void attach(R820Dev &dev);
+    void detach(void);
+
+    // Down sampled IQ samples of a channel. Emitted for every channel and
+    // block
+    sigc::signal<void(unsigned, const iqsample_t*, unsigned)> iq;
+
+    // Demodulated audio of a channel and if the squelch is open. Silent
+    // while the squelch is closed, with a short ramp when it opens and
+    // closes. Emitted for every channel and block after iq
+    sigc::signal<void(unsigned, const float*, unsigned, bool)> audio;
+
+private:
+    struct Chan {
+        std::string        name;
+        MSD                msd;
+        AGC                agc;
+        LfAGC              agc_lf;
+        Demod              demod;
+        float              sql_level;
+        sql_state_t        sql_state = SQL_CLOSED;
+        sql_state_t        sql_state_prev = SQL_CLOSED;  // Previous squelch state as heard
+        float              snr = 0.0f;
+        iqsample_t         iq_buf[BLOCK_SIZE];
+        float              audio_buf[BLOCK_SIZE];
+    };
+
+    SampleRate                         rate_;
+    uint32_t                           tuner_fq_;
+    bool                               use_ftfir_;
+    RatePlan                           plan_;
+    std::vector<std::unique_ptr<Chan>> channels_;
+    SqlMeter                           sql_meter_;
+    sigc::connection                   connection_;
+
+    void data_cb_(const iqsample_t *data, unsigned data_len, void *user_data, const R820Dev::BlockInfo &block_info);
+};
+
+#endif // RECEIVER_HPP
@@ -75,6 +75,7 @@ int RtlDev::start() {
     block_info_.pwr = 0.0f;
     block_info_.ts = std::chrono::system_clock::now();
     block_info_.stream_state = StreamState::IDLE;
+    block_info_.dropped = 0;
 
     state_ = State::STARTING;
     run_ = true;
@@ -87,7 +88,7 @@ int RtlDev::start() {
 int RtlDev::stop() {
     if (!run_) return ReturnValue::ALREADY_STOPPED;
 
-    run_ = false;
+    halt_();
     state_ = State::STOPPING;
     worker_thread_.join();
 
@@ -229,10 +230,10 @@ void RtlDev::worker_(RtlDev &self) {
             if (self.run_) {
                 std::cerr << "Device " << self.serial_ << " disappeared. Trying to reopen...\n";
                 self.state_ = State::RESTARTING;
-                std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+                self.sleep_(std::chrono::milliseconds(1000));
             }
         } else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            self.sleep_(std::chrono::milliseconds(1000));
         }
     }
 
@@ -50,6 +50,8 @@ public:
     // is stopped and the RTL device is fully closed
     int stop(void);
 
+    size_t bufferMemory(void) const { return sizeof(iq_buffer_); }
+
     // Get a list of available devices
     static std::vector<R820Dev::Info> list(void);
 
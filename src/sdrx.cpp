@@ -24,7 +24,9 @@
 #include <unistd.h>
 #include <signal.h>
 #include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <time.h>
 
 // Standard C++ includes
@@ -46,6 +48,12 @@
 #include <map>
 #include <iomanip>
 #include <regex>
+#include <sstream>
+#include <fstream>
+#include <numeric>
+#include <array>
+#include <memory>
+#include <climits>
 
 // Libs that we use
 #include <popt.h>
@@ -56,21 +64,25 @@
 #include "coeffs.hpp"
 #include "msd.hpp"
 #include "crb.hpp"
+#include "rb.hpp"
 #include "fir.hpp"
 #include "agc.hpp"
+#include "demod.hpp"
+#include "audio.hpp"
+#include "sql.hpp"
+#include "receiver.hpp"
 #include "r820_dev.hpp"
 #include "ds.hpp"
-
-// Down sampling filters
-#include "filters/fs_00960_08bit_ds_to_00016.hpp"
-#include "filters/fs_01200_08bit_ds_to_00016.hpp"
-#include "filters/fs_01440_08bit_ds_to_00016.hpp"
-#include "filters/fs_01600_08bit_ds_to_00016.hpp"
-#include "filters/fs_01920_08bit_ds_to_00016.hpp"
-#include "filters/fs_02400_08bit_ds_to_00016.hpp"
-#include "filters/fs_02560_08bit_ds_to_00016.hpp"
-#include "filters/fs_06000_12bit_ds_to_00016.hpp"
-#include "filters/fs_10000_12bit_ds_to_00016.hpp"
+#include "evl.hpp"
+#include "tui.hpp"
+#include "log.hpp"
+#include "ctl.hpp"
+#include "det.hpp"
+#include "hist.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "perf.hpp"
+#include "rate_plan.hpp"
 
 // Channelization filers
 #include "filters/fs_00016_16bit_ch.hpp"
@@ -122,29 +134,48 @@
 //#define RTL_IQ_BUF_SIZE      (512 * DOWNSAMPLING_FACTOR * 2)  // callback frequency is 31.25Hz or 32ms
 //#define CH_IQ_SAMPLING_FQ    16000    // RTL_IQ_SAMPLING_FQ / DOWNSAMPLING_FACTOR
 #define CH_IQ_BUF_SIZE       512
+#define IQ_RB_CHUNKS         8        // Blocks in the input -> output ring buffer, or 256ms
+#define IQ_RB_CHUNKS_LOW_MEM 4        // Blocks in the ring buffer with --low-memory, or 128ms
 #define FFT_SIZE             CH_IQ_BUF_SIZE
+#define STATUS_PAGE_SIZE     10       // Channels per page in paged status printout
+#define STATUS_LINE_MS       352      // Time between status lines, or 11 blocks
+#define STATUS_GRID_MS       200      // Time between frames of the status grid
+#define STATUS_GRID_PAGE_MS  3000     // Time each page is shown when the status grid does not fit the terminal
+#define STATUS_NAME_WIDTH    12       // Max width of a channel name in the status grid
+#define STATUS_NICE          10       // Nice value of the status thread
+#define AUTO_DC_GUARD        5000     // Min distance in Hz from a channel to DC in automatic rate plan
+#define AUTO_EDGE_GUARD      8000     // Min distance in Hz from a channel to the 80% bandwidth edge in automatic rate plan
+#define SCAN_SETTLE_BLOCKS   2        // Blocks discarded after the tuner has changed scan window
+#define MAX_POOL_SIZE        32       // Max number of down samplers in the channel pool
+#define BENCH_SYNTH_BLOCKS   8        // Synthetic IQ blocks played in a loop when benchmarking
+#define BENCH_SWEEP_TIME     1        // Seconds of signal for each run in the benchmark channel sweep
+#define BLOCK_TIME_NS        32000000 // One block of IQ data is 32ms. The time budget for each stage
+#define CPU_CALIBRATION_MS   100      // CPU time used at startup to measure the speed of the down sampler
+#define CPU_BUDGET_WARN      70       // Estimated load in % of one core that gives a warning
+
+// Channels are demodulated in blocks by the receiver engine
+static_assert(CH_IQ_BUF_SIZE == Receiver::BLOCK_SIZE, "Channel block size differs from the receiver engine");
 
-static bool run = true;
 static std::atomic_flag cout_lock = ATOMIC_FLAG_INIT;
-static std::mutex              stop_mutex;
-static std::condition_variable stop_condition;
 
 // Metadata associated with one chunk of IQ data (32ms at the moment)
 struct Metadata {
     using TimeStamp = std::chrono::time_point<std::chrono::system_clock>;
 
-    TimeStamp ts;       // Timestamp for the IQ chunk (from the OS)
-    float     pwr_dbfs; // Power dBFS (ref. full scale sine wave)
+    TimeStamp ts;           // Timestamp for the IQ chunk (from the OS)
+    TimeStamp commit_ts;    // Time the chunk was written to the ring buffer. Only set with timing
+    float     pwr_dbfs;     // Power dBFS (ref. full scale sine wave)
+    uint64_t  seq;          // Block sequence number
+    unsigned  num_channels; // Number of channels in the chunk
+    bool      transitional; // Block recorded during a retune. Not to be played
+    int       window;       // Scan window the channel data belongs to. -1 if no channel data
+    std::array<int16_t, MAX_POOL_SIZE> pool; // Candidate channel for each pool down sampler. -1 if not in use
 };
 
 
 // Convenient type for the ring buffer
 using rb_t = CRB<iqsample_t, Metadata>;
 
-using sql_state_t = enum { SQL_CLOSED, SQL_OPEN };
-
-enum class Modulation { UNSPECIFIED, AM, FM };
-
 static const std::string &modulation_to_str(Modulation modulation) {
     static const std::string AM_STR("AM");
     static const std::string FM_STR("FM");
@@ -165,44 +196,12 @@ static Modulation str_to_modulation(const std::string &str) {
 }
 
 
-class Demod {
-public:
-    Demod(Modulation mod = Modulation::UNSPECIFIED) : mod_(mod), prev_sample(0, 0) {}
-    ~Demod(void) {}
-
-    float demod(iqsample_t sample) {
-        if (mod_ == Modulation::AM) {
-            return std::abs(sample);
-        } else if (mod_ == Modulation::FM) {
-            float audio_sample;
-
-            // Normalize amplitude
-            sample = sample / std::abs(sample);
-
-            float i = sample.real();
-            float q = sample.imag();
-
-            audio_sample = std::atan2(q * prev_sample.real() - i * prev_sample.imag(), i * prev_sample.real() + q * prev_sample.imag());
-
-            prev_sample = sample;
-
-            return audio_sample;
-        } else {
-            return 0.0f;
-        }
-    }
-
-private:
-    Modulation mod_;
-    iqsample_t prev_sample;
-};
-
-
 // Datatype to represent one channel in the IQ spectra
 class Channel {
 public:
-    Channel(const std::string &name, float sql_level = 9.0f, Modulation mod = Modulation::AM)
-    : name(name), ds_ptr(nullptr), sql_level(sql_level), sql_state(SQL_CLOSED), sql_state_prev(SQL_CLOSED), pos(0), mod(mod), demod(mod) {}
+    Channel(const std::string &name = "", float sql_level = 9.0f, Modulation mod = Modulation::AM)
+    : name(name), ds_ptr(nullptr), sql_level(sql_level), sql_state(SQL_CLOSED), sql_state_prev(SQL_CLOSED), pos(0), pos_fixed(false),
+      group(-1), prio(0), audio(true), window(0), mod(mod), demod(mod) {}
 
     bool operator<(const Channel &rhv) { return name < rhv.name; }
     bool operator==(const Channel &rhv) { return name == rhv.name; }
@@ -216,8 +215,13 @@ public:
     AGC              agc;            // AGC
     float            sql_level;      // Squelch level for the channel
     sql_state_t      sql_state;      // Squelch state (open/closed)
-    sql_state_t      sql_state_prev; // Previous squelch state (open/closed)
+    sql_state_t      sql_state_prev; // Previous squelch state as heard (open/closed)
     int              pos;            // Audio position. 0 == center
+    bool             pos_fixed;      // Audio position given by the user
+    int              group;          // Index in Settings::groups. -1 if not in a group
+    unsigned         prio;           // Priority. Open channels with higher priority mute lower ones
+    bool             audio;          // Channel is played on the audio output
+    unsigned         window;         // Scan window the channel belongs to
 
     FIR3<iqsample_t> ch_flt;         // Channelization filter just before demodulation
     Modulation       mod;            // Modulation, AM or FM
@@ -230,6 +234,7 @@ public:
 class Settings {
 public:
     enum class GainMode { COMPOSITE, SPLIT };
+    enum class StatusMode { ALL, OPEN, PAGE, GRID };
 
     R820Dev::Type        device_type = R820Dev::Type::UNKNOWN; // Type of device
     std::string          device_serial;                        // Serial of device
@@ -238,6 +243,8 @@ public:
     uint32_t             tuner_fq = 0;                         // Tuner frequency
     float                sql_level = 9.0f;                     // Squelch level in dB (over noise level)
     std::vector<Channel> channels;                             // String representations of the channels to listen to
+    std::vector<std::string> groups;                           // Channel group names
+    std::string          channels_file;                        // Channel configuration file
     std::string          audio_device = "default";             // ALSA device to use for playback
     float                lf_gain = 0.0f;                       // Audio volume in dB
     GainMode             gain_mode = GainMode::COMPOSITE;      // Gain mode
@@ -250,13 +257,316 @@ public:
     bool                 verbose_printout = false;             // Print extra info while running as AGC gain values
     bool                 bw_check_override = false;            // Ovveride the 80% bw check
     bool                 compact_printout = false;             // Compact printout. Will override verbose
+    StatusMode           status_mode = StatusMode::ALL;        // What channels to show in the status printout
     bool                 use_ftfir = false;                    // Use frequency translating FIR
     bool                 use_threaded_ds = false;              // Use threaded downsamplers
+    bool                 auto_plan = false;                    // Select sample rate and tuner frequency automatically
+    bool                 scan = false;                         // Scan the channels in several tuner frequency windows
+    std::vector<uint32_t> scan_fqs;                            // Tuner frequency for each scan window. Empty if not scanning
+    unsigned             scan_dwell = 200;                     // Min time in ms on a scan window
+    unsigned             scan_hang = 2000;                     // Time in ms to stay on a scan window after squelch activity
+    unsigned             pool_size = 0;                        // Number of down samplers in the channel pool. 0 if not used
+    float                pool_level = 6.0f;                    // Detector level in dB for assigning a down sampler
+    unsigned             pool_hang = 2000;                     // Time in ms to keep a down sampler after activity
+    std::string          ctl_socket;                           // Path to control socket. Empty if not used
+    unsigned             max_channels = 32;                    // Max number of channels when the control socket is used
+    bool                 bench = false;                        // Run the pipeline offline as fast as possible and report the speed
+    std::string          bench_file;                           // Raw 8 bit IQ file for the benchmark. Synthetic IQ if empty
+    unsigned             bench_time = 10;                      // Seconds of signal to run through the pipeline when benchmarking
+    bool                 timing = false;                       // Record latency histograms for the stages of the receiver
+    int                  metrics_port = 0;                     // TCP port for the metrics endpoint. 0 if not used
+    std::string          trace_file;                           // Chrome trace JSON for the flow of blocks. Empty if not tracing
+    bool                 perf = false;                         // Count hardware events for the stages of the receiver
+    bool                 deterministic = false;                // Bit exact benchmark with digests of the output
+    bool                 low_memory = false;                   // Smaller memory footprint at some CPU cost
+};
+
+
+// Runtime control command. Created by the control server in the main thread
+// and applied by the input thread at a block boundary. The input thread then
+// forwards it to the output thread that applies it when the first block with
+// the new channel layout is played. Finally the command is handed back to the
+// main thread that deletes it. Channels are moved in and out of the commands
+// so nothing is allocated or freed in the input or output threads.
+//
+// A retune (RETUNE) is posted before the tuner frequency is changed. The input
+// thread mutes all blocks until the main thread marks the command as ready
+// and then swaps in the new translators at the next block boundary. Blocks
+// already in the USB transfers still hold IQ data of the old frequency so
+// another SCAN_SETTLE_BLOCKS blocks are muted after the swap, like after a
+// scan window change.
+struct ChannelCmd {
+    enum class Type { ADD, REMOVE, SQL, MOD, PAN, RETUNE };
+
+    ChannelCmd(Type type, const std::string &name = "") : type(type), name(name) {}
+
+    Type              type;
+    std::string       name;                 // Channel the command applies to
+    float             sql_level = 0.0f;     // New squelch level (SQL)
+    Modulation        mod = Modulation::AM; // New modulation (MOD)
+    int               pos = 0;              // New audio position (PAN)
+    uint32_t          tuner_fq = 0;         // New tuner frequency (RETUNE)
+    std::vector<MSD>  msds;                 // New translators, one per channel in channel order (RETUNE)
+    std::atomic<bool> ready = false;        // Tuner frequency has been changed (RETUNE)
+    bool              tuned = false;        // Tuner frequency change was successful (RETUNE)
+    uint64_t          seq = 0;              // First block with the command applied. Set by the input thread
+    Channel           in_ch;                // Channel to add/removed channel for the input thread
+    Channel           out_ch;               // Channel to add/removed channel for the output thread
+};
+
+// Convenient type for the command queues
+using cmd_rb_t = RB<ChannelCmd*>;
+
+
+// Scan state shared between the event loop and the input and output threads.
+// The output thread reports the current window as idle, and triggers the
+// scan event, when the squelch activity has ended. The event loop then
+// selects the next window and changes the tuner frequency. The input thread
+// discards all blocks until the tuner is set and another SCAN_SETTLE_BLOCKS
+// blocks while the tuner settles. Every window keeps its own channels, with
+// down samplers, AGCs and squelch state, so nothing is rebuilt when the
+// window changes.
+struct ScanState {
+    std::vector<uint32_t>   fqs;                    // Tuner frequency for each window
+    R820Dev                *device_ptr = nullptr;
+    std::atomic<unsigned>   next = 0;               // Window the tuner is set to, or is about to be set to
+    std::atomic<bool>       tuned = true;           // Tuner is set to the next window
+    std::atomic<int>        idle = -1;              // Window reported idle by the output thread. -1 if none
+    int                     event = -1;             // Event loop event that moves the tuner to the next window
+};
+
+
+// Channel pool. The configured channels are candidates watched by a cheap
+// wideband detector. A down sampler from the pool is assigned to a candidate
+// when the energy in the channel rises above the detector level and released
+// when the energy has been below the level for the hang time. The candidate
+// translators are swapped in and out of the pool down samplers so nothing is
+// allocated in the input thread. Everything except candidates is owned by
+// the input thread
+struct PoolState {
+    PoolState(unsigned detector_size) : detector(detector_size) {}
+
+    Detector                           detector;
+    std::vector<Channel>               candidates;  // Channels watched. Read only once started
+    std::vector<MSD>                   tuners;      // Translator for each candidate. In a pool down sampler while assigned
+    std::vector<int>                   bins;        // Detector bin for each candidate
+    std::vector<int>                   slots;       // Pool down sampler for each candidate. -1 if not assigned
+    std::vector<unsigned>              quiet;       // Blocks since each candidate was active
+    std::vector<unsigned>              order;       // Candidates in priority order
+    std::array<int16_t, MAX_POOL_SIZE> owners;      // Candidate for each pool down sampler. -1 if not in use
+    int                                half_width;  // Detector bins on each side of a candidate
+    unsigned                           hang_blocks;
+    float                              level;       // Detector level in dB
+};
+
+
+// Time spent in each stage of the pipeline when benchmarking
+struct BenchStats {
+    enum Stage { SOURCE, DETECTOR, CHANNELIZE, DEMOD, AUDIO_FILTER, NUM_STAGES };
+
+    using Clock = std::chrono::steady_clock;
+
+    std::array<double, NUM_STAGES> time{}; // Seconds in each stage
+
+    // Add the time since ts to a stage and restart ts. Does nothing if not
+    // benchmarking
+    static void mark(BenchStats *bench_ptr, Stage stage, Clock::time_point &ts) {
+        if (!bench_ptr) return;
+
+        Clock::time_point now = Clock::now();
+        bench_ptr->time[stage] += std::chrono::duration<double>(now - ts).count();
+        ts = now;
+    }
+
+    static Clock::time_point start(BenchStats *bench_ptr) {
+        return bench_ptr ? Clock::now() : Clock::time_point();
+    }
+};
+
+
+// Latency histograms for the stages of the receiver. Each histogram is
+// recorded by one thread at a time and can be read at any time
+struct TimingState {
+    TimingState(unsigned ch_capacity) : channels(ch_capacity) {}
+
+    LatencyHist              input;     // Device callback (data_cb)
+    std::vector<LatencyHist> channels;  // Down sampling of each channel, by index in the channel list
+    LatencyHist              output;    // Squelch, demodulation, mixing and audio filter in alsa_write_cb
+    LatencyHist              alsa;      // ALSA write
+
+    // End to end latency of every played block, from the device callback
+    // to the speaker, and the parts of it. Recorded by the output thread
+    struct {
+        LatencyHist input;              // Device callback to ring buffer
+        LatencyHist queue;              // Waiting in the ring buffer
+        LatencyHist output;             // Output processing and ALSA write
+        LatencyHist device;             // Sound card buffer
+        LatencyHist total;
+    } e2e;
+};
+
+
+// Histogram for the channel with index idx. Null if timing is not enabled
+static LatencyHist *channel_hist(TimingState *timing_ptr, size_t idx) {
+    return timing_ptr && idx < timing_ptr->channels.size() ? &timing_ptr->channels[idx] : nullptr;
+}
+
+
+// Hardware event counts for the same stages as TimingState
+struct PerfState {
+    PerfState(unsigned ch_capacity) : channels(ch_capacity) {}
+
+    PerfStage              input;       // Device callback (data_cb)
+    std::vector<PerfStage> channels;    // Down sampling of each channel, by index in the channel list
+    PerfStage              output;      // Squelch, demodulation, mixing and audio filter in alsa_write_cb
+    PerfStage              alsa;        // ALSA write
+};
+
+
+// Counts for the channel with index idx. Null if not enabled
+static PerfStage *channel_perf(PerfState *perf_ptr, size_t idx) {
+    return perf_ptr && idx < perf_ptr->channels.size() ? &perf_ptr->channels[idx] : nullptr;
+}
+
+
+// Time in ns spent on each channel, by index in the channel list like the
+// latency histograms. The down sampling time is added by the thread that
+// down samples the channel and the output processing time by the output
+// thread. Read at any time without locks
+struct CostState {
+    struct ChannelCost {
+        std::atomic<uint64_t> ds_ns = 0;        // Down sampling
+        std::atomic<uint64_t> out_ns = 0;       // AGC, demodulation, mixing and squelch
+    };
+
+    CostState(unsigned ch_capacity) : channels(ch_capacity) {}
+
+    std::vector<ChannelCost> channels;
+};
+
+
+// Down sampling time counter for the channel with index idx. Null if not
+// enabled
+static std::atomic<uint64_t> *channel_ds_cost(CostState *cost_ptr, size_t idx) {
+    return cost_ptr && idx < cost_ptr->channels.size() ? &cost_ptr->channels[idx].ds_ns : nullptr;
+}
+
+
+// FNV-1a digests of what the receiver produces, for comparing two runs bit
+// for bit. Per channel, by index in the channel list, and for the audio
+struct DigestState {
+    static constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+    static constexpr uint64_t FNV_PRIME  = 1099511628211ull;
+
+    DigestState(unsigned num_channels) : iq(num_channels, FNV_OFFSET), sql(num_channels, FNV_OFFSET) {}
+
+    std::vector<uint64_t> iq;                   // Down sampled IQ
+    std::vector<uint64_t> sql;                  // SNR and squelch state of every block
+    uint64_t              audio = FNV_OFFSET;   // Audio samples sent to the sound card
+
+    static void add(uint64_t &digest, const void *data, size_t len) {
+        const uint8_t *bytes = reinterpret_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < len; ++i) digest = (digest ^ bytes[i]) * FNV_PRIME;
+    }
+};
+
+
+// Counters and gauges for the metrics endpoint. Every value is written by
+// one thread and read, without locks, when the endpoint is scraped. The
+// channel slots are indexed like the channel list and restart from zero when
+// another channel takes over a slot
+struct MetricsState {
+    struct ChannelSlot {
+        MetricsLabel          name;                // Channel name. Empty if the slot is not used
+        std::atomic<uint64_t> blocks = 0;          // Blocks processed
+        std::atomic<uint64_t> sql_open = 0;        // Blocks with open squelch
+        std::atomic<float>    snr = 0.0f;          // SNR in dB of the last block
+        std::atomic<float>    agc_gain = 0.0f;     // IQ AGC gain of the last block
+        std::atomic<uint64_t> ds_base = 0;         // Down sampling time of the slot when the channel took it over
+        std::atomic<uint64_t> out_base = 0;        // Output processing time of the slot when the channel took it over
+    };
+
+    MetricsState(unsigned ch_capacity, unsigned rb_size) : rb_size(rb_size), channels(ch_capacity) {}
+
+    const unsigned         rb_size;                // Number of chunks in the ring buffer
+    std::atomic<uint64_t>  blocks_in = 0;          // Blocks written to the ring buffer
+    std::atomic<uint64_t>  blocks_out = 0;         // Blocks read from the ring buffer
+    std::atomic<uint64_t>  overruns = 0;           // Blocks skipped since the ring buffer was full
+    std::atomic<uint64_t>  underruns = 0;          // Blocks of silence played since the ring buffer was empty
+    std::atomic<uint64_t>  dropped = 0;            // Samples dropped by the device
+    std::atomic<uint64_t>  alsa_errors = 0;        // Failed ALSA calls
+    std::atomic<uint64_t>  input_cpu = 0;          // CPU time in ns for data_cb, not counting down sampling
+    std::atomic<uint64_t>  downsample_cpu = 0;     // CPU time in ns for down sampling, in any thread
+    std::atomic<uint64_t>  output_cpu = 0;         // CPU time in ns for alsa_write_cb, not counting ALSA write
+    std::atomic<uint64_t>  alsa_cpu = 0;           // CPU time in ns for ALSA write
+    std::atomic<unsigned>  num_channels = 0;       // Channels in the last played block
+    std::vector<ChannelSlot> channels;
+};
+
+
+// Add to a counter that only the calling thread writes to
+static inline void metrics_add(std::atomic<uint64_t> &counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+
+// Telemetry for the status display. Written by the output thread for every
+// block and read, without locks, by the status thread that formats and
+// prints it. The channel slots are indexed like the channel list
+struct StatusState {
+    struct ChannelSlot {
+        MetricsLabel          name;                // Channel name
+        std::atomic<uint64_t> block = 0;           // Last block with the channel in it
+        std::atomic<bool>     open = false;        // Squelch open
+        std::atomic<float>    snr = 0.0f;          // SNR in dB
+        std::atomic<float>    ref_lo = 0.0f;       // Reference level below the signal
+        std::atomic<float>    sig = 0.0f;          // Signal level
+        std::atomic<float>    ref_hi = 0.0f;       // Reference level above the signal
+        std::atomic<float>    agc_gain = 0.0f;     // IQ AGC gain
+        std::atomic<float>    lf_gain = 0.0f;      // Audio AGC gain
+    };
+
+    StatusState(unsigned ch_capacity) : channels(ch_capacity) {}
+
+    std::atomic<uint64_t>  blocks = 0;             // Blocks played. Stored after the channel slots
+    std::atomic<float>     pwr_dbfs = 0.0f;        // Level of the last block
+    std::atomic<int>       window = -1;            // Scan window of the last block
+    std::atomic<unsigned>  num_active = 0;         // Channels in the last block
+    std::atomic<unsigned>  num_channels = 0;       // Channels in the channel list
+    std::atomic<float>     imbalance = 0.0f;       // Spectral imbalance over the last 10 blocks. Only with one channel
+    std::vector<ChannelSlot> channels;
+
+    // Used by main and the status thread
+    Settings::StatusMode   mode = Settings::StatusMode::ALL;
+    bool                   verbose = false;
+    bool                   compact = false;
+    bool                   pool = false;           // Channel pool in use
+    std::vector<uint32_t>  scan_fqs;               // Tuner frequency for each scan window. Empty if not scanning
+    const CostState       *cost_ptr = nullptr;     // Time per channel. Null if not enabled
+    std::mutex             mutex;
+    std::condition_variable condition;
+    bool                   run = true;             // Cleared, under the mutex, to stop the status thread
+    std::atomic<bool>      waiting = false;        // Status thread waits for a block. Set under the mutex
 };
 
 
 struct InputState {
     rb_t                 *rb_ptr;                  // Input -> Output buffer
+    cmd_rb_t             *cmd_in_ptr = nullptr;    // Control -> Input commands
+    cmd_rb_t             *cmd_out_ptr = nullptr;   // Input -> Output commands
+    ScanState            *scan_ptr = nullptr;      // Scan state. Null if not scanning
+    PoolState            *pool_ptr = nullptr;      // Channel pool. Null if not used
+    BenchStats           *bench_ptr = nullptr;     // Stage timing. Null if not benchmarking
+    TimingState          *timing_ptr = nullptr;    // Latency histograms. Null if not enabled
+    MetricsState         *metrics_ptr = nullptr;   // Metrics endpoint counters. Null if not enabled
+    Tracer               *trace_ptr = nullptr;     // Block trace. Null if not enabled
+    PerfState            *perf_ptr = nullptr;      // Hardware event counts. Null if not enabled
+    CostState            *cost_ptr = nullptr;      // Time per channel. Null if not enabled
+    Log::Queue           *log_ptr = nullptr;       // Console output
+    uint64_t              dropped = 0;             // Samples dropped by the device at the last warning
+    unsigned              window = 0;              // Current scan window
+    unsigned              settle = 0;              // Blocks left to discard after a window change or a retune
+    uint64_t              seq = 0;                 // Sequence number for next block
     R820Dev::StreamState  stream_state = R820Dev::StreamState::IDLE;
     Settings              settings;                // System wide settings
 };
@@ -265,30 +575,445 @@ struct InputState {
 struct OutputState {
     snd_pcm_t         *pcm_handle;               // ALSA PCM device
     rb_t              *rb_ptr;                   // Input -> Output buffer
+    cmd_rb_t          *cmd_out_ptr = nullptr;    // Input -> Output commands
+    cmd_rb_t          *cmd_ret_ptr = nullptr;    // Output -> Control commands (for deletion)
+    int                ret_event = -1;           // Event loop event that reclaims the commands handed back
+    int                stop_fd = -1;             // Eventfd that stops the output thread when signaled
     int16_t            silence[CH_IQ_BUF_SIZE*2];            // Stereo
     float              audio_buffer_float[CH_IQ_BUF_SIZE*2]; // Stereo
     int16_t            audio_buffer_s16[CH_IQ_BUF_SIZE*2];   // Stereo
     FIR2              *audio_filter;
-    iqsample_t         fft_in[FFT_SIZE];
-    iqsample_t         fft_out[FFT_SIZE];
-    float              window[FFT_SIZE+1];
-    fftwf_plan         fft_plan;
-    unsigned           sql_wait;
+    SqlMeter           sql_meter;                // Squelch FFT
     std::vector<float> hi_energy;
     std::vector<float> lo_energy;
     unsigned           energy_idx;
+    ScanState         *scan_ptr = nullptr;       // Scan state. Null if not scanning
+    int                scan_window = -1;         // Scan window of the last played block
+    unsigned           scan_blocks = 0;          // Blocks played from the scan window
+    unsigned           scan_quiet = 0;           // Blocks since the last squelch activity in the scan window
+    bool               scan_active = false;      // Squelch activity in the scan window
+    const PoolState   *pool_ptr = nullptr;       // Channel pool. Null if not used
+    std::array<int16_t, MAX_POOL_SIZE> pool_owners; // Candidate last played by each pool down sampler
+    BenchStats        *bench_ptr = nullptr;      // Stage timing. Null if not benchmarking
+    TimingState       *timing_ptr = nullptr;     // Latency histograms. Null if not enabled
+    MetricsState      *metrics_ptr = nullptr;    // Metrics endpoint counters. Null if not enabled
+    Tracer            *trace_ptr = nullptr;      // Block trace. Null if not enabled
+    PerfState         *perf_ptr = nullptr;       // Hardware event counts. Null if not enabled
+    CostState         *cost_ptr = nullptr;       // Time per channel. Null if not enabled
+    DigestState       *digest_ptr = nullptr;     // Digests of the output. Null if not deterministic
+    Log::Queue        *log_ptr = nullptr;        // Console output
+    StatusState       *status_ptr = nullptr;     // Status display telemetry. Null if benchmarking
     bool               samples_received;
     bool               running;
     Settings           settings;
 };
 
 
-static void signal_handler(int signo) {
-    std::cout << "Signal '" << strsignal(signo) << "' received. Stopping...\n";
-    std::unique_lock<std::mutex> lock(stop_mutex);
-    run = false;
-    lock.unlock();
-    stop_condition.notify_one();
+// Channel names by index in the channel list, for labeling the reports
+static std::vector<std::string> channel_names(const std::vector<Channel> &channels) {
+    std::vector<std::string> names;
+
+    for (auto &ch : channels) names.push_back(ch.name);
+
+    return names;
+}
+
+
+// Channel names by index as last played by the output thread. Unlike the
+// channel list in main, they follow runtime control and the channel pool.
+// Indexes not played yet have an empty name
+static std::vector<std::string> channel_names(const StatusState &status) {
+    std::vector<std::string> names;
+
+    for (auto &slot : status.channels) names.push_back(slot.name.get());
+
+    return names;
+}
+
+
+// Latency report with percentiles for every stage and the number of blocks
+// over the 32ms budget. Channel histograms are labeled with the channel names
+// by index. Only channels with recorded blocks are included
+static std::string timing_report(const TimingState &timing, const std::vector<std::string> &names) {
+    std::ostringstream report;
+    char               line[128];
+
+    auto add = [&report, &line](const std::string &name, const LatencyHist &hist) {
+        snprintf(line, sizeof(line), "    %-22s %8" PRIu64 " %9.1f %9.1f %9.1f %9.1f %6" PRIu64 "\n",
+                 name.c_str(), hist.count(), hist.percentile(50) / 1e3, hist.percentile(99) / 1e3,
+                 hist.percentile(99.9) / 1e3, hist.max() / 1e3, hist.countAbove(BLOCK_TIME_NS));
+        report << line;
+    };
+
+    report << "Latency in us. Budget is " << BLOCK_TIME_NS / 1000 << " us per block:\n";
+    snprintf(line, sizeof(line), "    %-22s %8s %9s %9s %9s %9s %6s\n", "Stage", "Blocks", "p50", "p99", "p99.9", "Max", "Over");
+    report << line;
+
+    add("Device callback", timing.input);
+    for (unsigned idx = 0; idx < timing.channels.size(); ++idx) {
+        if (timing.channels[idx].count() == 0) continue;
+
+        if (idx < names.size() && !names[idx].empty()) add("  Channel " + names[idx], timing.channels[idx]);
+        else                                           add("  Channel #" + std::to_string(idx), timing.channels[idx]);
+    }
+    add("Output processing", timing.output);
+    add("ALSA write", timing.alsa);
+
+    if (timing.e2e.total.count() == 0) return report.str();
+
+    auto add_ms = [&report, &line](const char *name, const LatencyHist &hist) {
+        snprintf(line, sizeof(line), "    %-22s %8" PRIu64 " %9.1f %9.1f %9.1f %9.1f\n",
+                 name, hist.count(), hist.percentile(50) / 1e6, hist.percentile(99) / 1e6,
+                 hist.percentile(99.9) / 1e6, hist.max() / 1e6);
+        report << line;
+    };
+
+    report << "End to end latency in ms, from the device callback to the speaker:\n";
+    snprintf(line, sizeof(line), "    %-22s %8s %9s %9s %9s %9s\n", "Part", "Blocks", "p50", "p99", "p99.9", "Max");
+    report << line;
+
+    add_ms("Device to ring buffer", timing.e2e.input);
+    add_ms("Ring buffer", timing.e2e.queue);
+    add_ms("Output and ALSA write", timing.e2e.output);
+    add_ms("Sound card buffer", timing.e2e.device);
+    add_ms("Total", timing.e2e.total);
+
+    return report.str();
+}
+
+
+// Hardware event counts per block for every stage together with the thread
+// that ran it. A low IPC together with many cache misses points to a stage
+// that waits for memory rather than computes. Only channels with recorded
+// blocks are included
+static std::string perf_report(const PerfState &perf, const std::vector<std::string> &names) {
+    std::ostringstream report;
+    char               line[160];
+
+    // Events the host does not support are shown as -
+    auto per_kilo = [](const PerfStage &stage, unsigned event, char *buf, size_t len) {
+        uint64_t instructions = stage.count(PerfCounters::INSTRUCTIONS);
+        if (!PerfCounters::supported(event) || instructions == 0) snprintf(buf, len, "-");
+        else                                                       snprintf(buf, len, "%.2f", 1000.0 * stage.count(event) / instructions);
+        return buf;
+    };
+
+    auto add = [&report, &line, &per_kilo](const std::string &name, const PerfStage &stage) {
+        char     ipc[16], cache[16], branch[16];
+        uint64_t blocks = std::max<uint64_t>(stage.blocks(), 1);
+        uint64_t cycles = stage.count(PerfCounters::CYCLES);
+
+        if (!PerfCounters::supported(PerfCounters::INSTRUCTIONS) || cycles == 0) snprintf(ipc, sizeof(ipc), "-");
+        else snprintf(ipc, sizeof(ipc), "%.2f", (double)stage.count(PerfCounters::INSTRUCTIONS) / cycles);
+
+        snprintf(line, sizeof(line), "    %-22s %-13s %8" PRIu64 " %9.3f %6s %11s %11s\n",
+                 name.c_str(), stage.thread(), stage.blocks(), cycles / 1e6 / blocks, ipc,
+                 per_kilo(stage, PerfCounters::CACHE_MISSES, cache, sizeof(cache)),
+                 per_kilo(stage, PerfCounters::BRANCH_MISSES, branch, sizeof(branch)));
+        report << line;
+    };
+
+    report << "Hardware counters per block, user space only. Misses per 1000 instructions:\n";
+    snprintf(line, sizeof(line), "    %-22s %-13s %8s %9s %6s %11s %11s\n", "Stage", "Thread", "Blocks", "Mcycles", "IPC", "Cache miss", "Branch miss");
+    report << line;
+
+    add("Device callback", perf.input);
+    for (unsigned idx = 0; idx < perf.channels.size(); ++idx) {
+        if (perf.channels[idx].blocks() == 0) continue;
+
+        if (idx < names.size() && !names[idx].empty()) add("  Channel " + names[idx], perf.channels[idx]);
+        else                                           add("  Channel #" + std::to_string(idx), perf.channels[idx]);
+    }
+    add("Output processing", perf.output);
+    add("ALSA write", perf.alsa);
+
+    if (PerfCounters::multiplexed()) {
+        report << "The counters were shared with other perf users. The counts are scaled estimates.\n";
+    }
+
+    return report.str();
+}
+
+
+// Write the trace file. A failure is reported but does not stop the receiver
+static void write_trace(const Tracer &trace, const std::string &path) {
+    bool ok = trace.write(path);
+
+    while (cout_lock.test_and_set(std::memory_order_acquire));
+    if (ok) std::cout << "Trace written to " << path << ".\n" << std::flush;
+    else    std::cerr << "Error: Unable to write trace file " << path << ".\n";
+    cout_lock.clear();
+}
+
+
+// Metrics in the Prometheus text exposition format. Only reads counters so
+// it can be called from any thread
+static std::string metrics_report(const MetricsState &metrics, const TimingState *timing_ptr, const CostState *cost_ptr) {
+    std::ostringstream report;
+    char               line[256];
+
+    auto header = [&report](const char *name, const char *type, const char *help) {
+        report << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+    };
+
+    auto add_int = [&report, &line](const char *name, const std::string &labels, uint64_t value) {
+        snprintf(line, sizeof(line), "%s%s %" PRIu64 "\n", name, labels.c_str(), value);
+        report << line;
+    };
+
+    // Prometheus spells the special values differently than printf
+    auto add_float = [&report, &line](const char *name, const std::string &labels, double value) {
+        if (std::isnan(value))      snprintf(line, sizeof(line), "%s%s NaN\n", name, labels.c_str());
+        else if (std::isinf(value)) snprintf(line, sizeof(line), "%s%s %sInf\n", name, labels.c_str(), value > 0 ? "+" : "-");
+        else                        snprintf(line, sizeof(line), "%s%s %.6g\n", name, labels.c_str(), value);
+        report << line;
+    };
+
+    auto label = [](const char *key, const std::string &value) {
+        std::string escaped;
+        for (char c : value) {
+            if (c == '\\' || c == '"') escaped += '\\';
+            if (c == '\n') escaped += "\\n";
+            else           escaped += c;
+        }
+        return std::string("{") + key + "=\"" + escaped + "\"}";
+    };
+
+    auto load = [](const std::atomic<uint64_t> &value) { return value.load(std::memory_order_relaxed); };
+
+    header("sdrx_blocks_total", "counter", "Blocks of IQ samples from the device written to the ring buffer");
+    add_int("sdrx_blocks_total", "", load(metrics.blocks_in));
+
+    header("sdrx_blocks_played_total", "counter", "Blocks read from the ring buffer and played");
+    add_int("sdrx_blocks_played_total", "", load(metrics.blocks_out));
+
+    header("sdrx_ring_overruns_total", "counter", "Blocks skipped since the ring buffer was full");
+    add_int("sdrx_ring_overruns_total", "", load(metrics.overruns));
+
+    header("sdrx_ring_underruns_total", "counter", "Blocks of silence played since the ring buffer was empty");
+    add_int("sdrx_ring_underruns_total", "", load(metrics.underruns));
+
+    // Played is read first so that the fill level never goes negative
+    uint64_t blocks_out = load(metrics.blocks_out);
+    uint64_t blocks_in  = load(metrics.blocks_in);
+    header("sdrx_ring_fill_blocks", "gauge", "Blocks waiting in the ring buffer");
+    add_int("sdrx_ring_fill_blocks", "", blocks_in - blocks_out);
+
+    header("sdrx_ring_size_blocks", "gauge", "Size of the ring buffer in blocks");
+    add_int("sdrx_ring_size_blocks", "", metrics.rb_size);
+
+    header("sdrx_device_dropped_samples_total", "counter", "Samples dropped by the device");
+    add_int("sdrx_device_dropped_samples_total", "", load(metrics.dropped));
+
+    header("sdrx_alsa_errors_total", "counter", "Failed ALSA calls");
+    add_int("sdrx_alsa_errors_total", "", load(metrics.alsa_errors));
+
+    header("sdrx_stage_cpu_seconds_total", "counter", "CPU time spent in each stage of the receiver");
+    add_float("sdrx_stage_cpu_seconds_total", label("stage", "input"), load(metrics.input_cpu) / 1e9);
+    add_float("sdrx_stage_cpu_seconds_total", label("stage", "downsample"), load(metrics.downsample_cpu) / 1e9);
+    add_float("sdrx_stage_cpu_seconds_total", label("stage", "output"), load(metrics.output_cpu) / 1e9);
+    add_float("sdrx_stage_cpu_seconds_total", label("stage", "alsa"), load(metrics.alsa_cpu) / 1e9);
+
+    // Channels in use and already played at least once
+    std::vector<std::string> names;
+    unsigned num_channels = std::min<size_t>(metrics.num_channels.load(std::memory_order_relaxed), metrics.channels.size());
+    for (unsigned idx = 0; idx < num_channels; ++idx) names.push_back(metrics.channels[idx].name.get());
+
+    header("sdrx_channel_blocks_total", "counter", "Blocks processed for the channel");
+    for (unsigned idx = 0; idx < num_channels; ++idx) {
+        if (!names[idx].empty()) add_int("sdrx_channel_blocks_total", label("channel", names[idx]), load(metrics.channels[idx].blocks));
+    }
+
+    header("sdrx_channel_squelch_open_seconds_total", "counter", "Time with the squelch open");
+    for (unsigned idx = 0; idx < num_channels; ++idx) {
+        if (!names[idx].empty()) {
+            add_float("sdrx_channel_squelch_open_seconds_total", label("channel", names[idx]),
+                  load(metrics.channels[idx].sql_open) * (BLOCK_TIME_NS / 1e9));
+        }
+    }
+
+    header("sdrx_channel_snr_db", "gauge", "SNR in dB of the last block");
+    for (unsigned idx = 0; idx < num_channels; ++idx) {
+        if (!names[idx].empty()) add_float("sdrx_channel_snr_db", label("channel", names[idx]), metrics.channels[idx].snr.load(std::memory_order_relaxed));
+    }
+
+    header("sdrx_channel_agc_gain", "gauge", "Gain of the IQ AGC in the last block");
+    for (unsigned idx = 0; idx < num_channels; ++idx) {
+        if (!names[idx].empty()) add_float("sdrx_channel_agc_gain", label("channel", names[idx]), metrics.channels[idx].agc_gain.load(std::memory_order_relaxed));
+    }
+
+    if (cost_ptr) {
+        header("sdrx_channel_cpu_seconds_total", "counter", "Time spent on the channel in each stage of the receiver");
+        for (unsigned idx = 0; idx < num_channels && idx < cost_ptr->channels.size(); ++idx) {
+            if (names[idx].empty()) continue;
+
+            const MetricsState::ChannelSlot &slot = metrics.channels[idx];
+            const CostState::ChannelCost    &cost = cost_ptr->channels[idx];
+            std::string                      channel = label("channel", names[idx]);
+
+            // Both stages in one label set
+            channel.pop_back();
+            add_float("sdrx_channel_cpu_seconds_total", channel + ",stage=\"downsample\"}", (load(cost.ds_ns) - load(slot.ds_base)) / 1e9);
+            add_float("sdrx_channel_cpu_seconds_total", channel + ",stage=\"output\"}", (load(cost.out_ns) - load(slot.out_base)) / 1e9);
+        }
+    }
+
+    // End to end latency, if timing is enabled, as a summary per part
+    if (timing_ptr) {
+        const std::pair<const char*, const LatencyHist*> parts[] = {
+            { "input", &timing_ptr->e2e.input }, { "queue", &timing_ptr->e2e.queue }, { "output", &timing_ptr->e2e.output },
+            { "device", &timing_ptr->e2e.device }, { "total", &timing_ptr->e2e.total }
+        };
+
+        header("sdrx_latency_seconds", "summary", "End to end latency of the played blocks, from the device callback to the speaker");
+        for (auto &[part, hist] : parts) {
+            for (double q : { 0.5, 0.99, 0.999 }) {
+                snprintf(line, sizeof(line), "{part=\"%s\",quantile=\"%g\"}", part, q);
+                add_float("sdrx_latency_seconds", line, hist->percentile(q * 100) / 1e9);
+            }
+            add_float("sdrx_latency_seconds_sum", std::string("{part=\"") + part + "\"}", hist->sum() / 1e9);
+            add_int("sdrx_latency_seconds_count", std::string("{part=\"") + part + "\"}", hist->count());
+        }
+    }
+
+    return report.str();
+}
+
+
+// Swap the translator of a channel with the one in msd
+static void retune_channel(Channel &ch, MSD &msd) {
+    if (ch.ds_ptr) ch.ds_ptr->retune(msd);
+    else           ch.msd.retune(msd);
+}
+
+
+// Apply runtime control commands to the channel layout of the input thread.
+// Called at a block boundary. Every applied command is forwarded to the
+// output thread tagged with the sequence number of the block it applies to.
+// Returns true if the block is transitional due to a retune
+static bool apply_input_cmds(InputState &ctx) {
+    std::vector<Channel> &channels = ctx.settings.channels;
+    ChannelCmd * const   *cmds;
+    ChannelCmd          **fwd_ptr;
+    size_t                num_cmds;
+    size_t                num_applied = 0;
+    bool                  transitional = false;
+
+    // The tuner is settling after a retune. Scanning, which uses the same
+    // counter, can not be combined with runtime control
+    if (ctx.settle > 0) {
+        --ctx.settle;
+        transitional = true;
+    }
+
+    if (!ctx.cmd_in_ptr->acquireRead(&cmds, &num_cmds)) return transitional;
+
+    while (num_applied < num_cmds) {
+        ChannelCmd *cmd = cmds[num_applied];
+
+        // Wait for the tuner to change frequency. Until then the IQ data is
+        // a mix of old and new frequency
+        if (cmd->type == ChannelCmd::Type::RETUNE && !cmd->ready.load(std::memory_order_acquire)) {
+            transitional = true;
+            break;
+        }
+
+        // A command is only applied if it can be forwarded
+        if (!ctx.cmd_out_ptr->acquireWrite(&fwd_ptr, 1)) break;
+
+        if (cmd->type == ChannelCmd::Type::ADD) {
+            channels.push_back(std::move(cmd->in_ch));
+            cmd->in_ch.ds_ptr = nullptr; // Now owned by the input channel list
+        } else if (cmd->type == ChannelCmd::Type::REMOVE) {
+            auto iter = std::find(channels.begin(), channels.end(), cmd->name.c_str());
+            if (iter != channels.end()) {
+                cmd->in_ch = std::move(*iter);
+                channels.erase(iter);
+            }
+        } else if (cmd->type == ChannelCmd::Type::RETUNE) {
+            if (cmd->tuned && cmd->msds.size() == channels.size()) {
+                for (unsigned i = 0; i < channels.size(); ++i) retune_channel(channels[i], cmd->msds[i]);
+                ctx.settings.tuner_fq = cmd->tuner_fq;
+            }
+            ctx.settle = SCAN_SETTLE_BLOCKS;
+            transitional = true;
+        }
+
+        cmd->seq = ctx.seq;
+        *fwd_ptr = cmd;
+        ctx.cmd_out_ptr->commitWrite(1);
+        ++num_applied;
+    }
+
+    ctx.cmd_in_ptr->commitRead(num_applied);
+
+    return transitional;
+}
+
+
+// Follow the tuner to the window the event loop has selected. Called at a
+// block boundary.
+// Returns false if the block is to be discarded since the tuner is changing
+// frequency or settling
+static bool follow_scan(InputState &ctx) {
+    ScanState &scan = *ctx.scan_ptr;
+
+    unsigned next = scan.next.load(std::memory_order_acquire);
+    if (next != ctx.window) {
+        if (!scan.tuned.load(std::memory_order_acquire)) return false;
+
+        ctx.window = next;
+        ctx.settings.tuner_fq = scan.fqs[next];
+        ctx.settle = SCAN_SETTLE_BLOCKS;
+    }
+
+    if (ctx.settle > 0) {
+        --ctx.settle;
+        return false;
+    }
+
+    return true;
+}
+
+
+// Run the detector on a block and assign and release pool down samplers.
+// Called at a block boundary
+static void update_pool(InputState &ctx, const iqsample_t *data, unsigned data_len) {
+    PoolState            &pool = *ctx.pool_ptr;
+    std::vector<Channel> &channels = ctx.settings.channels;
+
+    pool.detector.process(data, data_len);
+
+    // Release first so that the down samplers can be assigned again in the
+    // same block
+    for (unsigned c = 0; c < pool.candidates.size(); ++c) {
+        if (pool.detector.level(pool.bins[c], pool.half_width) > pool.level) {
+            pool.quiet[c] = 0;
+        } else if (pool.quiet[c] < UINT_MAX) {
+            ++pool.quiet[c];
+        }
+
+        int slot = pool.slots[c];
+        if (slot >= 0 && pool.quiet[c] > pool.hang_blocks) {
+            retune_channel(channels[slot], pool.tuners[c]); // Give back the translator
+            pool.owners[slot] = -1;
+            pool.slots[c] = -1;
+        }
+    }
+
+    // Assign down samplers to active candidates, highest priority first. If
+    // the pool is exhausted the candidate has to wait
+    unsigned free_slot = 0;
+    for (unsigned c : pool.order) {
+        if (pool.slots[c] >= 0 || pool.quiet[c] > 0) continue;
+
+        while (free_slot < channels.size() && pool.owners[free_slot] >= 0) ++free_slot;
+        if (free_slot == channels.size()) break;
+
+        retune_channel(channels[free_slot], pool.tuners[c]);
+        pool.owners[free_slot] = c;
+        pool.slots[c] = free_slot;
+    }
 }
 
 
@@ -300,39 +1025,142 @@ static void data_cb(const iqsample_t *data, unsigned data_len, void *user_data,
     struct Metadata      *metadata_ptr = nullptr;
     struct Metadata       meta;
 
+    static Log::Limit commit_limit;
+    static Log::Limit overrun_limit;
+    static Log::Limit dropped_limit;
+
     if (block_info.stream_state == R820Dev::StreamState::IDLE) {
         ctx.rb_ptr->setStreaming(false);
-        std::cerr << "Info: Device stopped streaming.\n";
+        ctx.log_ptr->print(Log::Stream::ERR, nullptr, "Info: Device stopped streaming.");
         return;
     }
 
+    if (block_info.dropped > ctx.dropped) {
+        ctx.log_ptr->print(Log::Stream::ERR, &dropped_limit, "Warning: %" PRIu64 " samples dropped. Your system is probably overloaded.",
+                           block_info.dropped - ctx.dropped);
+        ctx.dropped = block_info.dropped;
+    }
+
+    uint64_t timing_start = ctx.timing_ptr || ctx.trace_ptr ? LatencyHist::now() : 0;
+    uint64_t cpu_start = ctx.metrics_ptr ? thread_cpu_time() : 0;
+    uint64_t ds_cpu = 0;    // Down sampling CPU time in this thread
+
+    PerfCounters::Counts perf_start;
+    if (ctx.perf_ptr) PerfCounters::read(perf_start);
+
+    if (ctx.trace_ptr) ctx.trace_ptr->threadName("Input");
+
+    if (ctx.metrics_ptr) ctx.metrics_ptr->dropped.store(block_info.dropped, std::memory_order_relaxed);
+
     // Prepare chunk metadata
     meta.pwr_dbfs = block_info.pwr;
     meta.ts = block_info.ts;
+    meta.transitional = false;
+    meta.window = 0;
 
     // Acquire IQ ring buffer
     if (ctx.rb_ptr->acquireWrite(&iq_buf_ptr, &metadata_ptr)) {
+        // Change the channel layout, if requested, before this block is
+        // written
+        if (ctx.cmd_in_ptr) meta.transitional = apply_input_cmds(ctx);
+
+        // When scanning, only the channels in the current window are
+        // channelized. The other windows keep their state until the tuner
+        // comes back to them
+        if (ctx.scan_ptr) {
+            if (follow_scan(ctx)) {
+                meta.window = ctx.window;
+            } else {
+                meta.window = -1;
+                meta.transitional = true;
+            }
+        }
+
+        // With a channel pool, only the down samplers assigned to a
+        // candidate are run
+        if (ctx.pool_ptr) {
+            auto bench_ts = BenchStats::start(ctx.bench_ptr);
+            update_pool(ctx, data, data_len);
+            meta.pool = ctx.pool_ptr->owners;
+            BenchStats::mark(ctx.bench_ptr, BenchStats::DETECTOR, bench_ts);
+        }
+
+        meta.seq = ctx.seq++;
+        meta.num_channels = channels.size();
+
+        // Channels with data in this block
+        auto in_block = [&ctx, &meta, &channels](const Channel &ch) {
+            return (int)ch.window == meta.window && (!ctx.pool_ptr || meta.pool[&ch - &channels[0]] >= 0);
+        };
+
         // Channelize the IQ data and write output into ring buffer one
         // channel after the other
+        auto bench_ts = BenchStats::start(ctx.bench_ptr);
         if (ctx.settings.use_threaded_ds) {
-            std::latch latch(channels.size());
+            std::latch latch(std::count_if(channels.begin(), channels.end(), in_block));
             for (auto &ch : channels) {
-                ch.ds_ptr->addJob(data, data_len, iq_buf_ptr, latch);
+                if (in_block(ch)) {
+                    int                 ch_idx = &ch - &channels[0];
+                    DS::Instrumentation inst;
+
+                    inst.hist   = channel_hist(ctx.timing_ptr, ch_idx);
+                    inst.cpu_ns = ctx.metrics_ptr ? &ctx.metrics_ptr->downsample_cpu : nullptr;
+                    inst.trace  = ctx.trace_ptr;
+                    inst.seq    = meta.seq;
+                    inst.ch     = ch_idx;
+                    inst.perf   = channel_perf(ctx.perf_ptr, ch_idx);
+                    inst.ds_ns  = channel_ds_cost(ctx.cost_ptr, ch_idx);
+                    ch.ds_ptr->addJob(data, data_len, iq_buf_ptr, latch, inst);
+                }
                 iq_buf_ptr += CH_IQ_BUF_SIZE;
             }
             latch.wait();
         } else {
             for (auto &ch : channels) {
-                ch.msd.decimate(data, data_len, iq_buf_ptr);
+                if (in_block(ch)) {
+                    LatencyHist           *hist = channel_hist(ctx.timing_ptr, &ch - &channels[0]);
+                    PerfStage             *perf = channel_perf(ctx.perf_ptr, &ch - &channels[0]);
+                    std::atomic<uint64_t> *cost = channel_ds_cost(ctx.cost_ptr, &ch - &channels[0]);
+                    uint64_t               start = hist || cost || ctx.trace_ptr ? LatencyHist::now() : 0;
+                    uint64_t               ch_cpu_start = ctx.metrics_ptr ? thread_cpu_time() : 0;
+
+                    PerfCounters::Counts ch_perf_start, ch_perf_end;
+                    if (perf) PerfCounters::read(ch_perf_start);
+
+                    ch.msd.decimate(data, data_len, iq_buf_ptr);
+                    if (perf) {
+                        PerfCounters::read(ch_perf_end);
+                        perf->record(ch_perf_start, ch_perf_end, "Input");
+                    }
+                    if (hist || cost || ctx.trace_ptr) {
+                        uint64_t end = LatencyHist::now();
+                        if (hist) hist->record(end - start);
+                        if (cost) metrics_add(*cost, end - start);
+                        if (ctx.trace_ptr) ctx.trace_ptr->span("Channelize", start, end, meta.seq, &ch - &channels[0]);
+                    }
+                    if (ctx.metrics_ptr) ds_cpu += thread_cpu_time() - ch_cpu_start;
+                }
                 iq_buf_ptr += CH_IQ_BUF_SIZE;
             }
         }
+        BenchStats::mark(ctx.bench_ptr, BenchStats::CHANNELIZE, bench_ts);
 
         // Store IQ metadata in the chunk
+        if (ctx.timing_ptr) meta.commit_ts = std::chrono::system_clock::now();
         *metadata_ptr = meta;
 
         if (!ctx.rb_ptr->commitWrite()) {
-            std::cerr << "Error: Unable to commit ring buffer write." << std::endl;
+            ctx.log_ptr->print(Log::Stream::ERR, &commit_limit, "Error: Unable to commit ring buffer write.");
+        } else {
+            if (ctx.metrics_ptr) metrics_add(ctx.metrics_ptr->blocks_in, 1);
+
+            // The block waits in the ring buffer until the output thread
+            // reads it
+            if (ctx.trace_ptr) {
+                uint64_t now = LatencyHist::now();
+                ctx.trace_ptr->instant("Commit", now, meta.seq);
+                ctx.trace_ptr->asyncBegin("Ring buffer", now, meta.seq);
+            }
         }
 
         // Will only kick in for the first block of data
@@ -342,7 +1170,25 @@ static void data_cb(const iqsample_t *data, unsigned data_len, void *user_data,
         }
     } else {
         // Overrun
-        std::cerr << "Warning: Ring buffer full. Skipping 32ms block of samples." << std::endl;
+        ctx.log_ptr->print(Log::Stream::ERR, &overrun_limit, "Warning: Ring buffer full. Skipping 32ms block of samples.");
+        if (ctx.metrics_ptr) metrics_add(ctx.metrics_ptr->overruns, 1);
+        if (ctx.trace_ptr) ctx.trace_ptr->instant("Overrun", LatencyHist::now());
+    }
+
+    if (ctx.timing_ptr || ctx.trace_ptr) {
+        uint64_t now = LatencyHist::now();
+        if (ctx.timing_ptr) ctx.timing_ptr->input.record(now - timing_start);
+        if (ctx.trace_ptr) ctx.trace_ptr->span("Device callback", timing_start, now, metadata_ptr ? meta.seq : Tracer::NO_SEQ);
+    }
+    if (ctx.perf_ptr) {
+        PerfCounters::Counts perf_end;
+        PerfCounters::read(perf_end);
+        ctx.perf_ptr->input.record(perf_start, perf_end, "Input");
+    }
+    if (ctx.metrics_ptr) {
+        uint64_t cpu = thread_cpu_time() - cpu_start;
+        metrics_add(ctx.metrics_ptr->input_cpu, cpu - std::min(cpu, ds_cpu));
+        if (ds_cpu) ctx.metrics_ptr->downsample_cpu.fetch_add(ds_cpu, std::memory_order_relaxed);
     }
 }
 
@@ -399,264 +1245,464 @@ static void render_bargraph(float level, char *buf) {
 }
 
 
-// Called when the sound card wants another period, i.e. every 32 ms
-static void alsa_write_cb(OutputState &ctx) {
-    int                    ret;
-    const iqsample_t      *iq_buffer;
-    const struct Metadata *metadata_ptr = nullptr;
-    struct tm              tm;
-    char                   tmp_str[256];
-    char                   bar[75];
-    std::vector<Channel>  &channels = ctx.settings.channels;
-    bool                   verbose = ctx.settings.verbose_printout;
-    bool                   compact = ctx.settings.compact_printout;
+// Apply runtime control commands to the channel layout of the output thread.
+// Only commands tagged with a sequence number up to and including the one for
+// the block about to be played are applied. Applied commands are handed back
+// to the main thread
+static void apply_output_cmds(OutputState &ctx, uint64_t seq) {
+    std::vector<Channel> &channels = ctx.settings.channels;
+    ChannelCmd * const   *cmds;
+    ChannelCmd          **ret_ptr;
+    size_t                num_cmds;
+    size_t                num_applied = 0;
 
-    ret = snd_pcm_avail_update(ctx.pcm_handle);
-    if (ret < 0) {
-        std::cerr << "ALSA Error pcm_avail: " << snd_strerror(ret) << std::endl;
-        //snd_pcm_prepare(ctx.pcm_handle);
-        // What to do here? Restart device? Just return?
-    }
+    if (!ctx.cmd_out_ptr->acquireRead(&cmds, &num_cmds)) return;
 
-    ctx.running = true;
+    while (num_applied < num_cmds) {
+        ChannelCmd *cmd = cmds[num_applied];
 
-    if (ctx.rb_ptr->acquireRead(&iq_buffer, &metadata_ptr)) {
-        ctx.samples_received = true;
-        if (ctx.sql_wait >= 10) {
-            struct timeval current_time;
-            gettimeofday(&current_time, NULL);
-            localtime_r(&current_time.tv_sec, &tm);
-            strftime(tmp_str, 100, "%T", &tm);
-            render_bargraph(metadata_ptr->pwr_dbfs, bar);
-            fprintf(stdout, "%s: Level[%s\033[1;30m%5.1f\033[0m]", tmp_str, bar, metadata_ptr->pwr_dbfs);
-        }
+        if (cmd->seq > seq) break;
+        if (!ctx.cmd_ret_ptr->acquireWrite(&ret_ptr, 1)) break;
 
-        // Zero out the output audio buffer
-        memset(ctx.audio_buffer_float, 0, sizeof(ctx.audio_buffer_float));
-        unsigned j = 0;
-        for (auto &ch : channels) {
-            for (unsigned i = 0; i < CH_IQ_BUF_SIZE; ++i) {
-                // Should we always run IQ samples through the AGC even if the squelsh is not open?
-                iqsample_t agc_adj_sample = ch.agc.adjust(iq_buffer[j]); // AGC adjusted IQ sample
-                if (ch.sql_state == SQL_OPEN) {
-                    // AM demodulator
-                    //float s = std::abs(agc_adj_sample);
-                    float s = ch.demod.demod(agc_adj_sample);
-
-                    s = ch.agc_lf.adjust(s);
-
-                    // If the squelsh has just opend, ramp up the audio
-                    if (ch.sql_state_prev == SQL_CLOSED) {
-                        s = ramp_up[i] * s;
-                    }
+        auto iter = std::find(channels.begin(), channels.end(), cmd->name.c_str());
+        switch (cmd->type) {
+            case ChannelCmd::Type::ADD:
+                channels.push_back(std::move(cmd->out_ch));
+                break;
 
-                    // Mix this channel into the output buffer
-                    switch (ch.pos) {
-                        case -2:
-                            ctx.audio_buffer_float[i*2] += 0.8f*s;
-                            ctx.audio_buffer_float[i*2+1] += 0.2f*s;
-                            break;
-
-                        case -1:
-                            ctx.audio_buffer_float[i*2] += 0.6f*s;
-                            ctx.audio_buffer_float[i*2+1] += 0.4f*s;
-                            break;
-
-                        case 1:
-                            ctx.audio_buffer_float[i*2] += 0.4f*s;
-                            ctx.audio_buffer_float[i*2+1] += 0.6f*s;
-                            break;
-
-                        case 2:
-                            ctx.audio_buffer_float[i*2] += 0.2f*s;
-                            ctx.audio_buffer_float[i*2+1] += 0.8f*s;
-                            break;
-
-                        default:
-                            // Center
-                            ctx.audio_buffer_float[i*2] += 0.5f*s;
-                            ctx.audio_buffer_float[i*2+1] += 0.5f*s;
-                            break;
-                    }
-                } else if (ch.sql_state_prev == SQL_OPEN) {
-                    // Ramp down
-                    float s = std::abs(agc_adj_sample);
-                    s = ch.agc_lf.adjust(s);
-                    s = ramp_down[i] * s;
-
-                    // Mix this channel into the output buffer
-                    switch (ch.pos) {
-                        case -2:
-                            ctx.audio_buffer_float[i*2] += 0.8f*s;
-                            ctx.audio_buffer_float[i*2+1] += 0.2f*s;
-                            break;
-
-                        case -1:
-                            ctx.audio_buffer_float[i*2] += 0.6f*s;
-                            ctx.audio_buffer_float[i*2+1] += 0.4f*s;
-                            break;
-
-                        case 1:
-                            ctx.audio_buffer_float[i*2] += 0.4f*s;
-                            ctx.audio_buffer_float[i*2+1] += 0.6f*s;
-                            break;
-
-                        case 2:
-                            ctx.audio_buffer_float[i*2] += 0.2f*s;
-                            ctx.audio_buffer_float[i*2+1] += 0.8f*s;
-                            break;
-
-                        default:
-                            // Center
-                            ctx.audio_buffer_float[i*2] += 0.5f*s;
-                            ctx.audio_buffer_float[i*2+1] += 0.5f*s;
-                            break;
-                    }
+            case ChannelCmd::Type::REMOVE:
+                if (iter != channels.end()) {
+                    cmd->out_ch = std::move(*iter);
+                    channels.erase(iter);
                 }
-                ctx.fft_in[i] = iq_buffer[j] * ctx.window[i];  // Fill fft buffer
-                ++j;
-            }
-            ch.sql_state_prev = ch.sql_state;
+                break;
 
-            fftwf_execute(ctx.fft_plan);
-            // **** Calculate sql for channel here. Start
+            case ChannelCmd::Type::SQL:
+                if (iter != channels.end()) iter->sql_level = cmd->sql_level;
+                break;
+
+            case ChannelCmd::Type::MOD:
+                if (iter != channels.end()) {
+                    iter->mod = cmd->mod;
+                    iter->demod = Demod(cmd->mod);
+                }
+                break;
+
+            case ChannelCmd::Type::PAN:
+                if (iter != channels.end()) iter->pos = cmd->pos;
+                break;
+
+            case ChannelCmd::Type::RETUNE:
+                if (cmd->tuned) ctx.settings.tuner_fq = cmd->tuner_fq;
+                break;
+        }
+
+        *ret_ptr = cmd;
+        ctx.cmd_ret_ptr->commitWrite(1);
+        ++num_applied;
+    }
+
+    ctx.cmd_out_ptr->commitRead(num_applied);
+    if (num_applied > 0) EventLoop::trigger(ctx.ret_event);
+}
+
+
+// Hand the pool down samplers over to the candidates they are assigned to in
+// the block. A channel taking over a down sampler starts with a closed
+// squelch and fresh AGCs
+static void follow_pool(OutputState &ctx, const Metadata &meta) {
+    std::vector<Channel> &channels = ctx.settings.channels;
+
+    for (unsigned slot = 0; slot < channels.size(); ++slot) {
+        int owner = meta.pool[slot];
+        if (owner == ctx.pool_owners[slot]) continue;
+
+        ctx.pool_owners[slot] = owner;
+        if (owner < 0) continue;
+
+        const Channel &cand = ctx.pool_ptr->candidates[owner];
+        Channel       &ch = channels[slot];
+
+        ch.name           = cand.name;
+        ch.sql_level      = cand.sql_level;
+        ch.sql_state      = SQL_CLOSED;
+        ch.sql_state_prev = SQL_CLOSED;
+        ch.pos            = cand.pos;
+        ch.group          = cand.group;
+        ch.prio           = cand.prio;
+        ch.audio          = cand.audio;
+        ch.mod            = cand.mod;
+        ch.demod          = Demod(cand.mod);
+        ch.agc            = cand.agc;
+        ch.agc_lf         = cand.agc_lf;
+    }
+}
+
+
+// Keep track of the squelch activity in the current scan window. The window
+// is reported idle, and the event loop retunes on the scan event, when it
+// has been played for the dwell time and, if any squelch has opened, the
+// squelch has been closed for the hang time
+static void update_scan(OutputState &ctx, int window, bool sql_activity) {
+    ScanState &scan = *ctx.scan_ptr;
+
+    if (window != ctx.scan_window) {
+        ctx.scan_window = window;
+        ctx.scan_blocks = 0;
+        ctx.scan_quiet = 0;
+        ctx.scan_active = false;
+    }
+
+    ++ctx.scan_blocks;
+    if (sql_activity) {
+        ctx.scan_active = true;
+        ctx.scan_quiet = 0;
+    } else {
+        ++ctx.scan_quiet;
+    }
+
+    // One block is 32ms
+    if (ctx.scan_blocks * 32 >= ctx.settings.scan_dwell && (!ctx.scan_active || ctx.scan_quiet * 32 >= ctx.settings.scan_hang)) {
+        if (scan.idle.exchange(window, std::memory_order_release) != window) EventLoop::trigger(scan.event);
+    }
+}
+
+
+// Update the metrics slot of the channel with index idx after a block has
+// been processed
+static void update_channel_metrics(MetricsState &metrics, const CostState *cost_ptr, size_t idx, Channel &ch, float snr) {
+    if (idx >= metrics.channels.size()) return;
+
+    MetricsState::ChannelSlot &slot = metrics.channels[idx];
+
+    // Another channel in the slot. Start over
+    if (slot.name.set(ch.name)) {
+        slot.blocks.store(0, std::memory_order_relaxed);
+        slot.sql_open.store(0, std::memory_order_relaxed);
+        if (cost_ptr && idx < cost_ptr->channels.size()) {
+            slot.ds_base.store(cost_ptr->channels[idx].ds_ns.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            slot.out_base.store(cost_ptr->channels[idx].out_ns.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+
+    metrics_add(slot.blocks, 1);
+    if (ch.sql_state == SQL_OPEN) metrics_add(slot.sql_open, 1);
+    slot.snr.store(snr, std::memory_order_relaxed);
+    slot.agc_gain.store(ch.agc.gain(), std::memory_order_relaxed);
+}
+
+
+// Update the status slot of the channel with index idx after a block has
+// been processed
+static void update_channel_status(StatusState &status, size_t idx, Channel &ch, const SqlMeter::Levels &levels) {
+    if (idx >= status.channels.size()) return;
+
+    StatusState::ChannelSlot &slot = status.channels[idx];
+
+    slot.name.set(ch.name);
+    slot.open.store(ch.sql_state == SQL_OPEN, std::memory_order_relaxed);
+    slot.snr.store(levels.snr, std::memory_order_relaxed);
+    slot.ref_lo.store(levels.ref_lo, std::memory_order_relaxed);
+    slot.sig.store(levels.sig, std::memory_order_relaxed);
+    slot.ref_hi.store(levels.ref_hi, std::memory_order_relaxed);
+    slot.agc_gain.store(ch.agc.gain(), std::memory_order_relaxed);
+    slot.lf_gain.store(ch.agc_lf.gain(), std::memory_order_relaxed);
+    slot.block.store(status.blocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+
+// Hand a processed block over to the status thread. The channel slots are
+// updated by update_channel_status() and the block is complete once blocks has
+// been stored
+static void publish_status(OutputState &ctx, float pwr_dbfs, int window, unsigned num_active) {
+    StatusState &status = *ctx.status_ptr;
+
+    // Spectral imbalance is only shown when there is a single channel
+    if (num_active == 1) {
+        float lo_energy = std::accumulate(ctx.lo_energy.begin(), ctx.lo_energy.end(), 0.0f) / ctx.lo_energy.size();
+        float hi_energy = std::accumulate(ctx.hi_energy.begin(), ctx.hi_energy.end(), 0.0f) / ctx.hi_energy.size();
+        status.imbalance.store(hi_energy - lo_energy, std::memory_order_relaxed);
+    }
+
+    status.pwr_dbfs.store(pwr_dbfs, std::memory_order_relaxed);
+    status.window.store(window, std::memory_order_relaxed);
+    status.num_active.store(num_active, std::memory_order_relaxed);
+    status.num_channels.store(ctx.settings.channels.size(), std::memory_order_relaxed);
+    status.blocks.store(status.blocks.load(std::memory_order_relaxed) + 1);
+
+    // Wake the status thread if it waits for a block. The mutex is only taken
+    // then, at most once per redraw, so that the wakeup can not be lost
+    // between its check of blocks and the wait
+    if (status.waiting.exchange(false)) {
+        std::lock_guard<std::mutex> lock(status.mutex);
+        status.condition.notify_one();
+    }
+}
+
+
+// Share of one CPU core, in percent, spent on the channel with index idx since
+// the last call for the same index. Down sampling and output processing are
+// counted together. marks holds the channel time and timestamp of the last
+// call, by index
+static float channel_cpu_load(const CostState *cost_ptr, std::vector<std::pair<uint64_t, uint64_t>> &marks, size_t idx) {
+    if (!cost_ptr || idx >= cost_ptr->channels.size() || idx >= marks.size()) return 0.0f;
+
+    const CostState::ChannelCost &cost = cost_ptr->channels[idx];
+    uint64_t ns = cost.ds_ns.load(std::memory_order_relaxed) + cost.out_ns.load(std::memory_order_relaxed);
+    uint64_t ts = LatencyHist::now();
+    auto    &[mark_ns, mark_ts] = marks[idx];
+
+    float load = mark_ts && ts > mark_ts && ns >= mark_ns ? 100.0f * (ns - mark_ns) / (ts - mark_ts) : 0.0f;
+    mark_ns = ns;
+    mark_ts = ts;
+
+    return load;
+}
 
-            // Energy/power calculations for squelch and spectral imbalance
-            float sig_level = 0.0f;
-            for (unsigned i = 3; i < 91; i++) {
-                // About 2.8kHz +/- Fc
-                sig_level += std::norm(ctx.fft_out[i]);
-                sig_level += std::norm(ctx.fft_out[FFT_SIZE - i]);
-            }
-            // Including DC seem to increase base level with ~5dB
-            //sig_level += std::norm(ctx.fft_out[0]);
-            sig_level /= 176;
-
-            float ref_level_hi = 0.0f;
-            float ref_level_lo = 0.0f;
-            for (unsigned i = 112; i < 157; i++) {
-                // About 3.5kHz to 4.9kHz
-                ref_level_hi += std::norm(ctx.fft_out[i] * passband_shape[i]);
-                ref_level_lo += std::norm(ctx.fft_out[FFT_SIZE - i] * passband_shape[FFT_SIZE - i]);
-                //ref_level_hi += std::norm(ctx.fft_out[i]);
-                //ref_level_lo += std::norm(ctx.fft_out[FFT_SIZE - i]);
-            }
-            ref_level_hi /= 45;
-            ref_level_lo /= 45;
-            float noise_level = (ref_level_hi + ref_level_lo) / 2;
-
-            // Calculate SNR
-            float snr = 10 * std::log10(sig_level / noise_level);
-
-            // Require a bit higher SNR than requested to open the squelsh
-            if (snr > ch.sql_level + 3 || ch.sql_level == 0.0f) {
-                ch.sql_state = SQL_OPEN;
-            } else if (snr < ch.sql_level) {
-                ch.sql_state = SQL_CLOSED;
-            }
 
-            // Determine spectral imbalance (indicating frequency offset between signal and receiver fqs)
-            float lo_energy = 0.0f;
-            float hi_energy = 0.0f;
-            for (unsigned i = 1; i < FFT_SIZE/2; i++) {
-                hi_energy += std::norm(ctx.fft_out[i]);
-                lo_energy += std::norm(ctx.fft_out[i+FFT_SIZE/2]);
+// Record the end to end latency of a block that has just been written to the
+// sound card. The last sample of the block was received at block_ts and
+// will be played when the frames already in the sound card buffer have been
+// played. The same holds for every other sample in the block, so this is the
+// latency of each sample from the device callback to the speaker. Time spent
+// in the device and in the USB transfers before the callback is not included
+static void record_e2e(OutputState &ctx, const Metadata::TimeStamp &block_ts,
+                       const Metadata::TimeStamp &commit_ts, const Metadata::TimeStamp &read_ts) {
+    Metadata::TimeStamp written_ts = std::chrono::system_clock::now();
+    snd_pcm_sframes_t   delay = 0;
+
+    if (ctx.pcm_handle && snd_pcm_delay(ctx.pcm_handle, &delay) < 0) delay = 0;
+
+    // The system clock may be stepped. Such parts are recorded as zero
+    auto ns = [](const Metadata::TimeStamp &from, const Metadata::TimeStamp &to) {
+        int64_t d = std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+        return (uint64_t)std::max<int64_t>(d, 0);
+    };
+
+    uint64_t device_ns = (uint64_t)std::max<snd_pcm_sframes_t>(delay, 0) * BLOCK_TIME_NS / CH_IQ_BUF_SIZE;
+    auto    &e2e = ctx.timing_ptr->e2e;
+
+    e2e.input.record(ns(block_ts, commit_ts));
+    e2e.queue.record(ns(commit_ts, read_ts));
+    e2e.output.record(ns(read_ts, written_ts));
+    e2e.device.record(device_ns);
+    e2e.total.record(ns(block_ts, written_ts) + device_ns);
+}
+
+
+// Called when the sound card wants another period, i.e. every 32 ms
+static void alsa_write_cb(OutputState &ctx) {
+    int                    ret;
+    const iqsample_t      *iq_buffer;
+    const struct Metadata *metadata_ptr = nullptr;
+    std::vector<Channel>  &channels = ctx.settings.channels;
+    unsigned               num_active;   // Channels in the scan window of the block
+
+    static Log::Limit avail_limit;
+    static Log::Limit write_limit;
+    static Log::Limit underrun_limit;
+    static Log::Limit silence_limit;
+
+    // There is no PCM device when benchmarking. Audio is then thrown away
+    ret = ctx.pcm_handle ? snd_pcm_avail_update(ctx.pcm_handle) : 0;
+    if (ret < 0) {
+        ctx.log_ptr->print(Log::Stream::ERR, &avail_limit, "ALSA Error pcm_avail: %s", snd_strerror(ret));
+        if (ctx.metrics_ptr) metrics_add(ctx.metrics_ptr->alsa_errors, 1);
+        //snd_pcm_prepare(ctx.pcm_handle);
+        // What to do here? Restart device? Just return?
+    }
+
+    ctx.running = true;
+
+    if (ctx.trace_ptr) ctx.trace_ptr->threadName("Output");
+
+    if (ctx.rb_ptr->acquireRead(&iq_buffer, &metadata_ptr)) {
+        uint64_t timing_start = ctx.timing_ptr || ctx.trace_ptr ? LatencyHist::now() : 0;
+        uint64_t cpu_start = ctx.metrics_ptr ? thread_cpu_time() : 0;
+        uint64_t seq = metadata_ptr->seq;
+
+        PerfCounters::Counts perf_start, perf_end;
+        if (ctx.perf_ptr) PerfCounters::read(perf_start);
+
+        // The metadata is gone once the chunk is released
+        Metadata::TimeStamp block_ts  = metadata_ptr->ts;
+        Metadata::TimeStamp commit_ts = metadata_ptr->commit_ts;
+        Metadata::TimeStamp read_ts   = ctx.timing_ptr ? std::chrono::system_clock::now() : Metadata::TimeStamp();
+
+        if (ctx.trace_ptr) {
+            ctx.trace_ptr->asyncEnd("Ring buffer", timing_start, seq);
+            ctx.trace_ptr->instant("Read", timing_start, seq);
+        }
+
+        ctx.samples_received = true;
+
+        // Bring the channel layout in line with the block
+        if (ctx.cmd_out_ptr) apply_output_cmds(ctx, metadata_ptr->seq);
+
+        if (ctx.pool_ptr) follow_pool(ctx, *metadata_ptr);
+
+        // Channels with data in this block
+        int window = metadata_ptr->window;
+        auto in_block = [&ctx, metadata_ptr, &channels, window](const Channel &ch) {
+            return (int)ch.window == window && (!ctx.pool_ptr || metadata_ptr->pool[&ch - &channels[0]] >= 0);
+        };
+        num_active = std::count_if(channels.begin(), channels.end(), in_block);
+
+        // Highest priority among the open channels. Open channels with lower
+        // priority are muted
+        unsigned max_prio = 0;
+        for (auto &ch : channels) {
+            if (in_block(ch) && ch.sql_state == SQL_OPEN && ch.audio && ch.prio > max_prio) max_prio = ch.prio;
+        }
+
+        auto bench_ts = BenchStats::start(ctx.bench_ptr);
+
+        // Zero out the output audio buffer
+        memset(ctx.audio_buffer_float, 0, sizeof(ctx.audio_buffer_float));
+        unsigned j = 0;
+        bool     sql_activity = false;
+        for (auto &ch : channels) {
+            // Channels in other scan windows, and pool down samplers not in
+            // use, keep their state as is
+            if (!in_block(ch)) {
+                j += CH_IQ_BUF_SIZE;
+                continue;
             }
 
-            ctx.lo_energy[ctx.energy_idx] = lo_energy / 255;
-            ctx.hi_energy[ctx.energy_idx] = hi_energy / 255;
-            if (++ctx.energy_idx == 10) ctx.energy_idx = 0;
+            size_t   ch_idx = &ch - &channels[0];
+            uint64_t ch_start = ctx.cost_ptr ? LatencyHist::now() : 0;
 
-            // Convert levels to dB. Division by 512 is for compensating for
-            // the FFT gain (number of points, N)
-            sig_level    = 10 * std::log10(sig_level/512.0f);
-            ref_level_hi = 10 * std::log10(ref_level_hi/512.0f);
-            ref_level_lo = 10 * std::log10(ref_level_lo/512.0f);
-
-            if (ctx.sql_wait >= 10) {
-                lo_energy = 0.0f;
-                hi_energy = 0.0f;
-                for (unsigned i = 0; i < 10; ++i) {
-                    lo_energy += ctx.lo_energy[i];
-                    hi_energy += ctx.hi_energy[i];
-                }
+            const iqsample_t *ch_iq = iq_buffer + j;
 
-                lo_energy /= 10;
-                hi_energy /= 10;
+            // Squelch state as heard
+            sql_state_t audio_state = (ch.sql_state == SQL_OPEN && ch.audio && ch.prio >= max_prio) ? SQL_OPEN : SQL_CLOSED;
 
-                float imbalance = hi_energy - lo_energy;
+            // AGC, demodulation and squelch ramps as in the receiver engine
+            float ch_audio[CH_IQ_BUF_SIZE];
+            if (Receiver::demodBlock(ch.agc, ch.agc_lf, ch.demod, ch_iq, audio_state, ch.sql_state_prev, ch_audio)) {
+                float left, right;
 
-                if (channels.size() == 1) {
-                    if (ch.sql_state == SQL_OPEN) {
-                        fprintf(stdout, "  \033[103m\033[30m%s\033[0m[\033[1;30m%4.1f\033[0m] [\033[1;30m%5.1f|%5.1f|%5.1f\033[0m] [\033[1;30m%6.2f\033[0m] [SNR] [low|mid|hig] [imbalance]",
-                                ch.name.c_str(), snr, ref_level_lo, sig_level, ref_level_hi, imbalance);
-                    } else {
-                        fprintf(stdout, "  %s[\033[1;30m%4.1f\033[0m] [\033[1;30m%5.1f|%5.1f|%5.1f\033[0m] [\033[1;30m%6.2f\033[0m] [SNR] [low|mid|hig] [imbalance]",
-                                ch.name.c_str(), snr, ref_level_lo, sig_level, ref_level_hi, imbalance);
-                    }
-                } else {
-                    if (snr < 1.0f) snr = 0.0f;
-                    if (ch.sql_state == SQL_OPEN) {
-                        if (verbose) {
-                            fprintf(stdout, "  \033[103m\033[30m%s\033[0m[\033[1;30m%4.1f\033[0m]/%5.1f/%5.1f", ch.name.c_str(), snr, ch.agc.gain(), ch.agc_lf.gain());
-                        } else if (compact) {
-                            fprintf(stdout, "  \033[103m\033[30m%s\033[0m", ch.name.c_str());
-                        } else {
-                            fprintf(stdout, "  \033[103m\033[30m%s\033[0m[\033[1;30m%4.1f\033[0m]", ch.name.c_str(), snr);
-                        }
-                    } else {
-                        if (verbose) {
-                            fprintf(stdout, "  %s[\033[1;30m%4.1f\033[0m]/%5.1f/%5.1f", ch.name.c_str(), snr, ch.agc.gain(), ch.agc_lf.gain());
-                        } else if (compact) {
-                            fprintf(stdout, "  %s", ch.name.c_str());
-                        } else {
-                            fprintf(stdout, "  %s[\033[1;30m%4.1f\033[0m]", ch.name.c_str(), snr);
-                        }
-                    }
+                // Mix this channel into the output buffer
+                switch (ch.pos) {
+                    case -2: left = 0.8f; right = 0.2f; break;
+                    case -1: left = 0.6f; right = 0.4f; break;
+                    case  1: left = 0.4f; right = 0.6f; break;
+                    case  2: left = 0.2f; right = 0.8f; break;
+                    default: left = 0.5f; right = 0.5f; break;  // Center
+                }
+
+                for (unsigned i = 0; i < CH_IQ_BUF_SIZE; ++i) {
+                    ctx.audio_buffer_float[i*2] += left*ch_audio[i];
+                    ctx.audio_buffer_float[i*2+1] += right*ch_audio[i];
                 }
             }
+            j += CH_IQ_BUF_SIZE;
+
+            // **** Calculate sql for channel here. Start
+            SqlMeter::Levels levels = ctx.sql_meter.measure(ch_iq);
+            float snr = levels.snr;
+
+            ch.sql_state = SqlMeter::gate(ch.sql_state, snr, ch.sql_level);
+            if (ch.sql_state == SQL_OPEN) sql_activity = true;
+
+            if (ctx.digest_ptr && ch_idx < ctx.digest_ptr->iq.size()) {
+                DigestState::add(ctx.digest_ptr->iq[ch_idx], ch_iq, CH_IQ_BUF_SIZE * sizeof(iqsample_t));
+                DigestState::add(ctx.digest_ptr->sql[ch_idx], &snr, sizeof(snr));
+                DigestState::add(ctx.digest_ptr->sql[ch_idx], &ch.sql_state, sizeof(ch.sql_state));
+            }
+
+            if (ctx.metrics_ptr) update_channel_metrics(*ctx.metrics_ptr, ctx.cost_ptr, &ch - &channels[0], ch, snr);
+
+            // Spectral imbalance (indicating frequency offset between signal and receiver fqs)
+            ctx.lo_energy[ctx.energy_idx] = levels.lo_energy;
+            ctx.hi_energy[ctx.energy_idx] = levels.hi_energy;
+            if (++ctx.energy_idx == 10) ctx.energy_idx = 0;
+
+            if (ctx.status_ptr) update_channel_status(*ctx.status_ptr, ch_idx, ch, levels);
+
+            if (ctx.cost_ptr && ch_idx < ctx.cost_ptr->channels.size()) {
+                metrics_add(ctx.cost_ptr->channels[ch_idx].out_ns, LatencyHist::now() - ch_start);
+            }
+
             // **** Calculate sql for channel here. End
         }
 
-        ctx.rb_ptr->commitRead();
+        if (ctx.scan_ptr && window >= 0) update_scan(ctx, window, sql_activity);
+        BenchStats::mark(ctx.bench_ptr, BenchStats::DEMOD, bench_ts);
+
+        // Samples recorded while the tuner changed frequency are not played
+        if (metadata_ptr->transitional) {
+            memset(ctx.audio_buffer_float, 0, sizeof(ctx.audio_buffer_float));
+        }
 
-        if (++ctx.sql_wait > 10) {
-            ctx.sql_wait = 0;
-            fprintf(stdout, "\n");
+        if (ctx.status_ptr) publish_status(ctx, metadata_ptr->pwr_dbfs, window, num_active);
+
+        ctx.rb_ptr->commitRead();
+        if (ctx.metrics_ptr) {
+            metrics_add(ctx.metrics_ptr->blocks_out, 1);
+            ctx.metrics_ptr->num_channels.store(channels.size(), std::memory_order_relaxed);
         }
 
         // Common filter for the mixed audio from all channels
         ctx.audio_filter->filter(ctx.audio_buffer_float, CH_IQ_BUF_SIZE*2, ctx.audio_buffer_float);
 
         // Convert float to 16 bit signed
-        for (unsigned i = 0; i < CH_IQ_BUF_SIZE*2; ++i) {
-            int16_t s;
-            if (ctx.audio_buffer_float[i] > 1.0f)       s = 32767;
-            else if (ctx.audio_buffer_float[i] < -1.0f) s = -32767;
-            else s = (int16_t)(ctx.audio_buffer_float[i] * 32767.0f);
-
-            ctx.audio_buffer_s16[i] = s;
+        float_to_s16(ctx.audio_buffer_float, CH_IQ_BUF_SIZE*2, ctx.audio_buffer_s16);
+        if (ctx.digest_ptr) DigestState::add(ctx.digest_ptr->audio, ctx.audio_buffer_s16, sizeof(ctx.audio_buffer_s16));
+        BenchStats::mark(ctx.bench_ptr, BenchStats::AUDIO_FILTER, bench_ts);
+
+        if (ctx.timing_ptr || ctx.trace_ptr) {
+            uint64_t now = LatencyHist::now();
+            if (ctx.timing_ptr) ctx.timing_ptr->output.record(now - timing_start);
+            if (ctx.trace_ptr) ctx.trace_ptr->span("Output processing", timing_start, now, seq);
+            timing_start = now;
+        }
+        if (ctx.metrics_ptr) {
+            uint64_t now = thread_cpu_time();
+            metrics_add(ctx.metrics_ptr->output_cpu, now - cpu_start);
+            cpu_start = now;
+        }
+        if (ctx.perf_ptr) {
+            PerfCounters::read(perf_end);
+            ctx.perf_ptr->output.record(perf_start, perf_end, "Output");
+            perf_start = perf_end;
         }
 
         // Write to sound card
-        ret = snd_pcm_writei(ctx.pcm_handle, ctx.audio_buffer_s16, CH_IQ_BUF_SIZE);
+        ret = ctx.pcm_handle ? snd_pcm_writei(ctx.pcm_handle, ctx.audio_buffer_s16, CH_IQ_BUF_SIZE) : CH_IQ_BUF_SIZE;
+        if (ctx.timing_ptr || ctx.trace_ptr) {
+            uint64_t now = LatencyHist::now();
+            if (ctx.timing_ptr) ctx.timing_ptr->alsa.record(now - timing_start);
+            if (ctx.trace_ptr) ctx.trace_ptr->span("ALSA write", timing_start, now, seq);
+        }
+        if (ctx.metrics_ptr) metrics_add(ctx.metrics_ptr->alsa_cpu, thread_cpu_time() - cpu_start);
+        if (ctx.perf_ptr) {
+            PerfCounters::read(perf_end);
+            ctx.perf_ptr->alsa.record(perf_start, perf_end, "Output");
+        }
         if (ret < 0) {
-            std::cerr << "Error: Failed to play audio samples: " << snd_strerror(ret) << ".\n";
+            ctx.log_ptr->print(Log::Stream::ERR, &write_limit, "Error: Failed to play audio samples: %s.", snd_strerror(ret));
+            if (ctx.metrics_ptr) metrics_add(ctx.metrics_ptr->alsa_errors, 1);
             snd_pcm_prepare(ctx.pcm_handle);
         } else {
             //std::cout << "    frames written real: " << ret << std::endl;
+            if (ctx.timing_ptr) record_e2e(ctx, block_ts, commit_ts, read_ts);
         }
 
     } else {
         // Underrrun
         if (ctx.rb_ptr->isStreaming()) {
             // Only write warning while streaming
-            std::cerr << "Warning: Ring buffer empty. Playing 32ms of silence.\n";
+            ctx.log_ptr->print(Log::Stream::ERR, &underrun_limit, "Warning: Ring buffer empty. Playing 32ms of silence.");
+            if (ctx.metrics_ptr) metrics_add(ctx.metrics_ptr->underruns, 1);
         }
 
-        ret = snd_pcm_writei(ctx.pcm_handle, ctx.silence, CH_IQ_BUF_SIZE);
+        uint64_t trace_start = ctx.trace_ptr ? LatencyHist::now() : 0;
+        ret = ctx.pcm_handle ? snd_pcm_writei(ctx.pcm_handle, ctx.silence, CH_IQ_BUF_SIZE) : CH_IQ_BUF_SIZE;
+        if (ctx.trace_ptr) ctx.trace_ptr->span("ALSA write silence", trace_start, LatencyHist::now());
         if (ret < 0) {
-            std::cerr << "Error: Failed to play underrun silence: " << snd_strerror(ret) << ".\n";
+            ctx.log_ptr->print(Log::Stream::ERR, &silence_limit, "Error: Failed to play underrun silence: %s.", snd_strerror(ret));
+            if (ctx.metrics_ptr) metrics_add(ctx.metrics_ptr->alsa_errors, 1);
             snd_pcm_prepare(ctx.pcm_handle);
         }
     }
@@ -779,6 +1825,284 @@ static void close_alsa_dev(snd_pcm_t *dev) {
 }
 
 
+// Time of day as HH:MM:SS for the status display
+static std::string status_time(void) {
+    struct timeval current_time;
+    struct tm      tm;
+    char           buf[32];
+
+    gettimeofday(&current_time, NULL);
+    localtime_r(&current_time.tv_sec, &tm);
+    strftime(buf, sizeof(buf), "%T", &tm);
+
+    return buf;
+}
+
+
+// Level of the last block as a bargraph and in dBFS
+static std::string status_level(const StatusState &status) {
+    char  bar[75];
+    char  buf[128];
+    float pwr_dbfs = status.pwr_dbfs.load(std::memory_order_relaxed);
+
+    render_bargraph(pwr_dbfs, bar);
+    snprintf(buf, sizeof(buf), "Level[%s\033[1;30m%5.1f\033[0m]", bar, pwr_dbfs);
+
+    return buf;
+}
+
+
+// Scan window of the last block
+static std::string status_scan(const StatusState &status) {
+    char buf[32];
+    int  window = status.window.load(std::memory_order_relaxed);
+
+    if (window < 0 || (size_t)window >= status.scan_fqs.size()) return "Scan[-------]";
+    snprintf(buf, sizeof(buf), "Scan[%7.3f]", status.scan_fqs[window] / 1e6);
+
+    return buf;
+}
+
+
+// Channels in the block with number blocks, by index in the channel list
+static std::vector<size_t> status_channels(const StatusState &status, uint64_t blocks) {
+    std::vector<size_t> idxs;
+    size_t              num_channels = std::min<size_t>(status.num_channels.load(std::memory_order_relaxed), status.channels.size());
+
+    for (size_t idx = 0; idx < num_channels; ++idx) {
+        if (status.channels[idx].block.load(std::memory_order_relaxed) >= blocks) idxs.push_back(idx);
+    }
+
+    return idxs;
+}
+
+
+// Status of one channel. The name is highlighted if the squelch is open.
+// detail adds the levels and the spectral imbalance and is used when there is
+// a single channel. cpu is only shown in the verbose status
+static std::string channel_status_text(const StatusState &status, const StatusState::ChannelSlot &slot,
+                                       const std::string &name, bool detail, float cpu) {
+    char        buf[256];
+    float       snr = slot.snr.load(std::memory_order_relaxed);
+    std::string label = slot.open.load(std::memory_order_relaxed) ? "\033[103m\033[30m" + name + "\033[0m" : name;
+
+    if (detail) {
+        snprintf(buf, sizeof(buf), "%s[\033[1;30m%4.1f\033[0m] [\033[1;30m%5.1f|%5.1f|%5.1f\033[0m] [\033[1;30m%6.2f\033[0m] [SNR] [low|mid|hig] [imbalance]",
+                 label.c_str(), snr, slot.ref_lo.load(std::memory_order_relaxed), slot.sig.load(std::memory_order_relaxed),
+                 slot.ref_hi.load(std::memory_order_relaxed), status.imbalance.load(std::memory_order_relaxed));
+    } else {
+        if (snr < 1.0f) snr = 0.0f;
+        if (status.verbose) {
+            snprintf(buf, sizeof(buf), "%s[\033[1;30m%4.1f\033[0m]/%5.1f/%5.1f/%4.1f%%", label.c_str(), snr,
+                     slot.agc_gain.load(std::memory_order_relaxed), slot.lf_gain.load(std::memory_order_relaxed), cpu);
+        } else if (status.compact) {
+            snprintf(buf, sizeof(buf), "%s", label.c_str());
+        } else {
+            snprintf(buf, sizeof(buf), "%s[\033[1;30m%4.1f\033[0m]", label.c_str(), snr);
+        }
+    }
+
+    return buf;
+}
+
+
+// Print a status line for the block with number blocks, like
+//
+//     12:00:00: Level[███▌     -38.2]  ESSA[12.5]  ESOW[ 0.0]
+//
+// page is the page to show in paged status and is advanced for every line
+static void print_status_line(StatusState &status, uint64_t blocks, unsigned &page,
+                              std::vector<std::pair<uint64_t, uint64_t>> &cost_marks) {
+    char                buf[64];
+    std::vector<size_t> idxs = status_channels(status, blocks);
+    unsigned            num_active = idxs.size();
+    unsigned            num_pages = (num_active + STATUS_PAGE_SIZE - 1) / STATUS_PAGE_SIZE;
+    std::string         line = status_time() + ": " + status_level(status);
+
+    if (status.mode == Settings::StatusMode::PAGE && num_pages > 1) {
+        if (page >= num_pages) page = 0;
+        snprintf(buf, sizeof(buf), " [%2u/%u]", page + 1, num_pages);
+        line += buf;
+    }
+
+    if (!status.scan_fqs.empty()) line += " " + status_scan(status);
+
+    if (status.pool) {
+        snprintf(buf, sizeof(buf), " Pool[%2u/%u]", num_active, status.num_channels.load(std::memory_order_relaxed));
+        line += buf;
+    }
+
+    for (unsigned i = 0; i < num_active; ++i) {
+        const StatusState::ChannelSlot &slot = status.channels[idxs[i]];
+
+        // Channels to show
+        if (status.mode == Settings::StatusMode::OPEN && !slot.open.load(std::memory_order_relaxed)) continue;
+        if (status.mode == Settings::StatusMode::PAGE && i / STATUS_PAGE_SIZE != page) continue;
+
+        bool  detail = num_active == 1;
+        float cpu = status.verbose && !detail ? channel_cpu_load(status.cost_ptr, cost_marks, idxs[i]) : 0.0f;
+        line += "  " + channel_status_text(status, slot, slot.name.get(), detail, cpu);
+    }
+
+    if (status.mode == Settings::StatusMode::PAGE && ++page >= num_pages) page = 0;
+
+    while (cout_lock.test_and_set(std::memory_order_acquire));
+    fputs(line.c_str(), stdout);
+    fputc('\n', stdout);
+    fflush(stdout);
+    cout_lock.clear(std::memory_order_release);
+}
+
+
+// Draw the status grid for the block with number blocks. The first row has
+// the level and the counts and below it every channel has a cell with its
+// name and SNR. Channels that do not fit the terminal are shown one page at a
+// time. page and page_ts are the page shown and when it was first shown
+static void draw_status_grid(StatusState &status, uint64_t blocks, Screen &screen, unsigned &page,
+                             std::chrono::steady_clock::time_point &page_ts,
+                             std::vector<std::pair<uint64_t, uint64_t>> &cost_marks) {
+    char                     buf[64];
+    std::vector<size_t>      idxs = status_channels(status, blocks);
+    std::vector<std::string> names(idxs.size());
+    unsigned                 num_active = idxs.size();
+    unsigned                 num_open = 0;
+    unsigned                 name_width = 1;
+    bool                     detail = num_active == 1;
+
+    for (unsigned i = 0; i < num_active; ++i) {
+        const StatusState::ChannelSlot &slot = status.channels[idxs[i]];
+
+        names[i] = slot.name.get();
+        if (names[i].length() > STATUS_NAME_WIDTH) names[i].resize(STATUS_NAME_WIDTH);
+        name_width = std::max<unsigned>(name_width, names[i].length());
+        if (slot.open.load(std::memory_order_relaxed)) ++num_open;
+    }
+
+    screen.begin();
+
+    // Cells are padded to the same width so that a cell only changes when
+    // the values of its channel do
+    unsigned cell_width = name_width + 2;
+    if (status.verbose)      cell_width += 6 + 18;
+    else if (!status.compact) cell_width += 6;
+    if (detail || cell_width > screen.termCols()) cell_width = std::max(screen.termCols(), 1u);
+
+    unsigned cols = std::max(screen.termCols() / cell_width, 1u);
+    unsigned rows = screen.maxRows() > 2 ? screen.maxRows() - 2 : 1;
+    unsigned page_size = cols * rows;
+    unsigned num_pages = std::max((num_active + page_size - 1) / page_size, 1u);
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - page_ts >= std::chrono::milliseconds(STATUS_GRID_PAGE_MS)) {
+        ++page;
+        page_ts = now;
+    }
+    if (page >= num_pages) page = 0;
+
+    // Header
+    unsigned col = 0;
+    auto header = [&screen, &col](unsigned width, const std::string &text) {
+        screen.field(0, col, width, text);
+        col += width + 2;
+    };
+
+    header(8, status_time());
+    header(20, status_level(status));
+    if (!status.scan_fqs.empty()) header(13, status_scan(status));
+    snprintf(buf, sizeof(buf), "Channels[%3u/%u]", num_active, status.num_channels.load(std::memory_order_relaxed));
+    header(16, buf);
+    snprintf(buf, sizeof(buf), "Open[%3u]", num_open);
+    header(9, buf);
+    if (num_pages > 1) {
+        snprintf(buf, sizeof(buf), "Page[%2u/%u]", page + 1, num_pages);
+        header(10, buf);
+    }
+
+    // Channel cells
+    for (unsigned i = page * page_size; i < num_active && i < (page + 1) * page_size; ++i) {
+        const StatusState::ChannelSlot &slot = status.channels[idxs[i]];
+        unsigned pos = i - page * page_size;
+
+        names[i].resize(name_width, ' ');
+
+        float cpu = status.verbose && !detail ? channel_cpu_load(status.cost_ptr, cost_marks, idxs[i]) : 0.0f;
+        screen.field(2 + pos / cols, (pos % cols) * cell_width, cell_width, channel_status_text(status, slot, names[i], detail, cpu));
+    }
+
+    screen.end();
+}
+
+
+// The status thread. Formats and prints the status from the telemetry that
+// the output thread publishes, at a low priority and at most once per
+// interval, so that the cost of the printout does not depend on the number
+// of channels in the output thread. The thread sleeps until the output
+// thread publishes a new block, so nothing is printed, and the thread does
+// not wake up, when no blocks are played
+static void status_worker(StatusState &status) {
+    std::vector<std::pair<uint64_t, uint64_t>> cost_marks(status.channels.size());
+    Screen                                     screen(stdout, &cout_lock);
+    bool                                       grid = status.mode == Settings::StatusMode::GRID && screen.isTerminal();
+    unsigned                                   interval = grid ? STATUS_GRID_MS : STATUS_LINE_MS;
+    uint64_t                                   shown = 0;    // Last block shown
+    unsigned                                   page = 0;
+    auto                                       page_ts = std::chrono::steady_clock::now();
+
+    // On Linux this only affects the calling thread
+    if (setpriority(PRIO_PROCESS, 0, STATUS_NICE) < 0) {
+        // Run at normal priority
+    }
+
+    std::unique_lock<std::mutex> lock(status.mutex);
+    while (status.run) {
+        // Wait for a new block
+        status.waiting.store(true);
+        status.condition.wait(lock, [&status, shown] { return !status.run || status.blocks.load() != shown; });
+        status.waiting.store(false, std::memory_order_relaxed);
+        if (!status.run) break;
+
+        uint64_t blocks = status.blocks.load(std::memory_order_acquire);
+        shown = blocks;
+
+        lock.unlock();
+        if (grid) draw_status_grid(status, blocks, screen, page, page_ts, cost_marks);
+        else      print_status_line(status, blocks, page, cost_marks);
+        lock.lock();
+
+        // Rate limit the printout
+        status.condition.wait_for(lock, std::chrono::milliseconds(interval), [&status] { return !status.run; });
+    }
+    lock.unlock();
+
+    screen.close();
+}
+
+
+// Stop the status thread
+static void stop_status(StatusState &status) {
+    std::unique_lock<std::mutex> lock(status.mutex);
+    status.run = false;
+    lock.unlock();
+
+    status.condition.notify_one();
+}
+
+
+// Set up the audio buffers of the output state. The PCM handle and the audio
+// filter are set by the caller
+static void setup_output(OutputState &ctx) {
+    for (int i = 0; i < CH_IQ_BUF_SIZE*2; i++) {  // Stereo
+        ctx.silence[i] = 0;
+        ctx.audio_buffer_float[i] = 0.0f;
+        ctx.audio_buffer_s16[i] = 0;
+    }
+
+    ctx.energy_idx     = 0;
+    ctx.hi_energy.assign(10, 0.0f);
+    ctx.lo_energy.assign(10, 0.0f);
+}
+
+
 static void alsa_worker(struct OutputState &ctx) {
     int                ret;
     snd_pcm_t         *pcm_handle = nullptr;
@@ -788,16 +2112,13 @@ static void alsa_worker(struct OutputState &ctx) {
     struct timeval     current_time;
     //struct OutputState ctx = output_state;
 
+    static Log::Limit  poll_limit;
+    static Log::Limit  revents_limit;
+
     while (cout_lock.test_and_set(std::memory_order_acquire));
     std::cout << "Starting ALSA thread" << std::endl;
     cout_lock.clear();
 
-    for (int i = 0; i < CH_IQ_BUF_SIZE*2; i++) {  // Stereo
-        ctx.silence[i] = 0;
-        ctx.audio_buffer_float[i] = 0.0f;
-        ctx.audio_buffer_s16[i] = 0;
-    }
-
     //
     // Look here for ALSA tips: http://equalarea.com/paul/alsa-audio.html
     //
@@ -817,8 +2138,8 @@ static void alsa_worker(struct OutputState &ctx) {
     num_poll_descs = ret;
     std::cout << "Number of ALSA descriptors to poll: " << num_poll_descs << std::endl;
 
-    // Allocate space and get the descriptors
-    poll_descs = (struct pollfd*)calloc(num_poll_descs, sizeof(struct pollfd));
+    // Allocate space and get the descriptors. One extra for the stop event
+    poll_descs = (struct pollfd*)calloc(num_poll_descs + 1, sizeof(struct pollfd));
     ret = snd_pcm_poll_descriptors(pcm_handle, poll_descs, num_poll_descs);
     if (ret < 0) {
         std::cerr << "Error. Unable to get ALSA poll descriptors: " << snd_strerror(ret) << std::endl;
@@ -867,20 +2188,7 @@ static void alsa_worker(struct OutputState &ctx) {
 
     ctx.pcm_handle     = pcm_handle;
     ctx.audio_filter   = &flt;
-    ctx.fft_plan       = fftwf_plan_dft_1d(FFT_SIZE,
-                                           reinterpret_cast<fftwf_complex*>(ctx.fft_in),
-                                           reinterpret_cast<fftwf_complex*>(ctx.fft_out),
-                                           FFTW_FORWARD, FFTW_ESTIMATE);
-    ctx.sql_wait       = 0;
-    ctx.energy_idx     = 0;
-    ctx.hi_energy.reserve(10);
-    ctx.lo_energy.reserve(10);
-
-    // Create FFT window
-    // Hamming: 0.54-0.46cos(2*pi*x/N), 0 <= n <= N. Length L = N+1
-    for (unsigned n = 0; n <= FFT_SIZE; n++) {
-        ctx.window[n] = 0.54f - 0.46f * std::cos((2.0f * M_PI * n) / FFT_SIZE);
-    }
+    setup_output(ctx);
 
     // A bit unclear if this is needed since we configure the device for
     // "auto start" when initial amount of samples have been written.
@@ -890,17 +2198,21 @@ static void alsa_worker(struct OutputState &ctx) {
     // We can use ALSAs internal event loop instead of our own. Maybe ALSA
     // uses threads under the hood as well?
 
-    while (run) {
-        // Block until a descriptor indicates activity or 1s of inactivity
-        ret = poll(poll_descs, num_poll_descs, 1000000);
+    // The stop event is watched together with the ALSA descriptors so that
+    // the thread only wakes up when there is something to do
+    poll_descs[num_poll_descs].fd = ctx.stop_fd;
+    poll_descs[num_poll_descs].events = POLLIN;
+
+    while (true) {
+        // Block until a descriptor indicates activity
+        ret = poll(poll_descs, num_poll_descs + 1, -1);
         if (ret < 0) {
-            std::cerr << "Error: Unable to poll, ret = " << ret << ".\n";
-            continue;
-        } else if (ret == 0) {
-            // Inactivity timeout. Just poll again
+            ctx.log_ptr->print(Log::Stream::ERR, &poll_limit, "Error: Unable to poll, ret = %d.", ret);
             continue;
         }
 
+        if (poll_descs[num_poll_descs].revents != 0) break;
+
         // One or more fd:s indicated activity. Loop over all fds watched
         // and check which have activiy (i.e. .revents != 0)
         for (unsigned desc = 0; desc < num_poll_descs; desc++) {
@@ -909,7 +2221,8 @@ static void alsa_worker(struct OutputState &ctx) {
                 // logical to ALSA
                 ret = snd_pcm_poll_descriptors_revents(pcm_handle, &poll_descs[desc], 1, &revents);
                 if (ret < 0) {
-                    std::cerr << "Error: Unable to do ALSA revents, ret = " << ret << "(" << snd_strerror(ret) << ").\n";
+                    ctx.log_ptr->print(Log::Stream::ERR, &revents_limit, "Error: Unable to do ALSA revents, ret = %d(%s).", ret, snd_strerror(ret));
+                    if (ctx.metrics_ptr) metrics_add(ctx.metrics_ptr->alsa_errors, 1);
                 } else {
                     if (revents & POLLOUT) {
                         // The device indicate that it wants data to output
@@ -922,11 +2235,6 @@ static void alsa_worker(struct OutputState &ctx) {
         }
     }
 
-    fftwf_destroy_plan(ctx.fft_plan);
-
-    // Final cleanup needed to make valgrind happy
-    fftwf_cleanup();
-
     close_alsa_dev(pcm_handle);
 
     free(poll_descs);
@@ -937,71 +2245,6 @@ static void alsa_worker(struct OutputState &ctx) {
 }
 
 
-// Parse a string with a frequency in MHz and with dot (.) as decimal separator
-// into a frequency in Hz. If aeronautical is true, the parser expect a
-// aeronautical 8.33 or 25 kHz channel number instead of a frequency.
-//
-// Returns the parsed frequency or 0 if a invalid string is given.
-uint32_t parse_fq(const std::string &str, bool aeronautical = false) {
-    uint32_t fq = 0;
-    unsigned mhz = 0;
-    unsigned hz = 0;
-
-    // Dot is used as decimal separator
-    auto dot_pos = str.find_first_of('.');
-
-    // Decimal dot must be present
-    if (dot_pos == std::string::npos) return 0;
-
-    auto int_str  = str.substr(0, dot_pos); // integral part
-    auto frac_str = str.substr(dot_pos+1);  // fractional part
-
-    // Integral and fractional strings must contain digits and have correct lengths
-    if (!std::all_of(int_str.begin(), int_str.end(), ::isdigit) ||
-        !std::all_of(frac_str.begin(), frac_str.end(), ::isdigit) ||
-        int_str.length() < 2 || int_str.length() > 4 ||
-        frac_str.length() == 0 || frac_str.length() > 6
-    ) return 0;
-
-    // Aeronautical notation reqires exactly thre digits in the fractional part
-    if (aeronautical && frac_str.length() != 3) return 0;
-
-    if (aeronautical) {
-        // A 100kHz wide band "contains" 12 8.33kHz channels or 4 25kHz
-        // channels. Each channel has it's unique two digits making it
-        // possible to correctly convert a channel in both schemas
-        const std::map<std::string, unsigned> sub_ch_map{
-            { "00",     0 }, { "05",     0 }, { "10",  8333 }, { "15", 16667 },
-            { "25", 25000 }, { "30", 25000 }, { "35", 33333 }, { "40", 41667 },
-            { "50", 50000 }, { "55", 50000 }, { "60", 58333 }, { "65", 66667 },
-            { "75", 75000 }, { "80", 75000 }, { "85", 83333 }, { "90", 91667 }
-        };
-        auto sub_ch = sub_ch_map.find(frac_str.substr(1));
-        if (sub_ch != sub_ch_map.end()) {
-            mhz = std::atol(int_str.c_str());
-            hz = (frac_str[0] - '0') * 100000 + sub_ch->second;
-        }
-    } else {
-        mhz = std::atol(int_str.c_str());
-        const std::vector<unsigned> frac_multipliers = { 100000, 10000, 1000, 100, 10, 1 };
-
-        auto digit = frac_str.begin();
-        auto multi = frac_multipliers.begin();
-        while (digit != frac_str.end()) {
-            hz += (*digit - '0') * *multi;
-            ++digit;
-            ++multi;
-        }
-    }
-
-    if (mhz < 4000) {
-        fq = mhz * 1000000 + hz;
-    }
-
-    return fq;
-}
-
-
 // Get audio position for a channel given a channel index and total number of
 // channels. Number of audio positions must be odd, typically 3 or 5
 static int get_audio_pos(unsigned channel_no, unsigned num_channels) {
@@ -1147,6 +2390,156 @@ static void list_available_devices(void) {
 }
 
 
+// Parse a channel argument on the form CHANNEL[/SQL[/MOD]]. sql_level and mod
+// are only changed if given in the argument. Returns an empty string on
+// success or a description of the error
+static std::string parse_channel_arg(const std::string &arg, bool fq_type, std::string &name, float &sql_level, Modulation &mod) {
+    std::regex         ch_regex("^([0-9]{3}\\.[0-9]{3})(?:\\/([0-9]{1,2})(?:\\/(AM|FM))?)?$", std::regex::ECMAScript);
+    std::smatch        ch_match;
+    std::ostringstream err;
+    std::string        fq_str;
+    float              sql = sql_level;
+    Modulation         tmp_mod = mod;
+
+    std::regex_search(arg, ch_match, ch_regex);
+
+    if (ch_match.size() > 1) {
+        fq_str = ch_match.str(1);
+    }
+    if (ch_match.size() > 2 && !ch_match.str(2).empty()) {
+        sql = std::stof(ch_match.str(2));
+    }
+    if (ch_match.size() > 3 && !ch_match.str(3).empty()) {
+        tmp_mod = str_to_modulation(ch_match.str(3));
+    }
+
+    uint32_t fq_ret = parse_fq(fq_str, fq_type);
+    if (fq_ret == 0) {
+        err << "Invalid " << (fq_type == NORMAL_FQ ? "frequency":"channel") << " given: " << fq_str;
+    } else if (fq_ret < 45000000 || fq_ret > 1800000000) {
+        err << "Invalid frequency given: " << fq_ret << "Hz";
+    } else if (sql < 0.0f || sql > 50.0f) {
+        err << "Invalid SQL level given: " << sql;
+    } else {
+        name = fq_str;
+        sql_level = sql;
+        mod = tmp_mod;
+    }
+
+    return err.str();
+}
+
+
+// Parse one KEY=VALUE channel option from a channel configuration file into
+// ch. Returns an empty string on success or a description of the error
+static std::string parse_channel_option(const std::string &opt, Channel &ch) {
+    auto eq_pos = opt.find('=');
+    if (eq_pos == std::string::npos) return "Invalid option " + opt;
+
+    std::string        key = opt.substr(0, eq_pos);
+    std::string        value = opt.substr(eq_pos + 1);
+    std::istringstream iss(value);
+
+    if (key == "sql") {
+        float sql;
+        if (!(iss >> sql) || !iss.eof() || sql < 0.0f || sql > 50.0f) return "Invalid SQL level given: " + value;
+        ch.sql_level = sql;
+    } else if (key == "mod") {
+        Modulation mod = str_to_modulation(value);
+        if (mod == Modulation::UNSPECIFIED) return "Invalid modulation given: " + value;
+        ch.mod = mod;
+        ch.demod = Demod(mod);
+    } else if (key == "pan") {
+        int pos;
+        if (!(iss >> pos) || !iss.eof() || pos < -2 || pos > 2) return "Invalid audio position given: " + value;
+        ch.pos = pos;
+        ch.pos_fixed = true;
+    } else if (key == "prio") {
+        unsigned prio;
+        if (!(iss >> prio) || !iss.eof() || prio > 9) return "Invalid priority given: " + value;
+        ch.prio = prio;
+    } else if (key == "audio") {
+        if      (value == "on")  ch.audio = true;
+        else if (value == "off") ch.audio = false;
+        else return "Invalid audio given: " + value;
+    } else {
+        return "Unknown option " + key;
+    }
+
+    return std::string();
+}
+
+
+// Read channels from a channel configuration file. Each line holds one
+// channel followed by options:
+//
+//     CHANNEL[/SQL[/MOD]] [sql=LEVEL] [mod=AM|FM] [pan=POS] [prio=PRIO] [audio=on|off]
+//
+// A line on the form "group NAME [OPTIONS]" starts a new group of channels.
+// Options given on the group line are defaults for the channels in the
+// group. Empty lines and everything after # are ignored. Returns 0 on
+// success or -1 on error
+static int read_channels_file(const std::string &path, Settings &settings) {
+    std::ifstream file(path);
+    std::string   line;
+    unsigned      line_no = 0;
+    int           ret = 0;
+    Channel       defaults("", settings.sql_level, settings.mod);
+
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open channel file " << path << ".\n";
+        return -1;
+    }
+
+    while (std::getline(file, line)) {
+        std::istringstream iss(line.substr(0, line.find('#')));
+        std::string        token;
+        std::string        err;
+
+        ++line_no;
+
+        if (!(iss >> token)) continue;
+
+        if (token == "group") {
+            std::string name;
+            if (!(iss >> name)) {
+                err = "Missing group name";
+            } else {
+                defaults = Channel("", settings.sql_level, settings.mod);
+                defaults.group = settings.groups.size();
+                settings.groups.push_back(name);
+                while (err.empty() && iss >> token) err = parse_channel_option(token, defaults);
+            }
+        } else {
+            Channel ch = defaults;
+            float   sql = ch.sql_level;
+
+            err = parse_channel_arg(token, AERONAUTICAL_CHANNEL, ch.name, sql, ch.mod);
+            if (err.empty()) {
+                ch.sql_level = sql;
+                ch.demod = Demod(ch.mod);
+                while (err.empty() && iss >> token) err = parse_channel_option(token, ch);
+            }
+
+            if (err.empty()) {
+                if (std::find(settings.channels.begin(), settings.channels.end(), ch.name.c_str()) == settings.channels.end()) {
+                    settings.channels.push_back(ch);
+                } else {
+                    std::cerr << "Warning: " << path << ":" << line_no << ": Channel " << ch.name << " already given. Ignored.\n";
+                }
+            }
+        }
+
+        if (!err.empty()) {
+            std::cerr << "Error: " << path << ":" << line_no << ": " << err << ".\n";
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+
 // Parses the command line and fills the settings object. Checks that the
 // options and arguments are within limits. Returns 0 on success or < 0 on
 // parse/value error or if help was requested
@@ -1159,6 +2552,10 @@ static int parse_cmd_line(int argc, char **argv, class Settings &settings) {
     char         *sample_rate_str = nullptr;
     char         *gain_str = nullptr;
     char         *modulation_str = nullptr;
+    char         *ctl_socket = nullptr;
+    char         *channels_file = nullptr;
+    char         *status_str = nullptr;
+    char         *bench_file = nullptr;
     int           print_help = 0;
     int           normal_fq_fmt = 0;
     int           use_lf_agc = 0;
@@ -1167,6 +2564,15 @@ static int parse_cmd_line(int argc, char **argv, class Settings &settings) {
     int           compact = 0;
     int           use_ftfir = 0;
     int           use_threaded_ds = 0;
+    int           use_auto_plan = 0;
+    int           use_scan = 0;
+    int           pool_size = 0;
+    int           use_bench = 0;
+    int           use_timing = 0;
+    int           use_perf = 0;
+    int           use_deterministic = 0;
+    int           use_low_memory = 0;
+    char         *trace_file = nullptr;
 
     struct poptOption options_table[] = {
         { "list",        'l', POPT_ARG_NONE,   &list_devices, 0, "list available devices and their sample rates and quit", nullptr },
@@ -1177,10 +2583,30 @@ static int parse_cmd_line(int argc, char **argv, class Settings &settings) {
         { "sql-level",   's', POPT_ARG_FLOAT,  &settings.sql_level, 0, "squelch level in dB over channel noise floor. Can also be set per channel. Defaults to 9 if not set", "SQLLEVEL" },
         { "audio-dev",     0, POPT_ARG_STRING, &audio_device, 0, "ALSA audio device string. Defaults to 'default' if not set", "AUDIODEV" },
         { "sample-rate",   0, POPT_ARG_STRING, &sample_rate_str, 0, "sampel rate in MS/s. Defaults to 1.44 (RTL) or 6 (Airspy) if not set. Use --list to see valid rates", "RATE" },
+        { "auto",        'a', POPT_ARG_NONE,   &use_auto_plan, 0, "select lowest sample rate and best tuner frequency for the channels automatically", nullptr },
+        { "scan",          0, POPT_ARG_NONE,   &use_scan, 0, "scan channels that do not fit inside the bandwidth by cycling the tuner over several frequencies", nullptr },
+        { "scan-dwell",    0, POPT_ARG_INT,    &settings.scan_dwell, 0, "min time in ms on each scan frequency. Defaults to 200 if not set", "MS" },
+        { "scan-hang",     0, POPT_ARG_INT,    &settings.scan_hang, 0, "time in ms to stay on a scan frequency after the squelch has closed. Defaults to 2000 if not set", "MS" },
+        { "pool",          0, POPT_ARG_INT,    &pool_size, 0, "watch the channels with a wideband detector and only run NUM channels at a time. Disabled if not set", "NUM" },
+        { "pool-level",    0, POPT_ARG_FLOAT,  &settings.pool_level, 0, "detector level in dB over the noise floor for activating a channel. Defaults to 6 if not set", "LEVEL" },
+        { "pool-hang",     0, POPT_ARG_INT,    &settings.pool_hang, 0, "time in ms to keep a channel active after the detector level has been passed. Defaults to 2000 if not set", "MS" },
         { "modulation",    0, POPT_ARG_STRING, &modulation_str, 0, "modulation. AM or FM. Defaults to AM if not set. EXPERIMENTAL!", "MOD" },
         { "lf-agc",        0, POPT_ARG_NONE,   &use_lf_agc, 0, "enable post demodulation AGC. EXPERIMENTAL!", nullptr },
         { "ftfir",         0, POPT_ARG_NONE,   &use_ftfir, 0, "use frequency translation FIR. EXPERIMENTAL!", nullptr },
         { "threaded-ds", 't', POPT_ARG_NONE,   &use_threaded_ds, 0, "use dedicated threads for downsampling", nullptr },
+        { "low-memory",    0, POPT_ARG_NONE,   &use_low_memory, 0, "use less memory, for boards with little RAM. Tunes without translator tables and with a shorter audio buffer at some CPU cost", nullptr },
+        { "channels-file", 'f', POPT_ARG_STRING, &channels_file, 0, "read channels from a channel configuration file. Can be combined with channels on the command line", "FILE" },
+        { "status",        0, POPT_ARG_STRING, &status_str, 0, "channels in the status printout. all, open, page or grid. Defaults to all if not set", "MODE" },
+        { "ctl-socket",    0, POPT_ARG_STRING, &ctl_socket, 0, "Unix domain socket for runtime control of the channels. Disabled if not set", "PATH" },
+        { "max-channels",  0, POPT_ARG_INT,    &settings.max_channels, 0, "max number of channels when --ctl-socket is used. Defaults to 32 if not set", "NUM" },
+        { "bench",         0, POPT_ARG_NONE,   &use_bench, 0, "run the receiver offline as fast as possible on synthetic IQ and report the speed. No device or audio is used", nullptr },
+        { "bench-file",    0, POPT_ARG_STRING, &bench_file, 0, "run --bench on a raw IQ file with unsigned 8 bit samples, as written by rtl_sdr, instead of synthetic IQ", "FILE" },
+        { "bench-time",    0, POPT_ARG_INT,    &settings.bench_time, 0, "seconds of signal to run with --bench. Defaults to 10 if not set", "SEC" },
+        { "deterministic", 0, POPT_ARG_NONE,   &use_deterministic, 0, "run --bench single threaded and independent of the clock and print digests of the output of every channel, for bit exact comparison of two runs", nullptr },
+        { "timing",        0, POPT_ARG_NONE,   &use_timing, 0, "record latency histograms for the stages of the receiver and the end to end latency. Printed on SIGUSR1 or with the timing control command", nullptr },
+        { "perf",          0, POPT_ARG_NONE,   &use_perf, 0, "count CPU cycles, instructions, cache misses and branch misses for the stages of the receiver. Printed on exit and on SIGUSR1", nullptr },
+        { "metrics-port",  0, POPT_ARG_INT,    &settings.metrics_port, 0, "serve metrics in the Prometheus text format on http://HOST:PORT/metrics. Disabled if not set", "PORT" },
+        { "trace",         0, POPT_ARG_STRING, &trace_file, 0, "trace every block through the receiver and write a Chrome trace JSON file on exit and on SIGUSR2. Disabled if not set", "FILE" },
         { "bw-override",   0, POPT_ARG_NONE,   &bw_check_override, 0, "accept channels outside the 80% sample rate bandwidth limit. EXPERTS ONLY!", nullptr },
         { "verbose",       0, POPT_ARG_NONE,   &verbose, 0, "enable verbose printouts", nullptr },
         { "compact",       0, POPT_ARG_NONE,   &compact, 0, "enable compact printouts. Will override --verbose if given at the same time", nullptr },
@@ -1228,6 +2654,35 @@ static int parse_cmd_line(int argc, char **argv, class Settings &settings) {
 
         if (use_threaded_ds == 1) settings.use_threaded_ds = true;
 
+        if (use_low_memory == 1) {
+            settings.low_memory = true;
+
+            if (settings.use_ftfir) {
+                std::cerr << "Error: --low-memory and --ftfir can not be used at the same time.\n";
+                ret = -1;
+            }
+        }
+
+        if (use_timing == 1) settings.timing = true;
+
+        if (use_perf == 1) settings.perf = true;
+
+        if (trace_file) {
+            settings.trace_file = trace_file;
+            free(trace_file);
+        }
+
+        if (use_auto_plan == 1) settings.auto_plan = true;
+
+        if (use_scan == 1) {
+            settings.scan = true;
+
+            if (settings.auto_plan) {
+                std::cerr << "Error: --scan and --auto can not be used at the same time.\n";
+                ret = -1;
+            }
+        }
+
         // Collect and free string arguments if given
         if (device) {
             settings.device_serial = device;
@@ -1242,6 +2697,11 @@ static int parse_cmd_line(int argc, char **argv, class Settings &settings) {
         if (sample_rate_str) {
             settings.rate = str_to_sample_rate(std::string(sample_rate_str));
             free(sample_rate_str);
+
+            if (settings.auto_plan) {
+                std::cerr << "Error: --auto and --sample-rate can not be used at the same time.\n";
+                ret = -1;
+            }
         }
 
         if (modulation_str) {
@@ -1249,6 +2709,58 @@ static int parse_cmd_line(int argc, char **argv, class Settings &settings) {
             free(modulation_str);
         }
 
+        if (ctl_socket) {
+            settings.ctl_socket = ctl_socket;
+            free(ctl_socket);
+
+            if (settings.scan) {
+                std::cerr << "Error: --scan and --ctl-socket can not be used at the same time.\n";
+                ret = -1;
+            }
+        }
+
+        if (channels_file) {
+            settings.channels_file = channels_file;
+            free(channels_file);
+        }
+
+        if (bench_file) {
+            settings.bench_file = bench_file;
+            free(bench_file);
+            use_bench = 1;
+        }
+
+        if (use_bench == 1) {
+            settings.bench = true;
+
+            if (settings.auto_plan || settings.scan || !settings.ctl_socket.empty()) {
+                std::cerr << "Error: --bench can not be combined with --auto, --scan or --ctl-socket.\n";
+                ret = -1;
+            }
+        }
+
+        if (use_deterministic == 1) {
+            settings.deterministic = true;
+
+            if (!settings.bench) {
+                std::cerr << "Error: --deterministic can only be used with --bench.\n";
+                ret = -1;
+            }
+        }
+
+        if (status_str) {
+            std::string tmp_str = status_str;
+            if      (tmp_str == "all")  settings.status_mode = Settings::StatusMode::ALL;
+            else if (tmp_str == "open") settings.status_mode = Settings::StatusMode::OPEN;
+            else if (tmp_str == "page") settings.status_mode = Settings::StatusMode::PAGE;
+            else if (tmp_str == "grid") settings.status_mode = Settings::StatusMode::GRID;
+            else {
+                std::cerr << "Error: Invalid status mode given: " << tmp_str << ".\n";
+                ret = -1;
+            }
+            free(status_str);
+        }
+
         if (gain_str) {
             int ret;
             ret = sscanf(gain_str, "%u:%u:%u", &settings.lna_gain_idx, &settings.mix_gain_idx, &settings.vga_gain_idx);
@@ -1278,7 +2790,8 @@ separation and the new 8.33kHz channel separation notations are supported,
 i.e. 118.275 and 118.280 both mean the frequency 118.275 MHz.
 
 If multiple channels are given, they must all fit within a bandwidth of 80% of
-the sampling frequency.
+the sampling frequency. Channels can also be read from a channel configuration
+file given with --channels-file. See doc/USING.md for the file format.
 
 The squelch is adaptive with respect to the current, per channel, noise floor
 and the squelch level is given as a SNR value in dB. Audio is played using ALSA.
@@ -1324,74 +2837,92 @@ system:
                 std::cerr << "Error: Invalid modulation given.\n";
                 ret = -1;
             }
+            if (settings.max_channels < 1 || settings.max_channels > 256) {
+                std::cerr << "Error: Invalid max number of channels given: " << settings.max_channels << ".\n";
+                ret = -1;
+            }
+            if (settings.scan_dwell > 60000 || settings.scan_hang > 600000) {
+                std::cerr << "Error: Invalid scan dwell or hang time given.\n";
+                ret = -1;
+            }
+            if (pool_size < 0 || pool_size > MAX_POOL_SIZE) {
+                std::cerr << "Error: Invalid pool size given: " << pool_size << ". Max is " << MAX_POOL_SIZE << ".\n";
+                ret = -1;
+            } else if (pool_size > 0) {
+                settings.pool_size = pool_size;
+                if (settings.scan || !settings.ctl_socket.empty()) {
+                    std::cerr << "Error: --pool can not be combined with --scan or --ctl-socket.\n";
+                    ret = -1;
+                }
+            }
+            if (settings.pool_hang > 600000) {
+                std::cerr << "Error: Invalid pool hang time given.\n";
+                ret = -1;
+            }
+            if (settings.bench_time < 1 || settings.bench_time > 3600) {
+                std::cerr << "Error: Invalid benchmark time given.\n";
+                ret = -1;
+            }
+            if (settings.metrics_port < 0 || settings.metrics_port > 65535) {
+                std::cerr << "Error: Invalid metrics port given: " << settings.metrics_port << ".\n";
+                ret = -1;
+            } else if (settings.metrics_port > 0 && settings.bench) {
+                std::cerr << "Error: --metrics-port can not be combined with --bench.\n";
+                ret = -1;
+            }
+            if (!settings.trace_file.empty() && settings.bench) {
+                std::cerr << "Error: --trace can not be combined with --bench.\n";
+                ret = -1;
+            }
 
-            // Parse the arguments as channels
-            if (poptPeekArg(popt_ctx) != nullptr) {
-                bool fq_type = normal_fq_fmt ? NORMAL_FQ : AERONAUTICAL_CHANNEL;
-                const char *arg;
-                while ((arg = poptGetArg(popt_ctx)) != nullptr) {
-                    std::string ch_arg = arg;
-                    std::regex ch_regex("^([0-9]{3}\\.[0-9]{3})(?:\\/([0-9]{1,2})(?:\\/(AM|FM))?)?$", std::regex::ECMAScript);
-                    std::smatch ch_match;
-
-                    std::regex_search(ch_arg, ch_match, ch_regex);
-
-                    std::string fq_str;
-                    float sql = settings.sql_level;
-                    Modulation mod = settings.mod;
-
-                    if (ch_match.size() > 1) {
-                        fq_str = ch_match.str(1);
-                    }
-                    if (ch_match.size() > 2 && !ch_match.str(2).empty()) {
-                        sql = std::stof(ch_match.str(2));
-                    }
-                    if (ch_match.size() > 3 && !ch_match.str(3).empty()) {
-                        mod = str_to_modulation(ch_match.str(3));
-                    }
+            bool fq_type = normal_fq_fmt ? NORMAL_FQ : AERONAUTICAL_CHANNEL;
 
-                    uint32_t fq_ret = parse_fq(fq_str, fq_type);
-                    if (fq_ret == 0) {
-                        std::cerr << "Error: Invalid " << (fq_type == NORMAL_FQ ? "frequency":"channel") <<
-                                     " given: " << fq_str << ". Use --help to learn how to use sdrx.\n";
-                        ret = -1;
-                    } else if (fq_ret < 45000000 || fq_ret > 1800000000) {
-                        std::cerr << "Error: Invalid frequency given: " << fq_ret << "Hz. Use --help to learn how to use sdrx.\n";
-                        ret = -1;
-                    } else if (sql < 0.0f || sql > 50.0f) {
-                        std::cerr << "Error: Invalid SQL level given: " << sql << ". Use --help to learn how to use sdrx.\n";
-                        ret = -1;
-                    } else {
-                        // Add to channels list if not already present
-                        if (std::find(settings.channels.begin(), settings.channels.end(), fq_str) == settings.channels.end()) {
-                            settings.channels.push_back(Channel(fq_str, sql, mod));
-                        }
+            // Read the channel file first, if given
+            if (!settings.channels_file.empty() && read_channels_file(settings.channels_file, settings) < 0) {
+                ret = -1;
+            }
+
+            // Parse the arguments as channels
+            const char *arg;
+            while ((arg = poptGetArg(popt_ctx)) != nullptr) {
+                std::string fq_str;
+                float sql = settings.sql_level;
+                Modulation mod = settings.mod;
+
+                std::string err = parse_channel_arg(arg, fq_type, fq_str, sql, mod);
+                if (!err.empty()) {
+                    std::cerr << "Error: " << err << ". Use --help to learn how to use sdrx.\n";
+                    ret = -1;
+                } else {
+                    // Add to channels list if not already present
+                    if (std::find(settings.channels.begin(), settings.channels.end(), fq_str) == settings.channels.end()) {
+                        settings.channels.push_back(Channel(fq_str, sql, mod));
                     }
                 }
+            }
 
-                if (settings.channels.size() > 0) {
-                    if (settings.channels.size() > 1 && fq_type == NORMAL_FQ) {
-                        std::cerr << "Error: Only one frequency allowed in frequency mode.\n";
-                        ret = -1;
-                    } else {
-                        // If here, we know that all channels in settings.channels
-                        // are valid aeronautical and that we have at least one
-                        // channel. Sort the vector and determine what tuner
-                        // frequency to use (round to nearest 100kHz)
-                        std::vector<Channel> tmp_channels = settings.channels;
-                        std::sort(tmp_channels.begin(), tmp_channels.end());
-                        std::string lo_ch = (tmp_channels.begin())->name;
-                        std::string hi_ch = (--tmp_channels.end())->name;
-
-                        double lo_fq = (double)parse_fq(lo_ch, fq_type);
-                        double hi_fq = (double)parse_fq(hi_ch, fq_type);
-                        double mid_fq = lo_fq + (hi_fq - lo_fq) / 2;
-                        double mid_fq_rounded = std::round(mid_fq / 100000.0) * 100000.0;
-
-                        settings.tuner_fq = (uint32_t)mid_fq_rounded;
-                    }
+            if (settings.channels.size() > 0) {
+                if (settings.channels.size() > 1 && fq_type == NORMAL_FQ) {
+                    std::cerr << "Error: Only one frequency allowed in frequency mode.\n";
+                    ret = -1;
+                } else {
+                    // If here, we know that all channels in settings.channels
+                    // are valid aeronautical and that we have at least one
+                    // channel. Sort the vector and determine what tuner
+                    // frequency to use (round to nearest 100kHz)
+                    std::vector<Channel> tmp_channels = settings.channels;
+                    std::sort(tmp_channels.begin(), tmp_channels.end());
+                    std::string lo_ch = (tmp_channels.begin())->name;
+                    std::string hi_ch = (--tmp_channels.end())->name;
+
+                    double lo_fq = (double)parse_fq(lo_ch, fq_type);
+                    double hi_fq = (double)parse_fq(hi_ch, fq_type);
+                    double mid_fq = lo_fq + (hi_fq - lo_fq) / 2;
+                    double mid_fq_rounded = std::round(mid_fq / 100000.0) * 100000.0;
+
+                    settings.tuner_fq = (uint32_t)mid_fq_rounded;
                 }
-            } else {
+            } else if (ret == 0 && !settings.bench) {
                 std::cerr << "Error: No channel given. Use --help to learn how to use sdrx.\n";
                 ret = -1;
             }
@@ -1427,313 +2958,1417 @@ static bool verify_requested_bandwidth(const Settings &settings) {
 }
 
 
-// Given a channel and tuner center frequency, return how many 8.33kHz steps
-// the channel is with respect to the tuner center
-static int channel_to_offset(const std::string &channel, int32_t tuner_fq) {
-    int32_t fq_base;
-    int32_t fq_diff;
-    int32_t offset_diff;
-    int     offset;
-
-    // Dot is used as decimal separator
-    auto dot_pos  = channel.find_first_of('.');
-    auto int_str  = channel.substr(0, dot_pos); // integral part
-    auto frac_str = channel.substr(dot_pos+1);  // fractional part
-
-    // A 100kHz wide band "contains" 12 8.33kHz channels or 4 25kHz
-    // channels. Each channel has it's unique two digits making it
-    // possible to correctly convert a channel to offset in both schemas
-    const std::map<std::string, int> sub_ch_map{
-        { "00",  0 }, { "05",  0 }, { "10",  1 }, { "15",  2 },
-        { "25",  3 }, { "30",  3 }, { "35",  4 }, { "40",  5 },
-        { "50",  6 }, { "55",  6 }, { "60",  7 }, { "65",  8 },
-        { "75",  9 }, { "80",  9 }, { "85", 10 }, { "90", 11 }
-    };
-    auto sub_offset = sub_ch_map.find(frac_str.substr(1));
+// Check that a channel is inside the usable bandwidth around the tuner
+// frequency
+static bool channel_in_bandwidth(const Settings &settings, const std::string &channel) {
+    if (settings.bw_check_override) return true;
+
+    return channel_in_bandwidth(channel, settings.tuner_fq, settings.rate);
+}
+
 
-    fq_base = std::atol(int_str.c_str())*1000000;
-    fq_base += (frac_str[0] - '0') * 100000;
-    fq_diff = fq_base - tuner_fq;
-    offset_diff = (fq_diff / 100000)*12;
-    offset = offset_diff + sub_offset->second;
+// Setup the parts of a channel that work on the down sampled signal
+static void setup_channel_agc(Channel &ch, const Settings &settings) {
+    ch.ch_flt = FIR3<iqsample_t>(fs_00016_16bit_ch_amdemod_lpf1);
 
-    return offset;
+    Receiver::setupAgc(ch.agc, ch.agc_lf, settings.use_lf_agc);
 }
 
 
-// Get info for first available device on the system
-static R820Dev::Info get_first_avaialble_device(void) {
-    R820Dev::Info              device;
-    std::vector<R820Dev::Info> devices;
+// Down sampler with "tuner" for a channel at a tuner frequency. With
+// --low-memory the channel is tuned with an oscillator instead of a
+// translator table
+static MSD make_down_sampler(const std::string &name, uint32_t tuner_fq, const Settings &settings, const RatePlan &plan) {
+    if (settings.low_memory) return MSD(make_oscillator(name, tuner_fq, plan), plan.stages);
 
-    device.type = R820Dev::Type::UNKNOWN;
+    return MSD(make_translator(name, tuner_fq, plan, settings.use_ftfir), plan.stages, settings.use_ftfir);
+}
 
-    devices = R820Dev::list();
-    for (auto &dev : devices) {
-        if (dev.supported && dev.available) {
-            device = dev;
-            break;
-        }
+
+// Setup a channel with "tuner", down sampler and AGC for the rate plan in use
+static void setup_channel(Channel &ch, const Settings &settings, const RatePlan &plan) {
+    uint32_t tuner_fq = settings.scan_fqs.empty() ? settings.tuner_fq : settings.scan_fqs[ch.window];
+
+    ch.msd = make_down_sampler(ch.name, tuner_fq, settings, plan);
+
+    if (settings.use_threaded_ds) {
+        // The thread has its own copy of the down sampler
+        ch.ds_ptr = new DS(ch.msd);
+        ch.msd = MSD();
     }
 
-    return device;
+    setup_channel_agc(ch, settings);
 }
 
 
-int main(int argc, char** argv) {
-    int              ret;
-    struct sigaction sigact;
-    Settings         settings;
+// Drop the down samplers from a copy of the channels where only the names and
+// parameters are used. The down samplers are owned by the input thread
+static void drop_down_samplers(std::vector<Channel> &channels) {
+    for (auto &ch : channels) {
+        ch.msd = MSD();
+        ch.ds_ptr = nullptr;
+    }
+}
 
-    // Parse command line. Exit if incomplete, help requested or device list requested
-    ret = parse_cmd_line(argc, argv, settings);
-    if (ret < 0) {
-        if (ret == -2) {
-            // List devices and exit
-            list_available_devices();
-            return 0;
-        }
 
-        return 1;
-    }
+// Blocks in the input -> output ring buffer
+static unsigned rb_chunks(const Settings &settings) {
+    return settings.low_memory ? IQ_RB_CHUNKS_LOW_MEM : IQ_RB_CHUNKS;
+}
 
-    if (settings.device_serial == "") {
-        // No serial given on command line. Find out serial for first available device
-        std::cout << "Searching for first available device...\n";
-        R820Dev::Info info = get_first_avaialble_device();
 
-        if (info.type == R820Dev::Type::UNKNOWN) {
-            std::cerr << "Error: No device available.\n";
-            return 1;
-        }
+// FFT size for the pool detector. Gives bins no wider than 1kHz
+static unsigned pool_detector_size(SampleRate rate) {
+    unsigned size = 256;
+    while (size < sample_rate_to_uint(rate) / 1000) size *= 2;
 
-        settings.device_serial = info.serial;
+    return size;
+}
 
-        std::cout << "Found device " << settings.device_serial << " (" << R820Dev::typeToStr(info.type) << ")\n";
 
-        if (settings.rate == SampleRate::UNSPECIFIED) {
-            // Sample rate not given on command line (or given but invalid).
-            // Use default for the device choosen
-            settings.rate = info.default_sample_rate;
-        }
-    }
+// Set up the channel pool. The channels in settings become candidates for the
+// detector and are replaced by settings.pool_size down samplers without
+// translators
+static void setup_pool(PoolState &pool, Settings &settings, const RatePlan &plan) {
+    double fs = sample_rate_to_uint(settings.rate);
 
-    settings.device_type = R820Dev::getType(settings.device_serial);
-    if (settings.device_type == R820Dev::Type::UNKNOWN) {
-        std::cerr << "Error: Device " << settings.device_serial << " is not available.\n";
-        return 1;
-    }
+    pool.candidates = std::move(settings.channels);
+    settings.channels.clear();
 
-    // Set default sample rate if not given. TODO: Refactor this to something better...
-    if (settings.rate == SampleRate::UNSPECIFIED && settings.device_type == R820Dev::Type::RTL) {
-        settings.rate = SampleRate::FS01440;
-    } else if (settings.rate == SampleRate::UNSPECIFIED && settings.device_type == R820Dev::Type::AIRSPY) {
-        settings.rate = SampleRate::FS06000;
-    }
+    for (unsigned c = 0; c < pool.candidates.size(); ++c) {
+        const Channel &cand = pool.candidates[c];
+        int64_t        offset = (int64_t)parse_fq(cand.name, AERONAUTICAL_CHANNEL) - (int64_t)settings.tuner_fq;
 
-    // Verify that the requested sample rate is supported by the requested
-    // device type
-    if (!R820Dev::rateSupported(settings.device_serial, settings.rate)) {
-        std::cerr << "Error: Sample rate " << sample_rate_to_str(settings.rate) << "MS/s is not supported by device " << settings.device_serial << std::endl;
-        return 1;
+        pool.tuners.push_back(make_down_sampler(cand.name, settings.tuner_fq, settings, plan));
+        pool.bins.push_back(pool.detector.bin(offset, fs));
+        pool.slots.push_back(-1);
+        pool.quiet.push_back(UINT_MAX);
+        pool.order.push_back(c);
     }
-
-    if (!verify_requested_bandwidth(settings)) {
-        uint32_t available_bw = (sample_rate_to_uint(settings.rate) * 8 / 10) / 1000;
-        std::cerr << "Error: Requested channels does not fit inside available bandwidth (" << available_bw << "kHz).\n";
-        return 1;
+    std::stable_sort(pool.order.begin(), pool.order.end(), [&pool](unsigned a, unsigned b) {
+        return pool.candidates[a].prio > pool.candidates[b].prio;
+    });
+
+    // About +/-2.8kHz, same as the squelch
+    pool.half_width  = std::max(1, (int)std::lround(2800.0 * pool.detector.size() / fs));
+    pool.hang_blocks = settings.pool_hang / 32; // One block is 32ms
+    pool.level       = settings.pool_level;
+    pool.owners.fill(-1);
+
+    for (unsigned slot = 0; slot < settings.pool_size; ++slot) {
+        Channel ch;
+        setup_channel(ch, settings, plan);
+        settings.channels.push_back(std::move(ch));
     }
+}
 
-    // Determine lenght of translator based on Fs and set up down sampling
-    // filters. N and z depends on the IQ sampling fq:
-    //
-    //     N = Fs * z / 8333.33333
-    //
-    // N must be an even number.
-    //
-    // Fs(Ms/s)    N      z
-    // --------------------
-    //  0.96       576    5
-    //  1.2        144    1
-    //  1.44      1728   10
-    //  1.6        192    1
-    //  1.92      1152    5
-    //  2.4        288    1
-    //  2.56      1536    5
-    //  6.0        720    1
-    // 10.0       1200    1
-    //
-    // Note: If z != 1, ch_offset must be multiplied with z also.
-    int N;
-    int z;
-    std::vector<MSD::Stage> stages;
-
-    switch (settings.rate) {
-        case SampleRate::FS00960:
-            N =  576; z = 5;
-            stages = std::vector<MSD::Stage>{
-                { 3, fs_00960_08bit_ds_lpf1_00960_to_00320 },
-                { 4, fs_00960_08bit_ds_lpf2_00320_to_00080 },
-                { 5, fs_00960_08bit_ds_lpf3_00080_to_00016 }
-            };
-            break;
-        case SampleRate::FS01200:
-            N =  144; z = 1;
-            stages = std::vector<MSD::Stage>{
-                { 3, fs_01200_08bit_ds_lpf1_01200_to_00400 },
-                { 5, fs_01200_08bit_ds_lpf2_00400_to_00080 },
-                { 5, fs_01200_08bit_ds_lpf3_00080_to_00016 }
-            };
-            break;
-        case SampleRate::FS01440:
-            N = 1728; z = 10;
-            stages = std::vector<MSD::Stage>{
-                { 3, fs_01440_08bit_ds_lpf1_01440_to_00400 },
-                { 6, fs_01440_08bit_ds_lpf2_00480_to_00080 },
-                { 5, fs_01440_08bit_ds_lpf3_00080_to_00016 }
-            };
-            break;
-        case SampleRate::FS01600:
-            N =  192; z = 1;
-            stages = std::vector<MSD::Stage>{
-                { 4, fs_01600_08bit_ds_lpf1_01600_to_00400 },
-                { 5, fs_01600_08bit_ds_lpf2_00400_to_00080 },
-                { 5, fs_01600_08bit_ds_lpf3_00080_to_00016 }
-            };
-            break;
-        case SampleRate::FS01920:
-            N = 1152; z = 5;
-            stages = std::vector<MSD::Stage>{
-                { 4, fs_01920_08bit_ds_lpf1_01920_to_00480 },
-                { 6, fs_01920_08bit_ds_lpf2_00480_to_00080 },
-                { 5, fs_01920_08bit_ds_lpf3_00080_to_00016 }
-            };
-            break;
-        case SampleRate::FS02400:
-            N =  288; z = 1;
-            stages = std::vector<MSD::Stage>{
-                { 2, fs_02400_08bit_ds_lpf1_02400_to_01200 },
-                { 3, fs_02400_08bit_ds_lpf2_01200_to_00400 },
-                { 5, fs_02400_08bit_ds_lpf3_00400_to_00080 },
-                { 5, fs_02400_08bit_ds_lpf4_00080_to_00016 }
-            };
-            break;
-        case SampleRate::FS02500:
-            N = 300; z = 1;
-            break;
-        case SampleRate::FS02560:
-            N = 1536; z = 5; // will not work for fq trans fir... Can be solved with a 16, 5, 2 stage layout
-            stages = std::vector<MSD::Stage>{
-                { 20, fs_02560_08bit_ds_lpf1_02560_to_00128 },
-                {  4, fs_02560_08bit_ds_lpf2_00128_to_00032 },
-                {  2, fs_02560_08bit_ds_lpf4_00032_to_00016 }
-            };
-            break;
-        case SampleRate::FS03000:
-            N = 360; z = 1;
-            break;
-        case SampleRate::FS06000:
-            N = 720; z = 1;
-            stages = std::vector<MSD::Stage>{
-                { 15, fs_06000_12bit_ds_lpf1_06000_to_00400 },
-                {  5, fs_06000_12bit_ds_lpf3_00400_to_00080 },
-                {  5, fs_06000_12bit_ds_lpf4_00080_to_00016 }
-            };
-            break;
-        case SampleRate::FS10000:
-            N = 1200; z = 1;
-            stages = std::vector<MSD::Stage>{
-                { 5, fs_10000_12bit_ds_lpf1_10000_to_02000 },
-                { 5, fs_10000_12bit_ds_lpf2_02000_to_00400 },
-                { 5, fs_10000_12bit_ds_lpf3_00400_to_00800 },
-                { 5, fs_10000_12bit_ds_lpf4_00080_to_00016 }
-            };
-            break;
-        default:
-            N = 0; z = 1;
-            break;
-    }
 
-    if (N == 0 || stages.empty()) {
-        std::cerr << "Error: Sample rate " << sample_rate_to_str(settings.rate) << " MS/s is not supported yet (work in progress).\n";
-        return 1;
-    }
+// Split the channels into scan windows that each fit inside the bandwidth of
+// the sample rate. Channels are assigned to windows in frequency order and
+// every window gets a tuner frequency on the 100kHz grid in the middle of its
+// channels. The span of a window is limited to 80% of the sample rate less
+// 100kHz so that the rounding of the tuner frequency keeps all channels
+// inside
+static void make_scan_windows(Settings &settings) {
+    std::vector<Channel*> sorted;
+    int64_t               max_span = sample_rate_to_uint(settings.rate) * 8 / 10 - 100000;
+    int64_t               lo_fq = 0;
+    int64_t               hi_fq = 0;
+
+    for (auto &ch : settings.channels) sorted.push_back(&ch);
+    std::sort(sorted.begin(), sorted.end(), [](Channel *a, Channel *b) { return *a < *b; });
+
+    auto close_window = [&settings, &lo_fq, &hi_fq](void) {
+        double mid_fq = lo_fq + (hi_fq - lo_fq) / 2.0;
+        settings.scan_fqs.back() = (uint32_t)(std::round(mid_fq / 100000.0) * 100000.0);
+    };
 
-    // Setup the channels with "tuner", down sampler, AGC and audio position
-    unsigned ch_idx = 0;
-    for (auto &ch : settings.channels) {
-        std::vector<iqsample_t> translator;
+    settings.scan_fqs.clear();
+    for (auto ch_ptr : sorted) {
+        int64_t fq = parse_fq(ch_ptr->name, AERONAUTICAL_CHANNEL);
 
-        int ch_offset = channel_to_offset(ch.name, (int32_t)settings.tuner_fq);
-        if (ch_offset != 0) {
-            for (int n = 0; n < N; n++) {
-                std::complex<float> e(0.0f, -2.0f * M_PI * n * ch_offset * (float)z/(float)N);
-                translator.push_back(exp(e));
-            }
+        if (settings.scan_fqs.empty() || fq - lo_fq > max_span) {
+            if (!settings.scan_fqs.empty()) close_window();
+            settings.scan_fqs.push_back(0);
+            lo_fq = fq;
         }
 
-        ch.msd = MSD(translator, stages, settings.use_ftfir);
+        hi_fq = fq;
+        ch_ptr->window = settings.scan_fqs.size() - 1;
+    }
+    close_window();
 
-        if (settings.use_threaded_ds) {
-            ch.ds_ptr = new DS(ch.msd);
-        }
+    settings.tuner_fq = settings.scan_fqs.front();
+}
 
-        ch.ch_flt = FIR3<iqsample_t>(fs_00016_16bit_ch_amdemod_lpf1);
 
-        ch.agc.setReference(1.0f);
-        ch.agc.setAttack(1.0f);
-        ch.agc.setDecay(0.01f);
-        ch.agc.setMaxGain(300);
+// Move the tuner to the next window. Called in the event loop of the main
+// thread when the output thread reports the current window as idle
+static void scan_step(ScanState &scan) {
+    unsigned window = scan.next.load(std::memory_order_relaxed);
+    if (scan.idle.load(std::memory_order_acquire) != (int)window) return;
+    scan.idle.store(-1, std::memory_order_relaxed);
 
-        ch.agc_lf.setReference(1.0f);
-        ch.agc_lf.setAttack(1.0f);
-        ch.agc_lf.setDecay(0.01f);
-        if (settings.use_lf_agc) ch.agc_lf.activate();
+    unsigned next = (window + 1) % scan.fqs.size();
 
-        ch.pos = get_audio_pos(ch_idx, settings.channels.size());
-        ++ch_idx;
-    }
+    // Make the input thread discard blocks before the tuner changes
+    // frequency
+    scan.tuned.store(false, std::memory_order_release);
+    scan.next.store(next, std::memory_order_release);
 
-    // Print settings
-    std::cout << "The folowing settings are being used:\n";
-    std::cout << "    Device: " << settings.device_serial << " (" << R820Dev::typeToStr(settings.device_type) << ")\n";
-    if (settings.device_type == R820Dev::Type::RTL) {
-        std::cout << "    Frequency correction: " << settings.fq_corr << "ppm\n";
-    }
-    std::cout << "    Sampling frequency: " << sample_rate_to_str(settings.rate) << "MS/s\n";
-    if (settings.gain_mode == Settings::GainMode::COMPOSITE) {
-        std::cout << "    RF gain: " << settings.composit_gain << "dB\n";
-    } else {
-        std::cout << "    RF gain indexes: " << settings.lna_gain_idx << ":" << settings.mix_gain_idx << ":" << settings.vga_gain_idx << std::endl;
-    }
-    std::cout << "    Modulation: " << modulation_to_str(settings.mod) << std::endl;
-    std::cout << "    Volume: " << settings.lf_gain << "dB\n";
-    std::cout << "    Squelch level: " << settings.sql_level << "dB\n";
-    std::cout << "    Audio AGC: " << (settings.use_lf_agc ? "On":"Off") << std::endl;
-    std::cout << "    Frequency Translating FIR: " << (settings.use_ftfir ? "On":"Off") << std::endl;
-    std::cout << "    ALSA device: " << settings.audio_device << std::endl;
-    std::cout << "    Tuner center frequency: " << settings.tuner_fq/1000 << " kHz\n";
-    std::cout << "    Bandwidth: +/-" << (sample_rate_to_uint(settings.rate) * 8 / 20)/1000 << " kHz relative to center frequency\n";
-    std::cout << "    Channels:";
-    for (auto &ch : settings.channels) {
-        std::cout << " " << ch.name << "/" << ch.sql_level << "/" << modulation_to_str(ch.mod) << "(" << ch.pos << ")";
+    if (scan.device_ptr->setFq(scan.fqs[next]) < 0) {
+        std::cerr << "Warning: Unable to set tuner frequency to " << scan.fqs[next]/1000 << " kHz. Staying on current scan window.\n";
+        scan.next.store(window, std::memory_order_release);
     }
-    std::cout << std::endl;
 
-    rb_t iq_rb(CH_IQ_BUF_SIZE * settings.channels.size(), 8); // 8 chunks or 256ms
+    scan.tuned.store(true, std::memory_order_release);
+}
 
-    struct InputState input_state;
-    input_state.settings   = settings;
-    input_state.rb_ptr     = &iq_rb;
 
-    // Create tuner class instance
-    R820Dev *device = R820Dev::create(settings.device_type, settings.device_serial, settings.rate, settings.fq_corr);
-    if (device == nullptr) {
-        std::cerr << "Error: Unable to create device instance.\n";
-        return 1;
+// Estimated down sampling cost for one channel in real multiply-accumulate
+// operations per second
+static double channel_cost(int ch_offset, SampleRate rate, const RatePlan &plan, bool use_ftfir) {
+    double fs = sample_rate_to_uint(rate);
+    double cost = 0.0;
+
+    // Translator. One complex multiplication per input sample
+    if (ch_offset != 0 && !use_ftfir) cost += 4.0 * fs;
+
+    for (auto &stage : plan.stages) {
+        fs /= stage.m;
+        if (&stage == &plan.stages.front() && ch_offset != 0 && use_ftfir) {
+            // Complex coefficients
+            cost += 4.0 * fs * stage.h.size();
+        } else {
+            // Real and symmetric coefficients (folded FIR)
+            cost += 2.0 * fs * (stage.h.size() + 1) / 2;
+        }
     }
 
-    // Set up the instance
+    return cost;
+}
+
+
+// Memory in bytes for the translator and frequency translating FIR
+// coefficient sets for one channel
+static size_t channel_coeff_mem(int ch_offset, const RatePlan &plan, bool use_ftfir) {
+    size_t len = translator_len(ch_offset, plan, use_ftfir);
+    size_t mem = len * sizeof(iqsample_t);
+
+    if (use_ftfir) mem += (len / plan.stages.front().m) * plan.stages.front().h.size() * sizeof(iqsample_t);
+
+    return mem;
+}
+
+
+// Select sample rate and tuner frequency automatically. The lowest sample
+// rate supported by the device that fits all channels, with margin to DC and
+// to the band edges, is used. Of the tuner frequencies on the 100kHz grid
+// that fit, the one with the lowest estimated down sampling cost is choosen.
+// Ties are broken by the distance to the middle of the channels and then by
+// the least coefficient memory. Returns false if no plan fits
+static bool auto_plan(Settings &settings) {
+    int64_t lo_fq = INT64_MAX;
+    int64_t hi_fq = 0;
+
+    for (auto &ch : settings.channels) {
+        int64_t fq = parse_fq(ch.name, AERONAUTICAL_CHANNEL);
+        if (fq < lo_fq) lo_fq = fq;
+        if (fq > hi_fq) hi_fq = fq;
+    }
+
+    int64_t mid_fq = lo_fq + (hi_fq - lo_fq) / 2;
+
+    for (int r = 0; r < (int)SampleRate::UNSPECIFIED; ++r) {
+        SampleRate rate = (SampleRate)r;
+
+        if (!R820Dev::rateSupported(settings.device_serial, rate)) continue;
+
+        RatePlan plan = get_rate_plan(rate);
+        if (plan.N == 0 || plan.stages.empty()) continue;
+
+        int64_t half_bw = sample_rate_to_uint(rate) * 8 / 20 - AUTO_EDGE_GUARD;
+        int64_t best_fq = 0;
+        double  best_cost = 0.0;
+        size_t  best_mem = 0;
+
+        // All channels must be within +/- half_bw from the tuner frequency
+        int64_t first_fq = ((hi_fq - half_bw + 99999) / 100000) * 100000;
+        for (int64_t tuner_fq = first_fq; tuner_fq <= lo_fq + half_bw; tuner_fq += 100000) {
+            double cost = 0.0;
+            size_t mem = 0;
+            bool   ok = true;
+
+            for (auto &ch : settings.channels) {
+                if (std::abs(parse_fq(ch.name, AERONAUTICAL_CHANNEL) - tuner_fq) < AUTO_DC_GUARD) {
+                    ok = false;
+                    break;
+                }
+
+                int ch_offset = channel_to_offset(ch.name, (int32_t)tuner_fq);
+                cost += channel_cost(ch_offset, rate, plan, settings.use_ftfir);
+                mem  += channel_coeff_mem(ch_offset, plan, settings.use_ftfir);
+            }
+            if (!ok) continue;
+
+            int64_t dist = std::abs(tuner_fq - mid_fq);
+            int64_t best_dist = std::abs(best_fq - mid_fq);
+            if (best_fq == 0 || cost < best_cost ||
+                (cost == best_cost && dist < best_dist) ||
+                (cost == best_cost && dist == best_dist && mem < best_mem)) {
+                best_fq   = tuner_fq;
+                best_cost = cost;
+                best_mem  = mem;
+            }
+        }
+
+        if (best_fq != 0) {
+            settings.rate     = rate;
+            settings.tuner_fq = (uint32_t)best_fq;
+
+            std::cout << "Automatic rate plan:\n";
+            std::cout << "    Sample rate: " << sample_rate_to_str(rate) << "MS/s\n";
+            std::cout << "    Tuner center frequency: " << best_fq/1000 << " kHz\n";
+            std::cout << "    Estimated down sampling cost: " << std::fixed << std::setprecision(1) << best_cost / 1e6
+                      << " MMAC/s for " << settings.channels.size() << " channel" << (settings.channels.size() > 1 ? "s" : "") << "\n";
+            std::cout << "    Translator and coefficient memory: " << best_mem / 1024.0 << " kB\n";
+            std::cout << std::defaultfloat << std::setprecision(6);
+            if (settings.verbose_printout) {
+                for (auto &ch : settings.channels) {
+                    int ch_offset = channel_to_offset(ch.name, (int32_t)best_fq);
+                    std::cout << "        " << ch.name << ": offset " << ch_offset << " (" << ch_offset * 8333.33333 / 1000.0
+                              << " kHz), translator length " << translator_len(ch_offset, plan, settings.use_ftfir) << "\n";
+                }
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+// Estimated cost, in real multiply-accumulates per second, of the stages of
+// the receiver. Demodulation, AGC and mixing are left out since they are
+// small in comparison
+struct PipelineCost {
+    double channelize = 0.0;    // Down sampling, and the pool detector if used
+    double max_channel = 0.0;   // Down sampling of the most expensive channel
+    double squelch = 0.0;       // Squelch FFTs
+    double audio = 0.0;         // Audio filter
+
+    double total(void) const { return channelize + squelch + audio; }
+};
+
+
+// A complex FFT of size n needs about 5n*log2(n) flops, or half as many MACs
+static double fft_cost(unsigned n) {
+    return 2.5 * n * std::log2(n) * 1e9 / BLOCK_TIME_NS;
+}
+
+
+// Cost of the receiver with the channels in settings at the given rate. When
+// scanning, the most expensive scan window is used. With a channel pool, all
+// down samplers are assumed to be busy with the most expensive channel
+static PipelineCost pipeline_cost(const Settings &settings, SampleRate rate) {
+    PipelineCost cost;
+    RatePlan     plan = get_rate_plan(rate);
+    unsigned     num_windows = std::max<size_t>(settings.scan_fqs.size(), 1);
+    unsigned     num_channels = 0;
+
+    for (unsigned window = 0; window < num_windows; ++window) {
+        uint32_t tuner_fq = settings.scan_fqs.empty() ? settings.tuner_fq : settings.scan_fqs[window];
+        double   window_cost = 0.0;
+        unsigned window_channels = 0;
+
+        for (auto &ch : settings.channels) {
+            if (!settings.scan_fqs.empty() && ch.window != window) continue;
+
+            double ch_cost = channel_cost(channel_to_offset(ch.name, (int32_t)tuner_fq), rate, plan, settings.use_ftfir);
+            cost.max_channel = std::max(cost.max_channel, ch_cost);
+            window_cost += ch_cost;
+            ++window_channels;
+        }
+
+        cost.channelize = std::max(cost.channelize, window_cost);
+        num_channels = std::max(num_channels, window_channels);
+    }
+
+    if (settings.pool_size > 0) {
+        num_channels = settings.pool_size;
+        cost.channelize = settings.pool_size * cost.max_channel + 4 * fft_cost(pool_detector_size(rate));
+    }
+
+    cost.squelch = num_channels * fft_cost(FFT_SIZE);
+    cost.audio = 2.0 * coeff_bp4am_channel.size() * CH_IQ_BUF_SIZE * 1e9 / BLOCK_TIME_NS;
+
+    return cost;
+}
+
+
+// Measure the MACs per second that one core sustains in the down sampler by
+// running one channel on noise for CPU_CALIBRATION_MS ms of CPU time. The
+// first block warms up the caches and is not counted
+static double calibrate_mac_rate(SampleRate rate, const RatePlan &plan, bool use_ftfir) {
+    unsigned m = 1;
+    for (auto &stage : plan.stages) m *= stage.m;
+
+    std::vector<iqsample_t> in(CH_IQ_BUF_SIZE * m);
+    std::vector<iqsample_t> out(CH_IQ_BUF_SIZE);
+    uint32_t                seed = 1;
+
+    for (auto &sample : in) {
+        seed = seed * 1664525u + 1013904223u;
+        float re = (float)(seed >> 8) / (float)(1u << 24) - 0.5f;
+        seed = seed * 1664525u + 1013904223u;
+        sample = iqsample_t(re, (float)(seed >> 8) / (float)(1u << 24) - 0.5f);
+    }
+
+    MSD msd(make_translator(1, plan, use_ftfir), plan.stages, use_ftfir);
+    msd.decimate(in.data(), in.size(), out.data());
+
+    unsigned blocks = 0;
+    uint64_t start = thread_cpu_time();
+    uint64_t elapsed;
+    do {
+        msd.decimate(in.data(), in.size(), out.data());
+        ++blocks;
+        elapsed = thread_cpu_time() - start;
+    } while (elapsed < CPU_CALIBRATION_MS * 1000000ull);
+
+    return channel_cost(1, rate, plan, use_ftfir) * blocks * BLOCK_TIME_NS / elapsed;
+}
+
+
+// Print the estimated CPU load of the configured receiver. Warn, and suggest
+// something cheaper, if it is likely to be more than the host can take
+static void print_cpu_budget(const Settings &settings, const RatePlan &plan) {
+    PipelineCost cost = pipeline_cost(settings, settings.rate);
+    double       mac_rate = calibrate_mac_rate(settings.rate, plan, settings.use_ftfir);
+    unsigned     cores = std::max(std::thread::hardware_concurrency(), 1u);
+
+    // With threaded down sampling, every channel has a thread of its own
+    double input_load  = (settings.use_threaded_ds ? cost.max_channel : cost.channelize) / mac_rate * 100.0;
+    double output_load = (cost.squelch + cost.audio) / mac_rate * 100.0;
+    double total_load  = cost.total() / mac_rate * 100.0;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "    CPU budget: " << cost.total() / 1e6 << " MMAC/s (channels " << cost.channelize / 1e6
+              << ", squelch " << cost.squelch / 1e6 << ", audio filter " << cost.audio / 1e6 << ")\n";
+    std::cout << "    Estimated CPU load: " << std::setprecision(0) << input_load << "% input thread, "
+              << output_load << "% output thread, " << total_load << "% in total of " << cores << " core"
+              << (cores > 1 ? "s" : "") << " (" << mac_rate / 1e6 << " MMAC/s per core)\n";
+
+    if (input_load > CPU_BUDGET_WARN || output_load > CPU_BUDGET_WARN || total_load > CPU_BUDGET_WARN * cores) {
+        std::cout << "Warning: The configuration is likely to overload this host.\n";
+
+        // Cheapest other sample rate where all channels fit around the same
+        // tuner frequency
+        SampleRate best_rate = SampleRate::UNSPECIFIED;
+        double     best_cost = cost.total();
+        if (settings.scan_fqs.empty()) {
+            for (int r = 0; r < (int)SampleRate::UNSPECIFIED; ++r) {
+                SampleRate rate = (SampleRate)r;
+                RatePlan   alt_plan = get_rate_plan(rate);
+
+                if (rate == settings.rate || alt_plan.N == 0 || alt_plan.stages.empty()) continue;
+                if (!R820Dev::rateSupported(settings.device_serial, rate)) continue;
+
+                int64_t half_bw = sample_rate_to_uint(rate) * 8 / 20;
+                bool    fits = std::all_of(settings.channels.begin(), settings.channels.end(), [&](const Channel &ch) {
+                    return std::abs((int64_t)parse_fq(ch.name, AERONAUTICAL_CHANNEL) - (int64_t)settings.tuner_fq) <= half_bw;
+                });
+
+                double alt_cost = pipeline_cost(settings, rate).total();
+                if (fits && alt_cost < best_cost) {
+                    best_rate = rate;
+                    best_cost = alt_cost;
+                }
+            }
+        }
+
+        if (best_rate != SampleRate::UNSPECIFIED) {
+            std::cout << "         A sample rate of " << sample_rate_to_str(best_rate) << "MS/s needs " << std::setprecision(1)
+                      << best_cost / 1e6 << " MMAC/s. Try --sample-rate " << sample_rate_to_str(best_rate) << " or --auto.\n";
+        }
+        if (!settings.use_threaded_ds && cores > 1 && input_load > CPU_BUDGET_WARN) {
+            std::cout << "         Try --threaded-ds to spread the down sampling over the " << cores << " cores.\n";
+        }
+        if (settings.pool_size == 0 && settings.scan_fqs.empty() && settings.channels.size() > 2) {
+            std::cout << "         Try --pool to only run the channels that are active.\n";
+        }
+    }
+
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+
+// Print the estimated memory use of the receiver per subsystem. The down
+// samplers, the channel state and the ring buffer grow with the number of
+// channels and the device buffers with the sample rate. The channel list is
+// held by the input and output threads and twice by the main thread when the
+// control socket is used
+static void print_memory_use(const Settings &settings, const InputState &input_state, const RatePlan &plan, const R820Dev &device) {
+    const std::vector<Channel> &channels = input_state.settings.channels;
+    unsigned                    copies = settings.ctl_socket.empty() ? 3 : 4;
+
+    size_t ds_mem = 0;
+    for (auto &ch : channels) {
+        ds_mem += ch.msd.memoryUsage();
+        if (ch.ds_ptr) ds_mem += ch.ds_ptr->memoryUsage();
+    }
+    if (input_state.pool_ptr) {
+        for (auto &tuner : input_state.pool_ptr->tuners) ds_mem += tuner.memoryUsage();
+    }
+
+    size_t coeff_mem = 0;
+    for (auto &stage : plan.stages) {
+        if (stage.hc) coeff_mem += stage.hc->capacity() * sizeof(iqsample_t);
+    }
+
+    size_t device_mem = device.bufferMemory();
+    size_t rb_mem     = input_state.rb_ptr->memoryUsage();
+    size_t ch_mem     = channels.capacity() * copies * sizeof(Channel);
+    size_t state_mem  = sizeof(InputState) + sizeof(OutputState);
+    size_t total      = device_mem + ds_mem + coeff_mem + rb_mem + ch_mem + state_mem;
+
+    auto kb = [](size_t bytes) { return (bytes + 1023) / 1024; };
+    std::cout << "    Memory: " << kb(total) << " kB (device " << kb(device_mem) << ", down samplers " << kb(ds_mem)
+              << ", filter coefficients " << kb(coeff_mem) << ", ring buffer " << kb(rb_mem) << ", channels " << kb(ch_mem)
+              << ", input and output " << kb(state_mem) << ")\n";
+}
+
+
+// IQ source for the benchmark. Either synthetic blocks played in a loop or a
+// raw file with unsigned 8 bit IQ samples, as written by rtl_sdr, that is
+// read over and over again
+struct BenchSource {
+    unsigned                block_len = 0;  // Samples in a 32ms block
+    std::vector<iqsample_t> blocks;         // Synthetic blocks or the last block read from file
+    unsigned                next = 0;       // Next synthetic block
+    std::vector<uint8_t>    raw;            // Raw block read from file
+    FILE                   *file = nullptr;
+};
+
+
+// Synthesize BENCH_SYNTH_BLOCKS blocks with a 1kHz tone, 50% AM modulated, on
+// every channel. Noise is at the level of an 8 bit ADC. A simple LCG is used
+// so that the data is the same on every host
+static void bench_synthesize(BenchSource &src, const Settings &settings) {
+    double              fs = sample_rate_to_uint(settings.rate);
+    uint32_t            seed = 1;
+    std::vector<double> offsets;
+
+    for (auto &ch : settings.channels) {
+        offsets.push_back((double)parse_fq(ch.name, AERONAUTICAL_CHANNEL) - settings.tuner_fq);
+    }
+
+    auto noise = [&seed](void) {
+        seed = seed * 1664525u + 1013904223u;
+        return ((float)(seed >> 8) / (float)(1u << 24) - 0.5f) / 64.0f;
+    };
+
+    src.blocks.resize(src.block_len * BENCH_SYNTH_BLOCKS);
+    for (unsigned n = 0; n < src.blocks.size(); ++n) {
+        double     t = n / fs;
+        float      env = 0.05f * (1.0f + 0.5f * (float)std::sin(2.0 * M_PI * 1000.0 * t));
+        iqsample_t sample(noise(), noise());
+
+        for (double offset : offsets) {
+            sample += std::polar(env, (float)std::fmod(2.0 * M_PI * offset * t, 2.0 * M_PI));
+        }
+        src.blocks[n] = sample;
+    }
+}
+
+
+// Open a raw IQ file for the benchmark. Returns false if the file can not be
+// read or is empty
+static bool bench_open(BenchSource &src, const std::string &path) {
+    src.file = fopen(path.c_str(), "rb");
+    if (!src.file) return false;
+
+    if (fseek(src.file, 0, SEEK_END) != 0 || ftell(src.file) < 2) {
+        fclose(src.file);
+        src.file = nullptr;
+        return false;
+    }
+    rewind(src.file);
+
+    src.raw.resize(src.block_len * 2);
+    src.blocks.resize(src.block_len);
+
+    return true;
+}
+
+
+// Next 32ms block from the benchmark source. Returns null if the file can
+// not be read
+static const iqsample_t *bench_read(BenchSource &src) {
+    if (!src.file) {
+        const iqsample_t *block = &src.blocks[src.next * src.block_len];
+        if (++src.next == BENCH_SYNTH_BLOCKS) src.next = 0;
+        return block;
+    }
+
+    // Start over from the beginning of the file when the end is reached
+    size_t len = 0;
+    while (len < src.block_len) {
+        size_t ret = fread(&src.raw[len * 2], 2, src.block_len - len, src.file);
+        if (ferror(src.file)) return nullptr;
+        if (ret == 0) rewind(src.file);
+        len += ret;
+    }
+
+    // Same conversion as for the RTL devices
+    for (unsigned i = 0; i < src.block_len; ++i) {
+        src.blocks[i] = iqsample_t((float)src.raw[i*2] / 127.5f - 1.0f, (float)src.raw[i*2+1] / 127.5f - 1.0f);
+    }
+
+    return src.blocks.data();
+}
+
+
+// Result of one benchmark run
+struct BenchResult {
+    double      signal_time = 0.0;  // Seconds of signal run through the pipeline
+    double      wall_time = 0.0;    // Seconds elapsed
+    double      cpu_time = 0.0;     // CPU seconds used by the process in all threads
+    BenchStats  stats;
+    std::string timing;             // Latency report. Empty if timing is not enabled
+    std::string perf;               // Hardware counter report. Empty if not enabled
+    std::string digests;            // Digests of the output. Empty if not deterministic
+};
+
+
+static double process_cpu_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+// Run the receiver pipeline, from IQ blocks to a null sink, as fast as
+// possible. The input and output callbacks are called one after the other for
+// every block, just as the device and ALSA threads would call them, so the
+// ring buffer, squelch, mixing and audio filter are all included. One block
+// is run first to warm up caches and delay lines. Returns false if the IQ
+// file can not be read
+static bool run_bench(Settings settings, const RatePlan &plan, BenchResult &result) {
+    BenchSource src;
+    unsigned    m = 1;
+    bool        ok = true;
+
+    // Both callbacks run in this thread and share a console queue
+    Log         console_log(&cout_lock);
+    Log::Queue &log_queue = console_log.queue();
+    if (!console_log.start()) {
+        std::cerr << "Error: Unable to start console output thread.\n";
+        return false;
+    }
+
+    for (auto &stage : plan.stages) m *= stage.m;
+    src.block_len = CH_IQ_BUF_SIZE * m;
+
+    if (!settings.bench_file.empty()) {
+        if (!bench_open(src, settings.bench_file)) {
+            std::cerr << "Error: Unable to read IQ file " << settings.bench_file << ".\n";
+            return false;
+        }
+    } else {
+        bench_synthesize(src, settings);
+    }
+
+    unsigned ch_idx = 0;
+    for (auto &ch : settings.channels) {
+        if (settings.pool_size > 0) setup_channel_agc(ch, settings);
+        else                        setup_channel(ch, settings, plan);
+
+        if (!ch.pos_fixed) ch.pos = get_audio_pos(ch_idx, settings.channels.size());
+        ++ch_idx;
+    }
+
+    std::unique_ptr<PoolState> pool_ptr;
+    if (settings.pool_size > 0) {
+        pool_ptr = std::make_unique<PoolState>(pool_detector_size(settings.rate));
+        setup_pool(*pool_ptr, settings, plan);
+    }
+
+    rb_t iq_rb(CH_IQ_BUF_SIZE * settings.channels.size(), rb_chunks(settings));
+
+    std::unique_ptr<TimingState> timing_ptr;
+    if (settings.timing) timing_ptr = std::make_unique<TimingState>(settings.channels.size());
+
+    std::unique_ptr<PerfState> perf_ptr;
+    if (settings.perf) perf_ptr = std::make_unique<PerfState>(settings.channels.size());
+
+    std::unique_ptr<DigestState> digest_ptr;
+    if (settings.deterministic) digest_ptr = std::make_unique<DigestState>(settings.channels.size());
+
+    result = BenchResult();
+
+    struct InputState input_state;
+    input_state.settings  = settings;
+    input_state.rb_ptr    = &iq_rb;
+    input_state.pool_ptr  = pool_ptr.get();
+    input_state.bench_ptr = &result.stats;
+    input_state.log_ptr   = &log_queue;
+
+    FIR2 flt(coeff_bp4am_channel);
+    flt.setGain(settings.lf_gain);
+
+    struct OutputState output_state;
+    output_state.settings         = settings;
+    output_state.rb_ptr           = &iq_rb;
+    output_state.pcm_handle       = nullptr;  // Null sink
+    drop_down_samplers(output_state.settings.channels);
+    output_state.audio_filter     = &flt;
+    output_state.samples_received = false;
+    output_state.running          = false;
+    output_state.pool_ptr         = pool_ptr.get();
+    output_state.pool_owners.fill(-1);
+    output_state.bench_ptr        = &result.stats;
+    output_state.digest_ptr       = digest_ptr.get();
+    output_state.log_ptr          = &log_queue;
+    setup_output(output_state);
+
+    R820Dev::BlockInfo block_info;
+    block_info.stream_state = R820Dev::StreamState::STREAMING;
+    block_info.rate         = settings.rate;
+    block_info.dropped      = 0;
+
+    unsigned num_blocks = settings.bench_time * 1000 / 32; // One block is 32ms
+    auto     start = BenchStats::Clock::now();
+    double   cpu_start = process_cpu_time();
+
+    for (unsigned block = 0; block <= num_blocks; ++block) {
+        auto bench_ts = BenchStats::Clock::now();
+
+        const iqsample_t *data = bench_read(src);
+        if (!data) {
+            std::cerr << "Error: Unable to read IQ file " << settings.bench_file << ".\n";
+            ok = false;
+            break;
+        }
+
+        float pwr = 0.0f;
+        for (unsigned i = 0; i < src.block_len; ++i) pwr += std::norm(data[i]);
+        block_info.pwr = 10 * std::log10(pwr / src.block_len) - 3.0f;
+        // A deterministic run does not depend on the clock
+        if (settings.deterministic) block_info.ts = R820Dev::BlockInfo::TimeStamp(std::chrono::milliseconds(32 * block));
+        else                        block_info.ts = std::chrono::system_clock::now();
+        BenchStats::mark(&result.stats, BenchStats::SOURCE, bench_ts);
+
+        data_cb(data, src.block_len, &input_state, block_info);
+        alsa_write_cb(output_state);
+
+        if (block == 0) {
+            // Warm up done
+            input_state.timing_ptr  = timing_ptr.get();
+            output_state.timing_ptr = timing_ptr.get();
+            input_state.perf_ptr    = perf_ptr.get();
+            output_state.perf_ptr   = perf_ptr.get();
+            result.stats = BenchStats();
+            start = BenchStats::Clock::now();
+            cpu_start = process_cpu_time();
+        }
+    }
+
+    result.wall_time   = std::chrono::duration<double>(BenchStats::Clock::now() - start).count();
+    result.cpu_time    = process_cpu_time() - cpu_start;
+    result.signal_time = num_blocks * 0.032;
+    if (timing_ptr) result.timing = timing_report(*timing_ptr, channel_names(input_state.settings.channels));
+    if (perf_ptr) result.perf = perf_report(*perf_ptr, channel_names(input_state.settings.channels));
+    if (digest_ptr) {
+        std::ostringstream report;
+        char               line[128];
+
+        snprintf(line, sizeof(line), "    %-10s %-16s %s\n", "Channel", "IQ", "Squelch");
+        report << line;
+        for (unsigned idx = 0; idx < settings.channels.size(); ++idx) {
+            // Down samplers in a pool have no channel of their own
+            std::string name = pool_ptr ? "Pool " + std::to_string(idx + 1) : settings.channels[idx].name;
+            snprintf(line, sizeof(line), "    %-10s %016" PRIx64 " %016" PRIx64 "\n", name.c_str(), digest_ptr->iq[idx], digest_ptr->sql[idx]);
+            report << line;
+        }
+        snprintf(line, sizeof(line), "    %-10s %016" PRIx64 "\n", "Audio", digest_ptr->audio);
+        report << line;
+        result.digests = report.str();
+    }
+
+    for (auto &ch : input_state.settings.channels) {
+        if (ch.ds_ptr) delete ch.ds_ptr;
+    }
+    if (src.file) fclose(src.file);
+
+    return ok;
+}
+
+
+// Channels on the 25kHz grid spread out over the usable bandwidth around the
+// tuner frequency. The tuner frequency itself is avoided
+static std::vector<Channel> make_bench_channels(const Settings &settings, unsigned num_channels) {
+    std::vector<Channel> channels;
+    int                  max_step = (sample_rate_to_uint(settings.rate) * 8 / 20 - 12500) / 25000;
+    char                 name[16];
+
+    for (unsigned i = 0; i < num_channels; ++i) {
+        int slot = (int)(i * 2 * max_step / num_channels);
+        int step = slot < max_step ? slot - max_step : slot - max_step + 1;
+        uint32_t fq = settings.tuner_fq + step * 25000;
+
+        snprintf(name, sizeof(name), "%u.%03u", fq / 1000000, (fq / 1000) % 1000);
+        channels.push_back(Channel(name, settings.sql_level, settings.mod));
+    }
+
+    return channels;
+}
+
+
+// Run the benchmark. The receiver is first run with the channels and options
+// given, or four synthetic channels if none are given, and the speed and the
+// time spent in each stage is reported. Then every sample rate is run with one
+// and eight synthetic channels to estimate how many channels one core can
+// handle in real time
+static int bench_main(Settings &settings) {
+    BenchResult result;
+
+    if (settings.rate == SampleRate::UNSPECIFIED) settings.rate = SampleRate::FS01440;
+
+    RatePlan plan = get_rate_plan(settings.rate);
+    if (plan.N == 0 || plan.stages.empty()) {
+        std::cerr << "Error: Sample rate " << sample_rate_to_str(settings.rate) << " MS/s is not supported yet (work in progress).\n";
+        return 1;
+    }
+
+    if (settings.channels.empty()) {
+        settings.tuner_fq = 120000000;
+        settings.channels = make_bench_channels(settings, 4);
+    } else if (!verify_requested_bandwidth(settings)) {
+        uint32_t available_bw = (sample_rate_to_uint(settings.rate) * 8 / 10) / 1000;
+        std::cerr << "Error: Requested channels does not fit inside available bandwidth (" << available_bw << "kHz).\n";
+        return 1;
+    }
+
+    if (settings.pool_size >= settings.channels.size()) settings.pool_size = 0;
+
+    // The down sampler threads give the same result but are left out so that
+    // nothing depends on thread timing
+    if (settings.deterministic) settings.use_threaded_ds = false;
+
+    if (settings.perf) {
+        std::string error = PerfCounters::probe();
+        if (!error.empty()) {
+            std::cerr << "Error: Unable to open hardware counters: " << error << ".\n";
+            return 1;
+        }
+    }
+
+    std::cout << "Benchmark with " << settings.channels.size() << " channel" << (settings.channels.size() > 1 ? "s" : "")
+              << " at " << sample_rate_to_str(settings.rate) << "MS/s, "
+              << (settings.bench_file.empty() ? std::string("synthetic IQ") : settings.bench_file) << ", "
+              << settings.bench_time << "s of signal:" << std::endl;
+    if (!run_bench(settings, plan, result)) return 1;
+
+    static const char *stage_names[BenchStats::NUM_STAGES] = { "Source", "Pool detector", "Channelize", "Demod and squelch", "Audio filter" };
+    double other = result.wall_time;
+
+    printf("    Speed: %.1f times real time\n", result.signal_time / result.wall_time);
+    printf("    CPU load: %.1f%% of one core\n", 100.0 * result.cpu_time / result.signal_time);
+    printf("    Time in each stage:\n");
+    for (unsigned stage = 0; stage < BenchStats::NUM_STAGES; ++stage) {
+        if (stage == BenchStats::DETECTOR && settings.pool_size == 0) continue;
+        printf("        %-18s %5.1f%%\n", stage_names[stage], 100.0 * result.stats.time[stage] / result.wall_time);
+        other -= result.stats.time[stage];
+    }
+    printf("        %-18s %5.1f%%\n", "Ring buffer, other", 100.0 * std::max(other, 0.0) / result.wall_time);
+    if (settings.use_threaded_ds) printf("    Channelize includes waiting for the down sampler threads\n");
+    if (!result.timing.empty()) printf("%s", result.timing.c_str());
+    if (!result.perf.empty()) printf("%s", result.perf.c_str());
+
+    // The digests are only comparable between builds when the kernels have a
+    // fixed summation order
+    if (settings.deterministic) {
+#ifdef SDRX_DETERMINISTIC
+        printf("Digests of the output (portable kernels, no FMA contraction):\n");
+#else
+        printf("Digests of the output (native kernels, only comparable with the same build on the same ISA):\n");
+#endif
+        printf("%s", result.digests.c_str());
+        return 0;
+    }
+
+    // Channel sweep. Single threaded down sampling and no pool so that the
+    // estimate is for one core
+    Settings sweep = settings;
+    sweep.bench_file.clear();
+    sweep.bench_time      = BENCH_SWEEP_TIME;
+    sweep.tuner_fq        = 120000000;
+    sweep.use_threaded_ds = false;
+    sweep.pool_size       = 0;
+    sweep.timing          = false;
+    sweep.perf            = false;
+
+    printf("Max channels in real time on one core (FTFIR %s):\n", settings.use_ftfir ? "on" : "off");
+    printf("    %-6s %10s %10s %8s %8s\n", "Rate", "1 ch", "8 ch", "Per ch", "Max ch");
+    for (int r = 0; r < (int)SampleRate::UNSPECIFIED; ++r) {
+        sweep.rate = (SampleRate)r;
+
+        RatePlan sweep_plan = get_rate_plan(sweep.rate);
+        if (sweep_plan.N == 0 || sweep_plan.stages.empty()) continue;
+
+        // Fraction of one core needed for one and eight channels. The cost
+        // is taken as linear in the number of channels
+        double load[2];
+        for (unsigned i = 0; i < 2; ++i) {
+            sweep.channels = make_bench_channels(sweep, i == 0 ? 1 : 8);
+            if (!run_bench(sweep, sweep_plan, result)) return 1;
+            load[i] = result.wall_time / result.signal_time;
+        }
+
+        double per_ch = std::max((load[1] - load[0]) / 7, 1e-9);
+        double fixed  = load[0] - per_ch;
+        printf("    %-6s %9.1fx %9.1fx %7.2f%% %8.0f\n", sample_rate_to_str(sweep.rate),
+               1.0 / load[0], 1.0 / load[1], 100.0 * per_ch, std::max(std::floor((1.0 - fixed) / per_ch), 0.0));
+        fflush(stdout);
+    }
+
+    return 0;
+}
+
+
+// Get info for first available device on the system
+static R820Dev::Info get_first_avaialble_device(void) {
+    R820Dev::Info              device;
+    std::vector<R820Dev::Info> devices;
+
+    device.type = R820Dev::Type::UNKNOWN;
+
+    devices = R820Dev::list();
+    for (auto &dev : devices) {
+        if (dev.supported && dev.available) {
+            device = dev;
+            break;
+        }
+    }
+
+    return device;
+}
+
+
+// Max number of control commands not yet handed back from the output thread.
+// Makes sure that the command queues never fill up
+#define MAX_CMDS_IN_FLIGHT 32
+
+// State for the control server
+struct CtlState {
+    R820Dev                 *device_ptr;    // Device. Used for retune
+    cmd_rb_t                *cmd_in_ptr;    // Control -> Input commands
+    cmd_rb_t                *cmd_ret_ptr;   // Output -> Control commands (for deletion)
+    unsigned                 in_flight = 0; // Commands posted but not yet handed back
+    unsigned                 ch_capacity;   // Max number of channels that fit in the IQ ring buffer
+    RatePlan                 plan;          // Rate plan in use
+    TimingState             *timing_ptr = nullptr; // Latency histograms. Null if not enabled
+    Settings                 settings;      // Settings. The channel list mirrors the running channels
+};
+
+
+// Delete a command together with the down sampler thread for a channel that
+// is removed (or never added)
+static void release_cmd(ChannelCmd *cmd) {
+    if (cmd->in_ch.ds_ptr) delete cmd->in_ch.ds_ptr;
+    delete cmd;
+}
+
+
+// Release all commands in a command queue
+static void release_cmds(cmd_rb_t &cmd_rb) {
+    ChannelCmd * const *cmds;
+    size_t              num_cmds;
+
+    while (cmd_rb.acquireRead(&cmds, &num_cmds)) {
+        for (size_t i = 0; i < num_cmds; ++i) release_cmd(cmds[i]);
+        cmd_rb.commitRead(num_cmds);
+    }
+}
+
+
+// Release commands handed back from the output thread
+static void reclaim_cmds(CtlState &ctl) {
+    ChannelCmd * const *cmds;
+    size_t              num_cmds;
+
+    while (ctl.cmd_ret_ptr->acquireRead(&cmds, &num_cmds)) {
+        for (size_t i = 0; i < num_cmds; ++i) release_cmd(cmds[i]);
+        ctl.in_flight -= num_cmds;
+        ctl.cmd_ret_ptr->commitRead(num_cmds);
+    }
+}
+
+
+// Post a command to the input thread. Returns false if too many commands are
+// in flight
+static bool post_cmd(CtlState &ctl, ChannelCmd *cmd) {
+    ChannelCmd **cmd_ptr;
+
+    if (ctl.in_flight >= MAX_CMDS_IN_FLIGHT) return false;
+    if (!ctl.cmd_in_ptr->acquireWrite(&cmd_ptr, 1)) return false;
+
+    *cmd_ptr = cmd;
+    ctl.cmd_in_ptr->commitWrite(1);
+    ++ctl.in_flight;
+
+    return true;
+}
+
+
+// Change the tuner center frequency. New translators for all channels are
+// created here and swapped in by the input thread once the tuner has changed
+// frequency. The filter states are kept. Returns the reply to the client
+static std::string retune(CtlState &ctl, const std::string &fq_str) {
+    std::vector<Channel> &channels = ctl.settings.channels;
+    uint32_t              fq = parse_fq(fq_str, NORMAL_FQ);
+    Settings              tmp_settings = ctl.settings;
+
+    if (fq_str.empty()) {
+        return std::to_string(ctl.settings.tuner_fq / 1000) + " kHz\nOK";
+    }
+
+    // Translators are based on 8.33kHz steps from a center on the 100kHz grid
+    if (fq == 0 || fq % 100000 != 0) return "ERROR: Invalid frequency. Must be in 100kHz steps";
+    if (ctl.in_flight >= MAX_CMDS_IN_FLIGHT) return "ERROR: Busy. Try again";
+
+    tmp_settings.tuner_fq = fq;
+    for (auto &ch : channels) {
+        if (!channel_in_bandwidth(tmp_settings, ch.name)) return "ERROR: Channel " + ch.name + " outside available bandwidth";
+    }
+
+    ChannelCmd *cmd = new ChannelCmd(ChannelCmd::Type::RETUNE);
+    cmd->tuner_fq = fq;
+    for (auto &ch : channels) {
+        cmd->msds.push_back(make_down_sampler(ch.name, fq, ctl.settings, ctl.plan));
+    }
+
+    // Posted before the frequency change so that the input thread mutes the
+    // blocks recorded during the change. Can not fail since in_flight is
+    // checked above
+    post_cmd(ctl, cmd);
+
+    int ret = ctl.device_ptr->setFq(fq);
+    cmd->tuned = ret >= 0;
+    cmd->ready.store(true, std::memory_order_release);
+
+    if (ret < 0) return std::string("ERROR: Unable to set frequency: ") + R820Dev::retToStr(ret);
+
+    ctl.settings.tuner_fq = fq;
+
+    return "OK";
+}
+
+
+// Handle one line from a control client. Called in the event loop of the main
+// thread. Channels are set up here so that all heavy work is done outside of
+// the input and output threads. Returns the reply to the client
+static std::string handle_ctl_cmd(CtlState &ctl, const std::string &line) {
+    std::vector<Channel> &channels = ctl.settings.channels;
+    std::istringstream    iss(line);
+    std::ostringstream    reply;
+    std::string           cmd_str;
+    std::string           ch_str;
+    std::string           value_str;
+    ChannelCmd           *cmd = nullptr;
+
+    reclaim_cmds(ctl);
+
+    iss >> cmd_str >> ch_str >> value_str;
+
+    auto iter = std::find(channels.begin(), channels.end(), ch_str.c_str());
+
+    if (cmd_str == "help") {
+        reply << "Commands:\n"
+                 "    list                     list channels\n"
+                 "    add CHANNEL[/SQL[/MOD]]  add a channel\n"
+                 "    remove CHANNEL           remove a channel\n"
+                 "    sql CHANNEL LEVEL        set squelch level in dB (0 to 50)\n"
+                 "    mod CHANNEL MOD          set modulation (AM or FM)\n"
+                 "    pan CHANNEL POS          set audio position (-2 left to 2 right)\n"
+                 "    fq [FREQUENCY]           show or set tuner center frequency in MHz (100kHz steps)\n"
+                 "    timing                   show latency report (requires --timing)\n"
+                 "OK";
+        return reply.str();
+    } else if (cmd_str == "list") {
+        for (auto &ch : channels) {
+            reply << ch.name << " sql=" << ch.sql_level << " mod=" << modulation_to_str(ch.mod) << " pan=" << ch.pos
+                  << " prio=" << ch.prio << " audio=" << (ch.audio ? "on" : "off");
+            if (ch.group >= 0) reply << " group=" << ctl.settings.groups[ch.group];
+            reply << "\n";
+        }
+        reply << "OK";
+        return reply.str();
+    } else if (cmd_str == "add") {
+        std::string name;
+        float       sql = ctl.settings.sql_level;
+        Modulation  mod = ctl.settings.mod;
+
+        std::string err = parse_channel_arg(ch_str, AERONAUTICAL_CHANNEL, name, sql, mod);
+        if (!err.empty()) return "ERROR: " + err;
+        if (std::find(channels.begin(), channels.end(), name.c_str()) != channels.end()) return "ERROR: Channel already added";
+        if (channels.size() >= ctl.ch_capacity) return "ERROR: Max number of channels reached";
+        if (!channel_in_bandwidth(ctl.settings, name)) return "ERROR: Channel outside available bandwidth";
+
+        cmd = new ChannelCmd(ChannelCmd::Type::ADD, name);
+        cmd->sql_level = sql;
+        cmd->mod = mod;
+        cmd->in_ch = Channel(name, sql, mod);
+        setup_channel(cmd->in_ch, ctl.settings, ctl.plan);
+
+        // The output thread does not need the down sampler
+        cmd->out_ch = cmd->in_ch;
+        cmd->out_ch.msd = MSD();
+        cmd->out_ch.ds_ptr = nullptr;
+    } else if (cmd_str == "remove") {
+        if (iter == channels.end()) return "ERROR: Unknown channel";
+
+        cmd = new ChannelCmd(ChannelCmd::Type::REMOVE, ch_str);
+    } else if (cmd_str == "sql") {
+        float sql;
+
+        if (iter == channels.end()) return "ERROR: Unknown channel";
+        if (!(std::istringstream(value_str) >> sql) || sql < 0.0f || sql > 50.0f) return "ERROR: Invalid SQL level";
+
+        cmd = new ChannelCmd(ChannelCmd::Type::SQL, ch_str);
+        cmd->sql_level = sql;
+    } else if (cmd_str == "mod") {
+        Modulation mod = str_to_modulation(value_str);
+
+        if (iter == channels.end()) return "ERROR: Unknown channel";
+        if (mod == Modulation::UNSPECIFIED) return "ERROR: Invalid modulation";
+
+        cmd = new ChannelCmd(ChannelCmd::Type::MOD, ch_str);
+        cmd->mod = mod;
+    } else if (cmd_str == "pan") {
+        int pos;
+
+        if (iter == channels.end()) return "ERROR: Unknown channel";
+        if (!(std::istringstream(value_str) >> pos) || pos < -2 || pos > 2) return "ERROR: Invalid audio position";
+
+        cmd = new ChannelCmd(ChannelCmd::Type::PAN, ch_str);
+        cmd->pos = pos;
+    } else if (cmd_str == "fq") {
+        return retune(ctl, ch_str);
+    } else if (cmd_str == "timing") {
+        if (!ctl.timing_ptr) return "ERROR: Timing not enabled. Start sdrx with --timing";
+
+        return timing_report(*ctl.timing_ptr, channel_names(channels)) + "OK";
+    } else {
+        return "ERROR: Unknown command. Use help to list commands";
+    }
+
+    if (!post_cmd(ctl, cmd)) {
+        release_cmd(cmd);
+        return "ERROR: Busy. Try again";
+    }
+
+    // Update the mirror of the running channels
+    switch (cmd->type) {
+        case ChannelCmd::Type::ADD:    channels.push_back(Channel(cmd->name, cmd->sql_level, cmd->mod)); break;
+        case ChannelCmd::Type::REMOVE: channels.erase(iter); break;
+        case ChannelCmd::Type::SQL:    iter->sql_level = cmd->sql_level; break;
+        case ChannelCmd::Type::MOD:    iter->mod = cmd->mod; break;
+        case ChannelCmd::Type::PAN:    iter->pos = cmd->pos; break;
+        default:                       break;
+    }
+
+    return "OK";
+}
+
+
+int main(int argc, char** argv) {
+    int              ret;
+    Settings         settings;
+
+    // Parse command line. Exit if incomplete, help requested or device list requested
+    ret = parse_cmd_line(argc, argv, settings);
+    if (ret < 0) {
+        if (ret == -2) {
+            // List devices and exit
+            list_available_devices();
+            return 0;
+        }
+
+        return 1;
+    }
+
+    // The benchmark runs without device and audio
+    if (settings.bench) return bench_main(settings);
+
+    // Signals are handled in the event loop of the main thread. Block them
+    // before any device, down sampler or library thread is started so that
+    // they are only delivered through the loop
+    for (int signo : { SIGINT, SIGTERM, SIGQUIT, SIGPIPE }) EventLoop::blockSignal(signo);
+    if (settings.timing || settings.perf) EventLoop::blockSignal(SIGUSR1);
+    if (!settings.trace_file.empty()) EventLoop::blockSignal(SIGUSR2);
+
+    if (settings.device_serial == "") {
+        // No serial given on command line. Find out serial for first available device
+        std::cout << "Searching for first available device...\n";
+        R820Dev::Info info = get_first_avaialble_device();
+
+        if (info.type == R820Dev::Type::UNKNOWN) {
+            std::cerr << "Error: No device available.\n";
+            return 1;
+        }
+
+        settings.device_serial = info.serial;
+
+        std::cout << "Found device " << settings.device_serial << " (" << R820Dev::typeToStr(info.type) << ")\n";
+
+        if (settings.rate == SampleRate::UNSPECIFIED) {
+            // Sample rate not given on command line (or given but invalid).
+            // Use default for the device choosen
+            settings.rate = info.default_sample_rate;
+        }
+    }
+
+    settings.device_type = R820Dev::getType(settings.device_serial);
+    if (settings.device_type == R820Dev::Type::UNKNOWN) {
+        std::cerr << "Error: Device " << settings.device_serial << " is not available.\n";
+        return 1;
+    }
+
+    if (settings.auto_plan) {
+        if (!auto_plan(settings)) {
+            std::cerr << "Error: No sample rate supported by device " << settings.device_serial << " fits the requested channels.\n";
+            return 1;
+        }
+    }
+
+    // Set default sample rate if not given. TODO: Refactor this to something better...
+    if (settings.rate == SampleRate::UNSPECIFIED && settings.device_type == R820Dev::Type::RTL) {
+        settings.rate = SampleRate::FS01440;
+    } else if (settings.rate == SampleRate::UNSPECIFIED && settings.device_type == R820Dev::Type::AIRSPY) {
+        settings.rate = SampleRate::FS06000;
+    }
+
+    // Verify that the requested sample rate is supported by the requested
+    // device type
+    if (!R820Dev::rateSupported(settings.device_serial, settings.rate)) {
+        std::cerr << "Error: Sample rate " << sample_rate_to_str(settings.rate) << "MS/s is not supported by device " << settings.device_serial << std::endl;
+        return 1;
+    }
+
+    if (settings.scan) {
+        make_scan_windows(settings);
+        if (settings.scan_fqs.size() == 1) {
+            std::cout << "Info: All channels fit inside the bandwidth. Scanning not needed.\n";
+            settings.scan_fqs.clear();
+        }
+    } else if (!verify_requested_bandwidth(settings)) {
+        uint32_t available_bw = (sample_rate_to_uint(settings.rate) * 8 / 10) / 1000;
+        std::cerr << "Error: Requested channels does not fit inside available bandwidth (" << available_bw << "kHz).\n";
+        return 1;
+    }
+
+    RatePlan plan = get_rate_plan(settings.rate);
+    if (plan.N == 0 || plan.stages.empty()) {
+        std::cerr << "Error: Sample rate " << sample_rate_to_str(settings.rate) << " MS/s is not supported yet (work in progress).\n";
+        return 1;
+    }
+
+    if (settings.pool_size >= settings.channels.size()) {
+        if (settings.pool_size > 0) std::cout << "Info: Pool is not smaller than the number of channels. Pool not needed.\n";
+        settings.pool_size = 0;
+    }
+
+    // Setup the channels with "tuner", down sampler, AGC and audio position.
+    // With a channel pool the down samplers are set up with the pool
+    unsigned ch_idx = 0;
+    for (auto &ch : settings.channels) {
+        if (settings.pool_size > 0) setup_channel_agc(ch, settings);
+        else                        setup_channel(ch, settings, plan);
+
+        if (!ch.pos_fixed) ch.pos = get_audio_pos(ch_idx, settings.channels.size());
+        ++ch_idx;
+    }
+
+    // Print settings
+    std::cout << "The folowing settings are being used:\n";
+    std::cout << "    Device: " << settings.device_serial << " (" << R820Dev::typeToStr(settings.device_type) << ")\n";
+    if (settings.device_type == R820Dev::Type::RTL) {
+        std::cout << "    Frequency correction: " << settings.fq_corr << "ppm\n";
+    }
+    std::cout << "    Sampling frequency: " << sample_rate_to_str(settings.rate) << "MS/s\n";
+    if (settings.gain_mode == Settings::GainMode::COMPOSITE) {
+        std::cout << "    RF gain: " << settings.composit_gain << "dB\n";
+    } else {
+        std::cout << "    RF gain indexes: " << settings.lna_gain_idx << ":" << settings.mix_gain_idx << ":" << settings.vga_gain_idx << std::endl;
+    }
+    std::cout << "    Modulation: " << modulation_to_str(settings.mod) << std::endl;
+    std::cout << "    Volume: " << settings.lf_gain << "dB\n";
+    std::cout << "    Squelch level: " << settings.sql_level << "dB\n";
+    std::cout << "    Audio AGC: " << (settings.use_lf_agc ? "On":"Off") << std::endl;
+    std::cout << "    Frequency Translating FIR: " << (settings.use_ftfir ? "On":"Off") << std::endl;
+    std::cout << "    ALSA device: " << settings.audio_device << std::endl;
+    if (settings.scan_fqs.empty()) {
+        std::cout << "    Tuner center frequency: " << settings.tuner_fq/1000 << " kHz\n";
+    } else {
+        std::cout << "    Scan windows (" << settings.scan_fqs.size() << "), dwell " << settings.scan_dwell << "ms, hang " << settings.scan_hang << "ms:\n";
+        for (unsigned window = 0; window < settings.scan_fqs.size(); ++window) {
+            std::cout << "        " << settings.scan_fqs[window]/1000 << " kHz:";
+            for (auto &ch : settings.channels) {
+                if (ch.window == window) std::cout << " " << ch.name;
+            }
+            std::cout << std::endl;
+        }
+    }
+    std::cout << "    Bandwidth: +/-" << (sample_rate_to_uint(settings.rate) * 8 / 20)/1000 << " kHz relative to center frequency\n";
+    std::cout << "    Channels (" << settings.channels.size() << "):";
+    for (int group = -1; group < (int)settings.groups.size(); ++group) {
+        if (group >= 0) std::cout << "\n        " << settings.groups[group] << ":";
+        for (auto &ch : settings.channels) {
+            if (ch.group != group) continue;
+            std::cout << " " << ch.name << "/" << ch.sql_level << "/" << modulation_to_str(ch.mod) << "(" << ch.pos << ")";
+            if (ch.prio > 0) std::cout << "P" << ch.prio;
+            if (!ch.audio) std::cout << "M";
+        }
+    }
+    std::cout << std::endl;
+    print_cpu_budget(settings, plan);
+
+    // With a channel pool, the input and output threads only see the pool
+    // down samplers
+    std::unique_ptr<PoolState> pool_ptr;
+    if (settings.pool_size > 0) {
+        pool_ptr = std::make_unique<PoolState>(pool_detector_size(settings.rate));
+        setup_pool(*pool_ptr, settings, plan);
+        std::cout << "    Channel pool: " << settings.pool_size << " down samplers, detector level " << settings.pool_level
+                  << "dB, hang " << settings.pool_hang << "ms, " << pool_ptr->detector.size() << " point FFT\n";
+    }
+
+    // With runtime control, the ring buffer must have room for channels
+    // added later on
+    unsigned ch_capacity = settings.channels.size();
+    if (!settings.ctl_socket.empty()) {
+        ch_capacity = std::max(ch_capacity, settings.max_channels);
+        std::cout << "    Control socket: " << settings.ctl_socket << " (max " << ch_capacity << " channels)\n";
+    }
+
+    rb_t iq_rb(CH_IQ_BUF_SIZE * ch_capacity, rb_chunks(settings));
+
+    // Queues for runtime control commands. Control -> Input -> Output -> Control
+    cmd_rb_t cmd_in_rb(MAX_CMDS_IN_FLIGHT * 2);
+    cmd_rb_t cmd_out_rb(MAX_CMDS_IN_FLIGHT * 2);
+    cmd_rb_t cmd_ret_rb(MAX_CMDS_IN_FLIGHT * 2);
+
+    // Latency histograms for every channel that fits in the ring buffer
+    std::unique_ptr<TimingState> timing_ptr;
+    if (settings.timing) timing_ptr = std::make_unique<TimingState>(ch_capacity);
+
+    // Counters for the metrics endpoint, one slot for every channel that
+    // fits in the ring buffer
+    std::unique_ptr<MetricsState> metrics_ptr;
+    if (settings.metrics_port > 0) {
+        metrics_ptr = std::make_unique<MetricsState>(ch_capacity, rb_chunks(settings));
+        std::cout << "    Metrics: http://localhost:" << settings.metrics_port << "/metrics\n";
+    }
+
+    // Time spent on every channel that fits in the ring buffer. Shown in the
+    // verbose status printout and on the metrics endpoint
+    std::unique_ptr<CostState> cost_ptr;
+    if (settings.verbose_printout || metrics_ptr) cost_ptr = std::make_unique<CostState>(ch_capacity);
+
+    // Trace of every block through the receiver
+    std::unique_ptr<Tracer> trace_ptr;
+    if (!settings.trace_file.empty()) {
+        trace_ptr = std::make_unique<Tracer>();
+        std::cout << "    Trace: " << settings.trace_file << " (written on exit and on SIGUSR2)\n";
+    }
+
+    // Hardware event counts for every channel that fits in the ring buffer
+    std::unique_ptr<PerfState> perf_ptr;
+    if (settings.perf) {
+        std::string error = PerfCounters::probe();
+        if (!error.empty()) {
+            std::cerr << "Error: Unable to open hardware counters: " << error << ".\n";
+            return 1;
+        }
+        perf_ptr = std::make_unique<PerfState>(ch_capacity);
+        std::cout << "    Hardware counters: printed on exit and on SIGUSR1\n";
+    }
+
+    MetricsServer metrics_server(settings.metrics_port,
+                                 [&metrics_ptr, &timing_ptr, &cost_ptr](void) { return metrics_report(*metrics_ptr, timing_ptr.get(), cost_ptr.get()); });
+
+    struct CtlState ctl_state;
+    ctl_state.timing_ptr  = timing_ptr.get();
+    ctl_state.cmd_in_ptr  = &cmd_in_rb;
+    ctl_state.cmd_ret_ptr = &cmd_ret_rb;
+    ctl_state.ch_capacity = ch_capacity;
+    ctl_state.plan        = plan;
+    ctl_state.settings    = settings;
+    drop_down_samplers(ctl_state.settings.channels);
+
+    // Signals, control clients, scanning and command reclaiming are all
+    // handled in this loop in the main thread
+    EventLoop loop;
+    if (!loop.valid()) {
+        std::cerr << "Error: Unable to create event loop.\n";
+        return 1;
+    }
+
+    CtlServer ctl_server(loop, settings.ctl_socket,
+                         [&ctl_state](const std::string &line) { return handle_ctl_cmd(ctl_state, line); });
+
+    struct ScanState scan_state;
+    scan_state.fqs = settings.scan_fqs;
+
+    // Console output from the input and output threads is written by a
+    // thread of its own so that a slow console never stalls them
+    Log console_log(&cout_lock);
+
+    // The status printout is formatted by a thread of its own from what the
+    // output thread publishes. The channel names by index are also used to
+    // label the reports
+    StatusState status_state(ch_capacity);
+    status_state.mode     = settings.status_mode;
+    status_state.verbose  = settings.verbose_printout;
+    status_state.compact  = settings.compact_printout;
+    status_state.pool     = pool_ptr != nullptr;
+    status_state.scan_fqs = settings.scan_fqs;
+    status_state.cost_ptr = cost_ptr.get();
+
+    struct InputState input_state;
+    input_state.settings   = settings;
+    input_state.rb_ptr     = &iq_rb;
+    input_state.pool_ptr   = pool_ptr.get();
+    input_state.timing_ptr = timing_ptr.get();
+    input_state.metrics_ptr = metrics_ptr.get();
+    input_state.trace_ptr  = trace_ptr.get();
+    input_state.perf_ptr   = perf_ptr.get();
+    input_state.cost_ptr   = cost_ptr.get();
+    input_state.log_ptr    = &console_log.queue();
+    if (!settings.scan_fqs.empty()) input_state.scan_ptr = &scan_state;
+    input_state.settings.channels.reserve(ch_capacity);
+    if (!settings.ctl_socket.empty()) {
+        input_state.cmd_in_ptr  = &cmd_in_rb;
+        input_state.cmd_out_ptr = &cmd_out_rb;
+    }
+
+    // The input thread owns the down samplers from here on. Only the names
+    // and parameters are used in the rest of main
+    drop_down_samplers(settings.channels);
+
+    // Create tuner class instance
+    R820Dev *device = R820Dev::create(settings.device_type, settings.device_serial, settings.rate, settings.fq_corr);
+    if (device == nullptr) {
+        std::cerr << "Error: Unable to create device instance.\n";
+        return 1;
+    }
+    print_memory_use(settings, input_state, plan, *device);
+
+    // Set up the instance
     device->setUserData((void*)&input_state);
     device->setFq(settings.tuner_fq);
     if (settings.gain_mode == Settings::GainMode::COMPOSITE) {
@@ -1745,21 +4380,88 @@ int main(int argc, char** argv) {
     }
     device->data.connect(sigc::ptr_fun(data_cb));
 
-    // Install signal handler
-    sigact.sa_handler = signal_handler;
-    sigemptyset(&sigact.sa_mask);
-    sigact.sa_flags = 0;
-    sigaction(SIGINT, &sigact, NULL);
-    sigaction(SIGTERM, &sigact, NULL);
-    sigaction(SIGQUIT, &sigact, NULL);
-    sigaction(SIGPIPE, &sigact, NULL);
+    ctl_state.device_ptr = device;
+    scan_state.device_ptr = device;
+
+    // Stop on Ctrl-C and friends
+    for (int signo : { SIGINT, SIGTERM, SIGQUIT, SIGPIPE }) {
+        loop.addSignal(signo, [&loop](int signo) {
+            std::cout << "Signal '" << strsignal(signo) << "' received. Stopping...\n";
+            loop.stop();
+        });
+    }
+
+    // Latency and hardware counter reports on demand
+    if (timing_ptr || perf_ptr) {
+        loop.addSignal(SIGUSR1, [&](int) {
+            std::string report;
+            if (timing_ptr) report += timing_report(*timing_ptr, channel_names(status_state));
+            if (perf_ptr) report += perf_report(*perf_ptr, channel_names(status_state));
+
+            while (cout_lock.test_and_set(std::memory_order_acquire));
+            std::cout << report << std::flush;
+            cout_lock.clear();
+        });
+    }
+
+    // Trace file on demand
+    if (trace_ptr) {
+        loop.addSignal(SIGUSR2, [&](int) { write_trace(*trace_ptr, settings.trace_file); });
+    }
+
+    // Scan windows are changed when the output thread reports the current
+    // window as idle
+    if (!settings.scan_fqs.empty()) {
+        scan_state.event = loop.addEvent([&scan_state](void) { scan_step(scan_state); });
+    }
 
     struct OutputState output_state;
     output_state.settings         = settings;
     output_state.rb_ptr           = &iq_rb;
     output_state.samples_received = false;
     output_state.running          = false;
+    output_state.settings.channels.reserve(ch_capacity);
+    drop_down_samplers(output_state.settings.channels);
+    if (!settings.ctl_socket.empty()) {
+        output_state.cmd_out_ptr = &cmd_out_rb;
+        output_state.cmd_ret_ptr = &cmd_ret_rb;
+        output_state.ret_event   = loop.addEvent([&ctl_state](void) { reclaim_cmds(ctl_state); });
+    }
+    output_state.stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (!settings.scan_fqs.empty()) output_state.scan_ptr = &scan_state;
+    output_state.pool_ptr = pool_ptr.get();
+    output_state.pool_owners.fill(-1);
+    output_state.timing_ptr = timing_ptr.get();
+    output_state.metrics_ptr = metrics_ptr.get();
+    output_state.trace_ptr = trace_ptr.get();
+    output_state.perf_ptr = perf_ptr.get();
+    output_state.cost_ptr = cost_ptr.get();
+    output_state.log_ptr = &console_log.queue();
+
+    output_state.status_ptr = &status_state;
+
+    if (!settings.ctl_socket.empty() && !ctl_server.start()) {
+        std::cerr << "Error: Unable to create control socket " << settings.ctl_socket << ".\n";
+        delete device;
+        return 1;
+    }
 
+    if (metrics_ptr && !metrics_server.start()) {
+        std::cerr << "Error: Unable to listen on metrics port " << settings.metrics_port << ".\n";
+        ctl_server.stop();
+        delete device;
+        return 1;
+    }
+
+    if (!console_log.start()) {
+        std::cerr << "Error: Unable to start console output thread.\n";
+        ctl_server.stop();
+        metrics_server.stop();
+        delete device;
+        return 1;
+    }
+
+    std::thread status_thread(status_worker, std::ref(status_state));
     std::thread alsa_thread(alsa_worker, std::ref(output_state));
 
     // Give the output thread up to 2 seconds to start upp
@@ -1776,12 +4478,8 @@ int main(int argc, char** argv) {
         goto quit;
     }
 
-    // Sleep until the stop_condition is signaled from the sigint handler
-    std::unique_lock<std::mutex> lock(stop_mutex);
-    while (run) {
-        stop_condition.wait(lock);
-    }
-    lock.unlock();
+    // Handle events until stopped by a signal
+    loop.run();
 
     ret = device->stop();
     if (ret < 0) {
@@ -1789,13 +4487,32 @@ int main(int argc, char** argv) {
     }
 
 quit:
+    ctl_server.stop();
+    metrics_server.stop();
+
     delete device;
 
-    for (auto &ch : settings.channels) {
+    EventLoop::trigger(output_state.stop_fd);
+    alsa_thread.join();
+    close(output_state.stop_fd);
+
+    stop_status(status_state);
+    status_thread.join();
+
+    console_log.stop();
+
+    if (trace_ptr) write_trace(*trace_ptr, settings.trace_file);
+    if (perf_ptr) std::cout << perf_report(*perf_ptr, channel_names(status_state));
+
+    // Commands still in the queues may own down sampler threads
+    release_cmds(cmd_in_rb);
+    release_cmds(cmd_out_rb);
+    release_cmds(cmd_ret_rb);
+
+    // The input thread holds the current channel layout
+    for (auto &ch : input_state.settings.channels) {
         if (ch.ds_ptr) delete ch.ds_ptr;
     }
 
-    alsa_thread.join();
-
     std::cout << "Stopped.\n";
 }
@@ -0,0 +1,252 @@
+//
+// Simulated device that plays synthetic IQ or a raw IQ file in real time
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include <cmath>
+#include <chrono>
+#include <iostream>
+
+#include <unistd.h>
+
+#include "sim_dev.hpp"
+
+#define SIM_PREFIX        "sim"
+#define SIM_FILE_PREFIX   "sim:"
+#define SIM_SYNTH_BLOCKS  8          // Synthetic blocks played in a loop
+#define SIM_CARRIER_FQ    100000.0   // Offset of the synthetic carrier from the tuner fq
+#define SIM_BLOCK_TIME    std::chrono::milliseconds(32)
+
+
+SimDev::SimDev(const std::string &serial, SampleRate rate)
+: R820Dev(serial, rate), file_(nullptr), block_len_(0), synth_next_(0) {
+    if (serial.rfind(SIM_FILE_PREFIX, 0) == 0) path_ = serial.substr(sizeof(SIM_FILE_PREFIX) - 1);
+}
+
+
+int SimDev::start() {
+    if (run_) return ReturnValue::ALREADY_STARTED;
+
+    if (!rateSupported(serial_, fs_)) return ReturnValue::INVALID_SAMPLE_RATE;
+
+    // 32ms of samples. All supported rates are divisible by 125
+    block_len_ = sample_rate_to_uint(fs_) / 125 * 4;
+    iq_buffer_.resize(block_len_);
+
+    if (path_.empty()) {
+        synthesize_();
+    } else {
+        file_ = fopen(path_.c_str(), "rb");
+        if (!file_) return ReturnValue::UNABLE_TO_OPEN_DEVICE;
+        if (fseek(file_, 0, SEEK_END) != 0 || ftell(file_) < 2) {
+            fclose(file_);
+            file_ = nullptr;
+            return ReturnValue::UNABLE_TO_OPEN_DEVICE;
+        }
+        rewind(file_);
+        raw_.resize(block_len_ * 2);
+    }
+
+    block_info_.rate = fs_;
+    block_info_.pwr = 0.0f;
+    block_info_.ts = std::chrono::system_clock::now();
+    block_info_.stream_state = StreamState::IDLE;
+    block_info_.dropped = 0;
+
+    state_ = State::STARTING;
+    run_ = true;
+    worker_thread_ = std::thread(worker_, std::ref(*this));
+
+    return ReturnValue::OK;
+}
+
+
+int SimDev::stop() {
+    if (!run_) return ReturnValue::ALREADY_STOPPED;
+
+    halt_();
+    state_ = State::STOPPING;
+    worker_thread_.join();
+
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+
+    return ReturnValue::OK;
+}
+
+
+// The buffers are allocated when started. Before that, what they will need
+// is returned
+size_t SimDev::bufferMemory() const {
+    size_t block_len = sample_rate_to_uint(fs_) / 125 * 4;
+    size_t mem = block_len * sizeof(iqsample_t);
+
+    if (path_.empty()) mem += block_len * SIM_SYNTH_BLOCKS * sizeof(iqsample_t);
+    else               mem += block_len * 2;
+
+    return mem;
+}
+
+
+int SimDev::setFq(uint32_t) {
+    return ReturnValue::OK;
+}
+
+
+int SimDev::setGain(float) {
+    return ReturnValue::OK;
+}
+
+
+int SimDev::setLnaGain(unsigned idx) {
+    if (idx > 15) return ReturnValue::INVALID_GAIN;
+
+    return ReturnValue::OK;
+}
+
+
+int SimDev::setMixGain(unsigned idx) {
+    if (idx > 15) return ReturnValue::INVALID_GAIN;
+
+    return ReturnValue::OK;
+}
+
+
+int SimDev::setVgaGain(unsigned idx) {
+    if (idx > 15) return ReturnValue::INVALID_GAIN;
+
+    return ReturnValue::OK;
+}
+
+
+// Synthesize SIM_SYNTH_BLOCKS blocks with a carrier at -20dBFS and noise at
+// the level of an 8 bit ADC. Same LCG as the sdrx benchmark so that the data
+// is the same on every host
+void SimDev::synthesize_(void) {
+    double   fs = sample_rate_to_uint(fs_);
+    uint32_t seed = 1;
+
+    auto noise = [&seed](void) {
+        seed = seed * 1664525u + 1013904223u;
+        return ((float)(seed >> 8) / (float)(1u << 24) - 0.5f) / 64.0f;
+    };
+
+    synth_.resize(block_len_ * SIM_SYNTH_BLOCKS);
+    for (unsigned n = 0; n < synth_.size(); ++n) {
+        double phase = std::fmod(2.0 * M_PI * SIM_CARRIER_FQ * n / fs, 2.0 * M_PI);
+        synth_[n] = iqsample_t(noise(), noise()) + std::polar(0.1f, (float)phase);
+    }
+    synth_next_ = 0;
+}
+
+
+// Next 32ms block from the synthetic blocks or the file. Returns null if the
+// file can not be read
+const iqsample_t *SimDev::read_(void) {
+    if (!file_) {
+        const iqsample_t *block = &synth_[synth_next_ * block_len_];
+        if (++synth_next_ == SIM_SYNTH_BLOCKS) synth_next_ = 0;
+        return block;
+    }
+
+    // Start over from the beginning of the file when the end is reached
+    size_t len = 0;
+    while (len < block_len_) {
+        size_t ret = fread(&raw_[len * 2], 2, block_len_ - len, file_);
+        if (ferror(file_)) return nullptr;
+        if (ret == 0) rewind(file_);
+        len += ret;
+    }
+
+    // Same conversion as for the RTL devices
+    for (unsigned i = 0; i < block_len_; ++i) {
+        iq_buffer_[i] = iqsample_t((float)raw_[i*2] / 127.5f - 1.0f, (float)raw_[i*2+1] / 127.5f - 1.0f);
+    }
+
+    return iq_buffer_.data();
+}
+
+
+void SimDev::worker_(SimDev &self) {
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point next = Clock::now();
+
+    self.state_ = State::RUNNING;
+    self.block_info_.stream_state = StreamState::STREAMING;
+
+    while (self.run_) {
+        next += SIM_BLOCK_TIME;
+        std::this_thread::sleep_until(next);
+        if (!self.run_) break;
+
+        // A real device overwrites its buffers if the host does not keep up.
+        // Do the same and skip the blocks that are late by a block or more
+        auto late = Clock::now() - next;
+        if (late >= SIM_BLOCK_TIME) {
+            auto skipped = late / SIM_BLOCK_TIME;
+            self.block_info_.dropped += skipped * self.block_len_;
+            next += skipped * SIM_BLOCK_TIME;
+        }
+
+        const iqsample_t *block = self.read_();
+        if (!block) {
+            // Stop streaming, like a device that can not be reopened
+            std::cerr << "Error: Unable to read IQ file " << self.path_ << ".\n";
+            break;
+        }
+
+        // Same power calculation as for the real devices
+        float pwr_rms = 0.0f;
+        for (unsigned i = 0; i < self.block_len_; i++) pwr_rms += std::norm(block[i]);
+        pwr_rms = pwr_rms / self.block_len_;
+
+        self.block_info_.pwr = 10 * std::log10(pwr_rms) - 3.0f;
+        self.block_info_.ts = std::chrono::system_clock::now();
+        self.data(block, self.block_len_, self.user_data_, self.block_info_);
+    }
+
+    // Send a last data callback to indicate that we have stopped streaming
+    self.block_info_.stream_state = StreamState::IDLE;
+    self.block_info_.ts = std::chrono::system_clock::now();
+    self.data(self.iq_buffer_.data(), 0, self.user_data_, self.block_info_);
+
+    self.state_ = State::IDLE;
+}
+
+
+//
+// Static functions below
+//
+
+bool SimDev::isPresent(const std::string &serial) {
+    if (serial == SIM_PREFIX) return true;
+
+    if (serial.rfind(SIM_FILE_PREFIX, 0) == 0) {
+        return access(serial.c_str() + sizeof(SIM_FILE_PREFIX) - 1, R_OK) == 0;
+    }
+
+    return false;
+}
+
+
+bool SimDev::rateSupported(const std::string &serial, SampleRate rate) {
+    return isPresent(serial) && rate != SampleRate::UNSPECIFIED;
+}
@@ -0,0 +1,82 @@
+//
+// Simulated device that plays synthetic IQ or a raw IQ file in real time
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef SIM_DEV_HPP
+#define SIM_DEV_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "r820_dev.hpp"
+
+
+// A device that needs no hardware. The serial selects the source:
+//
+//     sim          Noise and a carrier 100kHz above the tuner frequency
+//     sim:FILE     Raw IQ file with unsigned 8 bit samples, as written by
+//                  rtl_sdr, played over and over again
+//
+// Blocks are emitted every 32ms from an internal thread, just like the real
+// devices. If the thread is delayed more than a block, for example when the
+// host is overloaded, the blocks that should have been emitted meanwhile are
+// skipped and counted as dropped in the block info.
+class SimDev : public R820Dev {
+public:
+    SimDev(const std::string &serial, SampleRate rate);
+
+    int start(void);
+
+    int setFq(uint32_t fq = 100000000);
+    int setGain(float gain = 30.0f);
+
+    int setLnaGain(unsigned idx);
+    int setMixGain(unsigned idx);
+    int setVgaGain(unsigned idx);
+
+    int stop(void);
+
+    size_t bufferMemory(void) const;
+
+    // Check if the serial is a simulated device. For a file, the file must
+    // be readable
+    static bool isPresent(const std::string &serial);
+
+    // Any rate is supported. A file is played at the rate given, which
+    // should be the rate it was recorded with
+    static bool rateSupported(const std::string &serial, SampleRate rate);
+
+private:
+    std::string             path_;          // IQ file. Empty for synthetic IQ
+    FILE                   *file_;
+    unsigned                block_len_;     // Samples in a 32ms block
+    std::vector<iqsample_t> synth_;         // Synthetic blocks played in a loop
+    unsigned                synth_next_;
+    std::vector<uint8_t>    raw_;           // Raw block read from file
+    std::vector<iqsample_t> iq_buffer_;
+    std::thread             worker_thread_;
+    void                    synthesize_(void);
+    const iqsample_t       *read_(void);
+    static void             worker_(SimDev &self);
+};
+
+#endif // SIM_DEV_HPP
@@ -0,0 +1,142 @@
+//
+// Squelch measurement on a block of down sampled channel IQ data
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef SQL_HPP
+#define SQL_HPP
+
+#include <cmath>
+
+#include <fftw3.h>
+
+#include "iqsample.hpp"
+#include "coeffs.hpp"
+
+enum sql_state_t { SQL_CLOSED, SQL_OPEN };
+
+// FFTW picks SIMD codelets at run time depending on the CPU.
+// SDRX_DETERMINISTIC keeps to the scalar ones so that the levels, and
+// thereby the squelch, are the same on every CPU
+#ifdef SDRX_DETERMINISTIC
+#define SQL_FFTW_FLAGS (FFTW_ESTIMATE | FFTW_NO_SIMD)
+#else
+#define SQL_FFTW_FLAGS FFTW_ESTIMATE
+#endif
+
+// Signal and noise levels of one block from a Hamming windowed FFT. The signal
+// is taken about 2.8kHz around the carrier and the noise reference about
+// 3.5kHz to 4.9kHz out on both sides, compensated for the shape of the last
+// down sampling filter. One meter can be shared by any number of channels
+// but not by threads
+class SqlMeter {
+public:
+    static constexpr unsigned SIZE = 512;   // Samples in a block. 32ms at 16kS/s
+
+    struct Levels {
+        float snr;          // SNR in dB
+        float sig;          // Signal level in dB
+        float ref_lo;       // Noise reference level below the carrier in dB
+        float ref_hi;       // Noise reference level above the carrier in dB
+        float lo_energy;    // Mean energy in the lower half of the spectrum, for spectral imbalance
+        float hi_energy;    // Mean energy in the upper half of the spectrum, for spectral imbalance
+    };
+
+    SqlMeter(void) {
+        plan_ = fftwf_plan_dft_1d(SIZE, reinterpret_cast<fftwf_complex*>(in_), reinterpret_cast<fftwf_complex*>(out_),
+                                  FFTW_FORWARD, SQL_FFTW_FLAGS);
+
+        // Hamming: 0.54-0.46cos(2*pi*x/N), 0 <= n <= N. Length L = N+1
+        for (unsigned n = 0; n <= SIZE; n++) {
+            window_[n] = 0.54f - 0.46f * std::cos((2.0f * M_PI * n) / SIZE);
+        }
+    }
+
+    ~SqlMeter(void) { fftwf_destroy_plan(plan_); }
+
+    SqlMeter(const SqlMeter&) = delete;
+    SqlMeter& operator=(const SqlMeter&) = delete;
+
+    // Measure the levels of SIZE samples
+    Levels measure(const iqsample_t *data) {
+        Levels levels;
+
+        for (unsigned i = 0; i < SIZE; ++i) in_[i] = data[i] * window_[i];
+        fftwf_execute(plan_);
+
+        float sig_level = 0.0f;
+        for (unsigned i = 3; i < 91; i++) {
+            // About 2.8kHz +/- Fc
+            sig_level += std::norm(out_[i]);
+            sig_level += std::norm(out_[SIZE - i]);
+        }
+        // Including DC seem to increase base level with ~5dB
+        //sig_level += std::norm(out_[0]);
+        sig_level /= 176;
+
+        float ref_level_hi = 0.0f;
+        float ref_level_lo = 0.0f;
+        for (unsigned i = 112; i < 157; i++) {
+            // About 3.5kHz to 4.9kHz
+            ref_level_hi += std::norm(out_[i] * passband_shape[i]);
+            ref_level_lo += std::norm(out_[SIZE - i] * passband_shape[SIZE - i]);
+        }
+        ref_level_hi /= 45;
+        ref_level_lo /= 45;
+        float noise_level = (ref_level_hi + ref_level_lo) / 2;
+
+        levels.snr = 10 * std::log10(sig_level / noise_level);
+
+        float lo_energy = 0.0f;
+        float hi_energy = 0.0f;
+        for (unsigned i = 1; i < SIZE/2; i++) {
+            hi_energy += std::norm(out_[i]);
+            lo_energy += std::norm(out_[i+SIZE/2]);
+        }
+        levels.lo_energy = lo_energy / 255;
+        levels.hi_energy = hi_energy / 255;
+
+        // Division by 512 is for compensating for the FFT gain (number of
+        // points, N)
+        levels.sig    = 10 * std::log10(sig_level/512.0f);
+        levels.ref_hi = 10 * std::log10(ref_level_hi/512.0f);
+        levels.ref_lo = 10 * std::log10(ref_level_lo/512.0f);
+
+        return levels;
+    }
+
+    // Squelch state after a block with the given SNR. A bit higher SNR than
+    // the squelch level is required to open the squelch. A level of 0 keeps
+    // it open
+    static sql_state_t gate(sql_state_t state, float snr, float sql_level) {
+        if (snr > sql_level + 3 || sql_level == 0.0f) return SQL_OPEN;
+        if (snr < sql_level)                         return SQL_CLOSED;
+
+        return state;
+    }
+
+private:
+    // Aligned as from fftwf_malloc so that FFTW picks the same algorithm
+    // wherever the meter is placed
+    alignas(64) iqsample_t in_[SIZE];
+    alignas(64) iqsample_t out_[SIZE];
+    float                  window_[SIZE+1];
+    fftwf_plan             plan_;
+};
+
+#endif // SQL_HPP
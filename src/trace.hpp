@@ -0,0 +1,220 @@
+//
+// Event trace in the Chrome trace format
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cinttypes>
+
+#include <unistd.h>
+
+#include "hist.hpp"
+
+
+// Records events from any number of threads and writes them as a Chrome
+// trace JSON file that can be opened in chrome://tracing or
+// https://ui.perfetto.dev.
+//
+// Every thread records into a buffer of its own without locks. The buffer is
+// created, under a lock, the first time a thread records an event. It is a
+// ring that keeps the last EVENTS_PER_THREAD events, so a long run is cut
+// from the beginning. The file can be written at any time, also while other
+// threads record. Events that are overwritten while the file is written are
+// left out.
+//
+// Timestamps are from LatencyHist::now(). Names must be string literals, or
+// otherwise outlive the tracer, since only the pointer is stored.
+class Tracer {
+public:
+    static constexpr unsigned EVENTS_PER_THREAD = 65536;
+    static constexpr uint64_t NO_SEQ = UINT64_MAX;
+
+    Tracer(void) : id_(next_id_.fetch_add(1) + 1), origin_(LatencyHist::now()) {}
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    // Name shown for the calling thread
+    void threadName(const char *name) { buffer_().name.store(name, std::memory_order_relaxed); }
+
+    // Span from start to end. seq is the block sequence number and arg the
+    // channel index, if any
+    void span(const char *name, uint64_t start, uint64_t end, uint64_t seq = NO_SEQ, int arg = -1) {
+        add_('X', name, start, end - start, seq, arg);
+    }
+
+    // Point in time
+    void instant(const char *name, uint64_t ts, uint64_t seq = NO_SEQ) { add_('i', name, ts, 0, seq, -1); }
+
+    // Span that starts in one thread and ends in another, e.g. a block that
+    // waits in a queue. Matched on name and id
+    void asyncBegin(const char *name, uint64_t ts, uint64_t id) { add_('b', name, ts, 0, id, -1); }
+    void asyncEnd(const char *name, uint64_t ts, uint64_t id)   { add_('e', name, ts, 0, id, -1); }
+
+    // Write all events recorded so far. Returns false if the file can not be
+    // written
+    bool write(const std::string &path) const {
+        FILE *file = fopen(path.c_str(), "w");
+        if (!file) return false;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        int  pid = getpid();
+        bool first = true;
+
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        for (auto &buffer : buffers_) {
+            const char *name = buffer->name.load(std::memory_order_relaxed);
+            if (name) {
+                fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                        first ? "" : ",\n", pid, buffer->tid, name);
+                first = false;
+            }
+
+            // Copy the events first and then drop the ones that the owner
+            // may have overwritten meanwhile
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t begin = head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0;
+
+            std::vector<Copy> events;
+            events.reserve(head - begin);
+            for (uint64_t i = begin; i < head; ++i) {
+                const Event &event = buffer->events[i % EVENTS_PER_THREAD];
+                events.push_back({ event.name.load(std::memory_order_relaxed), event.ts.load(std::memory_order_relaxed),
+                                   event.dur.load(std::memory_order_relaxed), event.seq.load(std::memory_order_relaxed),
+                                   event.arg.load(std::memory_order_relaxed), event.phase.load(std::memory_order_relaxed) });
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t now_head = buffer->head.load(std::memory_order_relaxed);
+            uint64_t valid = now_head + 1 > EVENTS_PER_THREAD ? now_head + 1 - EVENTS_PER_THREAD : 0;  // + 1 for a write in progress
+
+            for (uint64_t i = std::max(begin, valid); i < head; ++i) {
+                const Copy &event = events[i - begin];
+
+                fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f",
+                        first ? "" : ",\n", event.name, event.phase, pid, buffer->tid, rel_us_(event.ts));
+                first = false;
+
+                switch (event.phase) {
+                    case 'X':
+                        fprintf(file, ",\"dur\":%.3f", event.dur / 1e3);
+                        break;
+                    case 'i':
+                        fprintf(file, ",\"s\":\"t\"");
+                        break;
+                    case 'b':
+                    case 'e':
+                        fprintf(file, ",\"cat\":\"block\",\"id\":%" PRIu64 "}", event.seq);
+                        continue;
+                }
+
+                if (event.seq != NO_SEQ && event.arg >= 0) {
+                    fprintf(file, ",\"args\":{\"seq\":%" PRIu64 ",\"ch\":%d}}", event.seq, event.arg);
+                } else if (event.seq != NO_SEQ) {
+                    fprintf(file, ",\"args\":{\"seq\":%" PRIu64 "}}", event.seq);
+                } else {
+                    fprintf(file, "}");
+                }
+            }
+        }
+        fprintf(file, "\n]}\n");
+
+        return fclose(file) == 0;
+    }
+
+private:
+    struct Event {
+        std::atomic<const char*> name;
+        std::atomic<uint64_t>    ts;
+        std::atomic<uint64_t>    dur;
+        std::atomic<uint64_t>    seq;
+        std::atomic<int>         arg;
+        std::atomic<char>        phase;
+    };
+
+    // Event copied out of a buffer
+    struct Copy {
+        const char *name;
+        uint64_t    ts;
+        uint64_t    dur;
+        uint64_t    seq;
+        int         arg;
+        char        phase;
+    };
+
+    struct Buffer {
+        Buffer(unsigned tid) : tid(tid), events(new Event[EVENTS_PER_THREAD]) {}
+
+        const unsigned           tid;
+        std::atomic<const char*> name = nullptr;
+        std::atomic<uint64_t>    head = 0;    // Number of events ever recorded
+        std::unique_ptr<Event[]> events;
+    };
+
+    static inline std::atomic<unsigned> next_id_ = 0;
+
+    const unsigned                       id_;       // Identifies the tracer in the thread local cache
+    const uint64_t                       origin_;   // Time zero in the file
+    mutable std::mutex                   mutex_;
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+
+    // Buffer for the calling thread. Created on the first call
+    Buffer &buffer_(void) {
+        thread_local unsigned  owner = 0;
+        thread_local Buffer   *buffer = nullptr;
+
+        if (owner != id_) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffers_.push_back(std::make_unique<Buffer>(buffers_.size() + 1));
+            buffer = buffers_.back().get();
+            owner = id_;
+        }
+
+        return *buffer;
+    }
+
+    void add_(char phase, const char *name, uint64_t ts, uint64_t dur, uint64_t seq, int arg) {
+        Buffer   &buffer = buffer_();
+        uint64_t  head = buffer.head.load(std::memory_order_relaxed);
+        Event    &event = buffer.events[head % EVENTS_PER_THREAD];
+
+        event.name.store(name, std::memory_order_relaxed);
+        event.ts.store(ts, std::memory_order_relaxed);
+        event.dur.store(dur, std::memory_order_relaxed);
+        event.seq.store(seq, std::memory_order_relaxed);
+        event.arg.store(arg, std::memory_order_relaxed);
+        event.phase.store(phase, std::memory_order_relaxed);
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    // Timestamp in us relative to the creation of the tracer
+    double rel_us_(uint64_t ts) const {
+        return ts >= origin_ ? (ts - origin_) / 1e3 : -((origin_ - ts) / 1e3);
+    }
+};
+
+#endif // TRACE_HPP
@@ -0,0 +1,222 @@
+//
+// Full screen status display that only redraws what has changed
+//
+// @author Johan Hedin
+// @date   2026
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef TUI_HPP
+#define TUI_HPP
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <map>
+#include <utility>
+#include <atomic>
+
+// Status display at the top of a terminal. A frame is a set of fields, each
+// at a row and column, and only the fields that differ from the last frame
+// are written. Fields may hold SGR escapes (colors) and UTF-8 and are padded
+// with spaces to their width. The rows below the display are a scroll region
+// so that other output, like warnings, scrolls there without disturbing the
+// display. The display has as many rows as the fields of the frame need:
+//
+//     screen.begin();
+//     screen.field(0, 0, 8, "12:00:00");
+//     ...
+//     screen.end();
+//
+// Not thread safe. The console lock, if given, is held while writing so that
+// the escape sequences are not mixed with output from other threads.
+class Screen {
+public:
+    static constexpr unsigned MIN_SCROLL_ROWS = 4;   // Rows always left for other output
+
+    Screen(FILE *file = stdout, std::atomic_flag *console_lock = nullptr) :
+      file_(file), console_lock_(console_lock), rows_(0), term_rows_(0), term_cols_(0), active_(false) {}
+    ~Screen(void) { close(); }
+
+    Screen(const Screen&) = delete;
+    Screen& operator=(const Screen&) = delete;
+
+    // True if the file is a terminal that a screen can be drawn on
+    bool isTerminal(void) const {
+        unsigned rows, cols;
+        return isatty(fileno(file_)) && size_(rows, cols);
+    }
+
+    // Terminal size, as of the last begin(). Used to lay out the frame
+    unsigned termRows(void) const { return term_rows_; }
+    unsigned termCols(void) const { return term_cols_; }
+
+    // Most rows a display can have with the current terminal size
+    unsigned maxRows(void) const { return term_rows_ > MIN_SCROLL_ROWS ? term_rows_ - MIN_SCROLL_ROWS : 1; }
+
+    // Begin a frame. The terminal size is checked and everything is redrawn
+    // if it has changed
+    void begin(void) {
+        unsigned term_rows = 0, term_cols = 0;
+
+        size_(term_rows, term_cols);
+        if (term_rows != term_rows_ || term_cols != term_cols_) {
+            term_rows_ = term_rows;
+            term_cols_ = term_cols;
+            redraw_ = true;
+        }
+
+        next_.clear();
+    }
+
+    // Set a field in the frame. Fields outside of the terminal, or below
+    // maxRows(), are dropped
+    void field(unsigned row, unsigned col, unsigned width, const std::string &text) {
+        if (row >= maxRows() || col >= term_cols_) return;
+        if (col + width > term_cols_) width = term_cols_ - col;
+
+        next_[{ row, col }] = Field{ width, text };
+    }
+
+    // Write the fields that have changed since the last frame. Everything is
+    // redrawn if the number of rows has changed
+    void end(void) {
+        std::string out;
+        unsigned    rows = next_.empty() ? 1 : next_.rbegin()->first.first + 1;
+
+        if (rows != rows_) redraw_ = true;
+        rows_ = rows;
+
+        if (!active_) {
+            // Scroll what is on the terminal up, out of the way of the display
+            out += "\033[" + std::to_string(term_rows_) + ";1H";
+            out.append(rows_, '\n');
+        }
+
+        // Save the cursor, in the scroll region, and put it back when done
+        out += "\0337";
+
+        if (redraw_ || !active_) {
+            // Scroll region below the display, then clear the display
+            out += "\033[" + std::to_string(rows_ + 1) + ";" + std::to_string(term_rows_) + "r";
+            for (unsigned row = 0; row < rows_; ++row) out += "\033[" + std::to_string(row + 1) + ";1H\033[2K";
+            shown_.clear();
+        }
+
+        // Blank fields that are gone
+        for (auto &[pos, field] : shown_) {
+            if (next_.count(pos) == 0) {
+                move_(out, pos);
+                out.append(field.width, ' ');
+            }
+        }
+
+        for (auto &[pos, field] : next_) {
+            auto iter = shown_.find(pos);
+            if (iter != shown_.end() && iter->second.width == field.width && iter->second.text == field.text) continue;
+
+            move_(out, pos);
+            out += field.text;
+            unsigned len = visibleLength(field.text);
+            if (len < field.width) out.append(field.width - len, ' ');
+        }
+
+        if (redraw_ || !active_) {
+            // Setting the scroll region moves the cursor to the top left so
+            // put it at the bottom of the scroll region instead
+            out += "\033[" + std::to_string(term_rows_) + ";1H";
+        } else {
+            out += "\0338";
+        }
+
+        write_(out);
+
+        shown_.swap(next_);
+        redraw_ = false;
+        active_ = true;
+    }
+
+    // Remove the scroll region and leave the cursor below the display
+    void close(void) {
+        if (!active_) return;
+
+        write_("\0337\033[r\0338\n");
+        shown_.clear();
+        active_ = false;
+    }
+
+    // Number of terminal columns a text takes. SGR and other CSI escapes
+    // take none and every UTF-8 character one
+    static unsigned visibleLength(const std::string &text) {
+        unsigned len = 0;
+
+        for (size_t i = 0; i < text.length(); ++i) {
+            unsigned char c = text[i];
+
+            if (c == '\033' && i + 1 < text.length() && text[i + 1] == '[') {
+                // Parameters up to the final byte
+                i += 2;
+                while (i < text.length() && (text[i] < 0x40 || text[i] > 0x7e)) ++i;
+            } else if ((c & 0xc0) != 0x80) {
+                ++len;
+            }
+        }
+
+        return len;
+    }
+
+private:
+    using Pos = std::pair<unsigned, unsigned>;   // Row and column
+
+    struct Field {
+        unsigned    width;
+        std::string text;
+    };
+
+    FILE                 *file_;
+    std::atomic_flag     *console_lock_;
+    unsigned              rows_;
+    unsigned              term_rows_;
+    unsigned              term_cols_;
+    bool                  active_;           // Display is drawn
+    bool                  redraw_ = true;
+    std::map<Pos, Field>  shown_;            // Fields on the terminal
+    std::map<Pos, Field>  next_;             // Fields of the frame being built
+
+    bool size_(unsigned &rows, unsigned &cols) const {
+        struct winsize ws;
+
+        if (ioctl(fileno(file_), TIOCGWINSZ, &ws) < 0 || ws.ws_row == 0 || ws.ws_col == 0) return false;
+        rows = ws.ws_row;
+        cols = ws.ws_col;
+
+        return true;
+    }
+
+    static void move_(std::string &out, const Pos &pos) {
+        out += "\033[" + std::to_string(pos.first + 1) + ";" + std::to_string(pos.second + 1) + "H";
+    }
+
+    void write_(const std::string &out) {
+        if (console_lock_) while (console_lock_->test_and_set(std::memory_order_acquire));
+        fwrite(out.data(), 1, out.length(), file_);
+        fflush(file_);
+        if (console_lock_) console_lock_->clear(std::memory_order_release);
+    }
+};
+
+#endif // TUI_HPP